@@ -48,29 +48,43 @@
 void
 bzero(void *vblock, size_t len)
 {
-	char *block = vblock;
-	size_t i;
+	unsigned char *block = vblock;
+	unsigned long *lb;
+	size_t nwords;
 
 	/*
-	 * For performance, optimize the common case where the pointer
-	 * and the length are word-aligned, and write word-at-a-time
-	 * instead of byte-at-a-time. Otherwise, write bytes.
-	 *
-	 * The alignment logic here should be portable. We rely on the
-	 * compiler to be reasonably intelligent about optimizing the
-	 * divides and moduli out. Fortunately, it is.
+	 * For performance, write bytes until the pointer is
+	 * word-aligned, then whole words eight at a time, then the
+	 * leftover bytes. Short blocks just go by bytes.
 	 */
 
-	if ((uintptr_t)block % sizeof(long) == 0 &&
-	    len % sizeof(long) == 0) {
-		long *lb = (long *)block;
-		for (i=0; i<len/sizeof(long); i++) {
-			lb[i] = 0;
+	if (len >= 2*sizeof(unsigned long)) {
+		while ((uintptr_t)block % sizeof(unsigned long) != 0) {
+			*block++ = 0;
+			len--;
 		}
-	}
-	else {
-		for (i=0; i<len; i++) {
-			block[i] = 0;
+		lb = (unsigned long *)block;
+		nwords = len / sizeof(unsigned long);
+		len -= nwords * sizeof(unsigned long);
+		for (; nwords >= 8; nwords -= 8) {
+			lb[0] = 0;
+			lb[1] = 0;
+			lb[2] = 0;
+			lb[3] = 0;
+			lb[4] = 0;
+			lb[5] = 0;
+			lb[6] = 0;
+			lb[7] = 0;
+			lb += 8;
+		}
+		for (; nwords > 0; nwords--) {
+			*lb++ = 0;
 		}
+		block = (unsigned char *)lb;
+	}
+
+	while (len > 0) {
+		*block++ = 0;
+		len--;
 	}
 }
@@ -35,9 +35,27 @@
 #ifdef _KERNEL
 #include <types.h>
 #include <lib.h>
+#include <endian.h>
 #else
 #include <stdint.h>
 #include <string.h>
+#include <kern/endian.h>
+#endif
+
+/* Size of a word, the unit we copy in. */
+#define WSIZE  sizeof(unsigned long)
+
+/*
+ * Make a destination word from two aligned source words W0 and W1,
+ * when the source is SHIFT bits past word alignment. Which end of a
+ * word holds the lower-addressed bytes depends on byte order.
+ */
+#if _BYTE_ORDER == _BIG_ENDIAN
+#define MERGE(w0, w1, shift) \
+	(((w0) << (shift)) | ((w1) >> (WSIZE*8 - (shift))))
+#else
+#define MERGE(w0, w1, shift) \
+	(((w0) >> (shift)) | ((w1) << (WSIZE*8 - (shift))))
 #endif
 
 /*
@@ -47,39 +65,73 @@
 void *
 memcpy(void *dst, const void *src, size_t len)
 {
-	size_t i;
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	unsigned long *dw;
+	const unsigned long *sw;
+	unsigned long w0, w1;
+	size_t nwords;
+	unsigned shift;
 
 	/*
 	 * memcpy does not support overlapping buffers, so always do it
 	 * forwards. (Don't change this without adjusting memmove.)
 	 *
-	 * For speedy copying, optimize the common case where both pointers
-	 * and the length are word-aligned, and copy word-at-a-time instead
-	 * of byte-at-a-time. Otherwise, copy by bytes.
-	 *
-	 * The alignment logic below should be portable. We rely on
-	 * the compiler to be reasonably intelligent about optimizing
-	 * the divides and modulos out. Fortunately, it is.
+	 * Short copies go by bytes. Otherwise copy bytes until the
+	 * destination is word-aligned, then whole words, then the
+	 * leftover bytes. If the source is now aligned too, the words
+	 * are copied eight at a time. If not, each destination word is
+	 * put together from the two aligned source words it straddles.
+	 * That reads up to a word either side of the source, but only
+	 * within words that hold source bytes, so never off the end of
+	 * a page the source isn't on.
 	 */
 
-	if ((uintptr_t)dst % sizeof(long) == 0 &&
-	    (uintptr_t)src % sizeof(long) == 0 &&
-	    len % sizeof(long) == 0) {
-
-		long *d = dst;
-		const long *s = src;
+	if (len >= 2*WSIZE) {
+		while ((uintptr_t)d % WSIZE != 0) {
+			*d++ = *s++;
+			len--;
+		}
+		dw = (unsigned long *)d;
+		nwords = len / WSIZE;
+		len -= nwords * WSIZE;
 
-		for (i=0; i<len/sizeof(long); i++) {
-			d[i] = s[i];
+		if ((uintptr_t)s % WSIZE == 0) {
+			sw = (const unsigned long *)s;
+			for (; nwords >= 8; nwords -= 8) {
+				dw[0] = sw[0];
+				dw[1] = sw[1];
+				dw[2] = sw[2];
+				dw[3] = sw[3];
+				dw[4] = sw[4];
+				dw[5] = sw[5];
+				dw[6] = sw[6];
+				dw[7] = sw[7];
+				dw += 8;
+				sw += 8;
+			}
+			for (; nwords > 0; nwords--) {
+				*dw++ = *sw++;
+			}
+			s = (const unsigned char *)sw;
 		}
+		else {
+			shift = ((uintptr_t)s % WSIZE) * 8;
+			sw = (const unsigned long *)(s - (uintptr_t)s % WSIZE);
+			s += nwords * WSIZE;
+			w0 = *sw++;
+			for (; nwords > 0; nwords--) {
+				w1 = *sw++;
+				*dw++ = MERGE(w0, w1, shift);
+				w0 = w1;
+			}
+		}
+		d = (unsigned char *)dw;
 	}
-	else {
-		char *d = dst;
-		const char *s = src;
 
-		for (i=0; i<len; i++) {
-			d[i] = s[i];
-		}
+	while (len > 0) {
+		*d++ = *s++;
+		len--;
 	}
 
 	return dst;
@@ -48,11 +48,15 @@
 void *
 memmove(void *dst, const void *src, size_t len)
 {
-	size_t i;
+	unsigned char *d;
+	const unsigned char *s;
+	unsigned long *dw;
+	const unsigned long *sw;
+	size_t nwords;
 
 	/*
 	 * If the buffers don't overlap, it doesn't matter what direction
-	 * we copy in. If they do, it does, so just assume they always do.
+	 * we copy in. If they do, it does.
 	 * We don't concern ourselves with the possibility that the region
 	 * to copy might roll over across the top of memory, because it's
 	 * not going to happen.
@@ -75,7 +79,8 @@ memmove(void *dst, const void *src, size_t len)
          *                     |___|
 	 */
 
-	if ((uintptr_t)dst < (uintptr_t)src) {
+	if ((uintptr_t)dst < (uintptr_t)src ||
+	    (uintptr_t)dst - (uintptr_t)src >= len) {
 		/*
 		 * As author/maintainer of libc, take advantage of the
 		 * fact that we know memcpy copies forwards.
@@ -84,33 +89,49 @@ memmove(void *dst, const void *src, size_t len)
 	}
 
 	/*
-	 * Copy by words in the common case. Look in memcpy.c for more
-	 * information.
+	 * Copy backwards. Go by words, eight at a time, if the two
+	 * buffers are aligned alike; see memcpy.c. Otherwise go by
+	 * bytes: overlapping copies between differently aligned
+	 * buffers are rare, and the word-merging trick in memcpy
+	 * would need its own backwards version.
 	 */
 
-	if ((uintptr_t)dst % sizeof(long) == 0 &&
-	    (uintptr_t)src % sizeof(long) == 0 &&
-	    len % sizeof(long) == 0) {
+	d = (unsigned char *)dst + len;
+	s = (const unsigned char *)src + len;
 
-		long *d = dst;
-		const long *s = src;
-
-		/*
-		 * The reason we copy index i-1 and test i>0 is that
-		 * i is unsigned -- so testing i>=0 doesn't work.
-		 */
-
-		for (i=len/sizeof(long); i>0; i--) {
-			d[i-1] = s[i-1];
+	if (len >= 2*sizeof(unsigned long) &&
+	    (uintptr_t)d % sizeof(unsigned long) ==
+	    (uintptr_t)s % sizeof(unsigned long)) {
+		while ((uintptr_t)d % sizeof(unsigned long) != 0) {
+			*--d = *--s;
+			len--;
 		}
+		dw = (unsigned long *)d;
+		sw = (const unsigned long *)s;
+		nwords = len / sizeof(unsigned long);
+		len -= nwords * sizeof(unsigned long);
+		for (; nwords >= 8; nwords -= 8) {
+			dw -= 8;
+			sw -= 8;
+			dw[7] = sw[7];
+			dw[6] = sw[6];
+			dw[5] = sw[5];
+			dw[4] = sw[4];
+			dw[3] = sw[3];
+			dw[2] = sw[2];
+			dw[1] = sw[1];
+			dw[0] = sw[0];
+		}
+		for (; nwords > 0; nwords--) {
+			*--dw = *--sw;
+		}
+		d = (unsigned char *)dw;
+		s = (const unsigned char *)sw;
 	}
-	else {
-		char *d = dst;
-		const char *s = src;
 
-		for (i=len; i>0; i--) {
-			d[i-1] = s[i-1];
-		}
+	while (len > 0) {
+		*--d = *--s;
+		len--;
 	}
 
 	return dst;
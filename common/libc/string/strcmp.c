@@ -36,9 +36,14 @@
 #include <types.h>
 #include <lib.h>
 #else
+#include <stdint.h>
 #include <string.h>
 #endif
 
+/* See strlen.c. */
+#define ONES		(~0UL / 0xff)
+#define HASZERO(w)	(((w) - ONES) & ~(w) & (ONES << 7))
+
 /*
  * Standard C string function: compare two strings and return their
  * sort order.
@@ -63,7 +68,34 @@ strcmp(const char *a, const char *b)
 	 * B.
 	 */
 
-	for (i=0; a[i]!=0 && a[i]==b[i]; i++) {
+	i = 0;
+
+	/*
+	 * If the strings are aligned alike, get to a word boundary and
+	 * then skip equal words that have no terminator in them. This
+	 * stops at the word where they differ or A ends, and the byte
+	 * loop below finds the place.
+	 */
+	if ((uintptr_t)a % sizeof(unsigned long) ==
+	    (uintptr_t)b % sizeof(unsigned long)) {
+		const unsigned long *wa, *wb;
+
+		while ((uintptr_t)(a+i) % sizeof(unsigned long) != 0 &&
+		       a[i]!=0 && a[i]==b[i]) {
+			i++;
+		}
+		if ((uintptr_t)(a+i) % sizeof(unsigned long) == 0) {
+			wa = (const unsigned long *)(a+i);
+			wb = (const unsigned long *)(b+i);
+			while (*wa == *wb && !HASZERO(*wa)) {
+				wa++;
+				wb++;
+			}
+			i = (const char *)wa - a;
+		}
+	}
+
+	for (; a[i]!=0 && a[i]==b[i]; i++) {
 		/* nothing */
 	}
 
@@ -36,9 +36,17 @@
 #include <types.h>
 #include <lib.h>
 #else
+#include <stdint.h>
 #include <string.h>
 #endif
 
+/*
+ * ONES has every byte 0x01; a word has a zero byte exactly when
+ * HASZERO is nonzero.
+ */
+#define ONES		(~0UL / 0xff)
+#define HASZERO(w)	(((w) - ONES) & ~(w) & (ONES << 7))
+
 /*
  * C standard string function: get length of a string
  */
@@ -46,10 +54,26 @@
 size_t
 strlen(const char *str)
 {
-	size_t ret = 0;
+	const char *p = str;
+	const unsigned long *wp;
 
-	while (str[ret]) {
-		ret++;
+	/*
+	 * Go by bytes until aligned, then check a word at a time for a
+	 * zero byte, and find which one it was. Reading the whole word
+	 * holding the terminator can't fault, as it is all in one page.
+	 */
+
+	while ((uintptr_t)p % sizeof(unsigned long) != 0) {
+		if (*p == 0) {
+			return p - str;
+		}
+		p++;
+	}
+	for (wp = (const unsigned long *)p; !HASZERO(*wp); wp++) {
+		/* nothing */
+	}
+	for (p = (const char *)wp; *p != 0; p++) {
+		/* nothing */
 	}
-	return ret;
+	return p - str;
 }
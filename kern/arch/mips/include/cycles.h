@@ -0,0 +1,28 @@
+#ifndef _MIPS_CYCLES_H_
+#define _MIPS_CYCLES_H_
+
+/*
+ * Read this cpu's cycle counter (c0_count).
+ *
+ * The on-chip timer restarts the count from zero on every hardclock,
+ * so this is only good for timing intervals much shorter than a tick;
+ * an interval that spans a tick comes out with end < start and should
+ * be thrown away.
+ */
+static inline
+uint32_t
+mips_cycles(void)
+{
+	uint32_t count;
+
+	/* $9 == c0_count; MIPS-I has no such register, hence .set mips32 */
+	__asm volatile(
+		".set push;"
+		".set mips32;"
+		"mfc0 %0, $9;"
+		".set pop"
+		: "=r" (count));
+	return count;
+}
+
+#endif /* _MIPS_CYCLES_H_ */
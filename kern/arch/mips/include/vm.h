@@ -66,6 +66,7 @@
  * a valid address, and will make a *huge* mess if you scribble on it.
  */
 #define PADDR_TO_KVADDR(paddr) ((paddr)+MIPS_KSEG0)
+#define KVADDR_TO_PADDR(vaddr) ((vaddr)-MIPS_KSEG0)
 
 /*
  * The top of user space. (Actually, the address immediately above the
@@ -106,14 +107,15 @@ void ram_getsize(paddr_t *lo, paddr_t *hi);
  * TLB shootdown bits.
  *
  * We'll take up to 16 invalidations before just flushing the whole TLB.
+ *
+ * A shootdown names the ASID rather than the address space, since the
+ * address space may be gone by the time the target cpu gets to it.
  */
 
 struct tlbshootdown {
-	/*
-	 * Change this to what you need for your VM design.
-	 */
-	struct addrspace *ts_addrspace;
-	vaddr_t ts_vaddr;
+	uint32_t ts_asid;	/* ASID the mapping was tagged with */
+	uint32_t ts_asidgen;	/* ...and its generation */
+	vaddr_t ts_vaddr;	/* page to invalidate */
 };
 
 #define TLBSHOOTDOWN_MAX 16
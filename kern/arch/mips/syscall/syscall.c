@@ -34,8 +34,14 @@
 #include <mips/trapframe.h>
 #include <thread.h>
 #include <current.h>
+#include <proc.h>
+#include <evtrace.h>
 #include "opt-A2.h"
+#include "opt-A3.h"
 #include <syscall.h>
+#if OPT_A3
+#include <copyinout.h>
+#endif
 
 
 /*
@@ -88,6 +94,11 @@ syscall(struct trapframe *tf)
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+#if OPT_A2
+	EVTRACE(EV_SYSCALL, callno, curproc->p_pid);
+#else
+	EVTRACE(EV_SYSCALL, callno, 0);
+#endif
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -109,6 +120,15 @@ syscall(struct trapframe *tf)
 		err = sys___time((userptr_t)tf->tf_a0,
 				 (userptr_t)tf->tf_a1);
 		break;
+
+	    case SYS___bench:
+		err = sys___bench((int)tf->tf_a0, (unsigned)tf->tf_a1);
+		break;
+
+	    case SYS_nanosleep:
+		err = sys_nanosleep((userptr_t)tf->tf_a0,
+				    (userptr_t)tf->tf_a1);
+		break;
 #ifdef UW
 	case SYS_write:
 	  err = sys_write((int)tf->tf_a0,
@@ -137,6 +157,83 @@ syscall(struct trapframe *tf)
 	case SYS_execv:
 	  err = sys_execv((char*)tf->tf_a0, (char **)tf->tf_a1, &retval);
 	  break;
+	case SYS_open:
+	  err = sys_open((userptr_t)tf->tf_a0, (int)tf->tf_a1,
+			 (mode_t)tf->tf_a2, (int *)(&retval));
+	  break;
+	case SYS_read:
+	  err = sys_read((int)tf->tf_a0,
+			 (userptr_t)tf->tf_a1,
+			 (int)tf->tf_a2,
+			 (int *)(&retval));
+	  break;
+	case SYS_close:
+	  err = sys_close((int)tf->tf_a0);
+	  break;
+	case SYS_dup2:
+	  err = sys_dup2((int)tf->tf_a0, (int)tf->tf_a1, (int *)(&retval));
+	  break;
+	case SYS_fstat:
+	  err = sys_fstat((int)tf->tf_a0, (userptr_t)tf->tf_a1);
+	  break;
+	case SYS_pipe:
+	  err = sys_pipe((userptr_t)tf->tf_a0, (int *)(&retval));
+	  break;
+	case SYS_spawn:
+	  err = sys_spawn((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1,
+			  (pid_t *) &retval);
+	  break;
+	case SYS_getrusage:
+	  err = sys_getrusage((int)tf->tf_a0, (userptr_t)tf->tf_a1);
+	  break;
+	case SYS_procstat:
+	  err = sys_procstat((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1,
+			     (unsigned)tf->tf_a2, &retval);
+	  break;
+	#endif
+	case SYS_futex_wait:
+	  err = sys_futex_wait((userptr_t)tf->tf_a0, (int)tf->tf_a1);
+	  break;
+	case SYS_futex_wake:
+	  err = sys_futex_wake((userptr_t)tf->tf_a0, (int)tf->tf_a1, &retval);
+	  break;
+	#if OPT_A3
+	case SYS_sbrk:
+	  err = sys_sbrk((int)tf->tf_a0, &retval);
+	  break;
+	case SYS_mmap:
+	  {
+	    /* fd is the fifth argument and the 64-bit offset the sixth,
+	       aligned, so they are on the user stack past a0-a3's slots */
+	    int32_t fd;
+	    off_t offset;
+
+	    err = copyin((const_userptr_t)(tf->tf_sp + 16), &fd, sizeof(fd));
+	    if (!err) {
+	      err = copyin((const_userptr_t)(tf->tf_sp + 24),
+			   &offset, sizeof(offset));
+	    }
+	    if (!err) {
+	      err = sys_mmap((userptr_t)tf->tf_a0, (size_t)tf->tf_a1,
+			     (int)tf->tf_a2, (int)tf->tf_a3, fd, offset,
+			     &retval);
+	    }
+	  }
+	  break;
+	case SYS_munmap:
+	  err = sys_munmap((userptr_t)tf->tf_a0, (size_t)tf->tf_a1);
+	  break;
+	case SYS_msync:
+	  err = sys_msync((userptr_t)tf->tf_a0, (size_t)tf->tf_a1,
+			  (int)tf->tf_a2);
+	  break;
+	case SYS_shm_attach:
+	  err = sys_shm_attach((int)tf->tf_a0, (size_t)tf->tf_a1,
+			       (int)tf->tf_a2, &retval);
+	  break;
+	case SYS_shm_remove:
+	  err = sys_shm_remove((int)tf->tf_a0);
+	  break;
 	#endif
 #endif // UW
 
@@ -149,6 +246,8 @@ syscall(struct trapframe *tf)
 	}
 
 
+	EVTRACE(EV_SYSRET, callno, err);
+
 	if (err) {
 		/*
 		 * Return the error code. This gets converted at
@@ -33,10 +33,22 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <proc.h>
+#include <thread.h>
 #include <current.h>
+#include <cpu.h>
 #include <mips/tlb.h>
+#include <mips/cycles.h>
+#include <platform/maxcpus.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <uw-vmstats.h>
+#include <array.h>
+#include <synch.h>
+#include <vnode.h>
+#include <kern/mman.h>
+#include <vmobj.h>
+#include <evtrace.h>
+#include <pcounter.h>
 #include "opt-A3.h"
 
 /*
@@ -46,11 +58,63 @@
 
 /* under dumbvm, always have 48k of user stack */
 #define DUMBVM_STACKPAGES    12
+#if OPT_A3
+/* ...or, with regions, up to 1M, only as much of it resident as used */
+#define DUMBVM_STACKMAX      256
+#endif
 
 /*
  * Wrap rma_stealmem in a spinlock.
  */
 static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
+
+/*
+ * ASID allocation. Address spaces get a TLB tag the first time they
+ * are activated in each generation; ASIDs are never reused within a
+ * generation. When they run out, the generation is bumped and every
+ * cpu flushes its TLB the next time it activates an address space,
+ * since its TLB may hold entries tagged with ASIDs that are about to
+ * be handed out again. Generation 0 means "none", so the first
+ * activation on each cpu flushes.
+ */
+static struct spinlock asid_lock = SPINLOCK_INITIALIZER;
+static uint32_t asid_generation = 1;
+static uint32_t asid_next = 0;
+
+/*
+ * Per-cpu VM state, indexed by cpu number like cpustacks[]. Only
+ * touched by the cpu it belongs to, with interrupts off. Each cpu's
+ * state gets its own cache line, since vc_tlbfree moves on every
+ * refill.
+ */
+struct dumbvm_cpu {
+	uint32_t vc_asidgen;	/* ASID generation of our TLB contents */
+	uint32_t vc_curasid;	/* ASID last loaded by as_activate */
+	unsigned vc_tlbfree;	/* slots from here up unused since flush */
+} __attribute__((__aligned__(PCOUNTER_CACHELINE)));
+
+static struct dumbvm_cpu dumbvm_cpus[MAXCPUS];
+
+/*
+ * Statistics, summed over cpus only when printed. There are two sets
+ * of refill counters, DVS_FAST for refills from the software TLB and
+ * DVS_SLOW for refills through vm_fault_slow; add a DVS_RS_* offset.
+ */
+#define DVS_RS_COUNT	0	/* refills */
+#define DVS_RS_TIMED	1	/* refills that didn't span a tick */
+#define DVS_RS_CYCLES	2	/* total cycles over the timed ones */
+#define DVS_RS_MAX	3	/* longest timed one (pcounter_max) */
+#define DVS_FAST	0
+#define DVS_SLOW	4
+#define DVS_IPIS	8	/* shootdown IPIs sent */
+#define DVS_SHOOTREQS	9	/* pages asked to be shot down */
+#define DVS_TLBINVAL	10	/* entries invalidated by shootdowns */
+#define DVS_TLBFLUSH	11	/* whole-TLB shootdowns */
+#define DVS_TEXTHITS	12	/* text cache hits */
+#define DVS_TEXTMISSES	13	/* text cache misses */
+#define DVS_COUNT	14
+
+PCOUNTER_DEFINE(dumbvm_stats, DVS_COUNT);
 #if OPT_A3
 	static paddr_t pmem_lo,pmem_hi;
 	struct coremap {
@@ -61,6 +125,23 @@ static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
 	static struct coremap *core_map;
 	static unsigned int nframe;
 	static bool vm_boost_done = false;
+
+	/*
+	 * Shared text. Once loaded, a read-only text segment lives in a
+	 * refcounted textimage, shared with every fork of the process and,
+	 * through the cache, with every later exec of the same vnode. The
+	 * cache holds a vnode reference per image; images (and their
+	 * frames) go away with their last address space.
+	 */
+	struct textimage {
+		struct vnode *ti_vn;	/* NULL if not in the cache */
+		vaddr_t ti_vbase;
+		size_t ti_npages;
+		paddr_t ti_pbase;
+		unsigned ti_refs;	/* address spaces using it */
+	};
+	static struct lock *textcache_lock;
+	static struct array textcache;		/* struct textimage * */
 #endif//OPT_A3
 void
 vm_bootstrap(void)
@@ -94,10 +175,165 @@ vm_bootstrap(void)
 		tempaddr += PAGE_SIZE;
 	}
 	vm_boost_done = true;
+
+	textcache_lock = lock_create("textcache");
+	if (textcache_lock == NULL) {
+		panic("vm_bootstrap: out of memory\n");
+	}
+	array_init(&textcache);
+	vmobj_bootstrap();
 #endif//OPT_A3
 	/* Do nothing. */
 }
 
+#if OPT_A3
+/*
+ * Find a cached text image for VN laid out at VBASE/NPAGES and take a
+ * reference to it.
+ */
+static
+struct textimage *
+textcache_get(struct vnode *vn, vaddr_t vbase, size_t npages)
+{
+	struct textimage *ti;
+	unsigned i, num;
+
+	lock_acquire(textcache_lock);
+	num = array_num(&textcache);
+	for (i=0; i<num; i++) {
+		ti = array_get(&textcache, i);
+		if (ti->ti_vn == vn && ti->ti_vbase == vbase &&
+		    ti->ti_npages == npages) {
+			ti->ti_refs++;
+			pcounter_inc(&dumbvm_stats, DVS_TEXTHITS);
+			lock_release(textcache_lock);
+			return ti;
+		}
+	}
+	pcounter_inc(&dumbvm_stats, DVS_TEXTMISSES);
+	lock_release(textcache_lock);
+	return NULL;
+}
+
+/*
+ * Turn AS's freshly loaded text into an image, entering it in the
+ * cache under VN (if not NULL, and nobody beat us to it).
+ */
+static
+struct textimage *
+textimage_create(struct addrspace *as, struct vnode *vn)
+{
+	struct textimage *ti, *other;
+	unsigned i, num;
+
+	ti = kmalloc(sizeof(*ti));
+	if (ti == NULL) {
+		return NULL;
+	}
+	ti->ti_vn = NULL;
+	ti->ti_vbase = as->as_vbase1;
+	ti->ti_npages = as->as_npages1;
+	ti->ti_pbase = as->as_pbase1;
+	ti->ti_refs = 1;
+
+	if (vn == NULL) {
+		return ti;
+	}
+
+	lock_acquire(textcache_lock);
+	num = array_num(&textcache);
+	for (i=0; i<num; i++) {
+		other = array_get(&textcache, i);
+		if (other->ti_vn == vn && other->ti_vbase == ti->ti_vbase &&
+		    other->ti_npages == ti->ti_npages) {
+			/* a concurrent load of the same file got there first */
+			lock_release(textcache_lock);
+			return ti;
+		}
+	}
+	if (array_add(&textcache, ti, NULL) == 0) {
+		VOP_INCREF(vn);
+		ti->ti_vn = vn;
+	}
+	lock_release(textcache_lock);
+	return ti;
+}
+
+static
+void
+textimage_release(struct textimage *ti)
+{
+	struct vnode *vn;
+	unsigned i, num;
+
+	lock_acquire(textcache_lock);
+	KASSERT(ti->ti_refs > 0);
+	ti->ti_refs--;
+	if (ti->ti_refs > 0) {
+		lock_release(textcache_lock);
+		return;
+	}
+	vn = ti->ti_vn;
+	if (vn != NULL) {
+		num = array_num(&textcache);
+		for (i=0; i<num; i++) {
+			if (array_get(&textcache, i) == ti) {
+				array_remove(&textcache, i);
+				break;
+			}
+		}
+	}
+	lock_release(textcache_lock);
+
+	free_kpages(ti->ti_pbase);
+	if (vn != NULL) {
+		VOP_DECREF(vn);
+	}
+	kfree(ti);
+}
+#endif//OPT_A3
+
+/*
+ * Take VN's images out of the text cache, so the next exec loads the
+ * file afresh. Address spaces already using an image keep it; it's
+ * their own copy. The caller holds a reference to VN, so dropping
+ * ours can't reclaim it.
+ */
+void
+vm_textinval(struct vnode *vn)
+{
+#if OPT_A3
+	struct textimage *ti;
+	unsigned i, ndropped;
+
+	if (textcache_lock == NULL) {
+		/* before vm_bootstrap */
+		return;
+	}
+	ndropped = 0;
+	lock_acquire(textcache_lock);
+	i = 0;
+	while (i < array_num(&textcache)) {
+		ti = array_get(&textcache, i);
+		if (ti->ti_vn == vn) {
+			array_remove(&textcache, i);
+			ti->ti_vn = NULL;
+			ndropped++;
+		}
+		else {
+			i++;
+		}
+	}
+	lock_release(textcache_lock);
+
+	while (ndropped-- > 0) {
+		VOP_DECREF(vn);
+	}
+#else
+	(void)vn;
+#endif//OPT_A3
+}
+
 static
 paddr_t
 getppages(unsigned long npages)
@@ -150,9 +386,9 @@ getppages(unsigned long npages)
 			addr = core_map[index].addr;
 		}
 		else{
-			//not enough memory, return error code
+			//not enough memory; 0 is never a valid frame
 			spinlock_release(&stealmem_lock);
-			return ENOMEM;
+			return 0;
 		}
 	}else{
 		addr = ram_stealmem(npages);
@@ -172,13 +408,13 @@ alloc_kpages(int npages)
 	paddr_t pa;
 	pa = getppages(npages);
 	if (pa==0) {
-		return 0;
-	}
-	#if OPT_A3
-	if(pa==ENOMEM){
-		return pa;
+		/* give back the stacks and threads cached for reuse, and retry */
+		thread_trimcaches();
+		pa = getppages(npages);
+		if (pa==0) {
+			return 0;
+		}
 	}
-	#endif
 	return PADDR_TO_KVADDR(pa);
 }
 
@@ -208,47 +444,678 @@ free_kpages(vaddr_t addr)
 			}
 		}
 	}
-	spinlock_release(&stealmem_lock);
-	#endif
-	(void)addr;
+	spinlock_release(&stealmem_lock);
+	#endif
+	(void)addr;
+}
+
+/*
+ * Invalidate this cpu's whole TLB. Call at splhigh.
+ */
+static
+void
+dumbvm_tlbflush(struct dumbvm_cpu *vc)
+{
+	int i;
+
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	vc->vc_tlbfree = 0;
+	tlb_setasid(vc->vc_curasid);
+	vmstats_inc(VMSTAT_TLB_INVALIDATE);
+}
+
+void
+vm_tlbshootdown_all(void)
+{
+	struct dumbvm_cpu *vc;
+	int spl;
+
+	spl = splhigh();
+	vc = &dumbvm_cpus[curcpu->c_number];
+	dumbvm_tlbflush(vc);
+	splx(spl);
+	pcounter_inc(&dumbvm_stats, DVS_TLBFLUSH);
+}
+
+/*
+ * Drop one mapping from this cpu's TLB. If our TLB is from a newer
+ * generation than the ASID, nothing here can be using it. If it's from
+ * an older one, the address space may still be in it under its old
+ * ASID, which we no longer know, so flush the lot.
+ */
+void
+vm_tlbshootdown(const struct tlbshootdown *ts)
+{
+	struct dumbvm_cpu *vc;
+	int spl, index;
+
+	spl = splhigh();
+	vc = &dumbvm_cpus[curcpu->c_number];
+	if (vc->vc_asidgen < ts->ts_asidgen) {
+		dumbvm_tlbflush(vc);
+	}
+	else if (ts->ts_asidgen == vc->vc_asidgen) {
+		index = tlb_probe(ts->ts_vaddr |
+				  (ts->ts_asid << TLBHI_PIDSHIFT), 0);
+		if (index >= 0) {
+			tlb_write(TLBHI_INVALID(index), TLBLO_INVALID(), index);
+			pcounter_inc(&dumbvm_stats, DVS_TLBINVAL);
+		}
+		tlb_setasid(vc->vc_curasid);
+	}
+	splx(spl);
+}
+
+/*
+ * Remove NPAGES pages starting at VADDR from every TLB that might hold
+ * them: ours directly, and every other cpu that has run AS with one
+ * batched IPI each. More than TLBSHOOTDOWN_MAX pages become a full
+ * flush. Returns when every cpu is done, so the pages can be reused.
+ *
+ * Call with interrupts on and no spinlocks held.
+ */
+void
+as_invalidate(struct addrspace *as, vaddr_t vaddr, unsigned npages)
+{
+	struct tlbshootdown ts[TLBSHOOTDOWN_MAX + 1];
+	struct tlbcache_entry *tc;
+	uint32_t asid, gen, mask;
+	unsigned i, num, ipis;
+	int spl;
+
+	KASSERT((vaddr & PAGE_FRAME) == vaddr);
+
+	for (i=0; i<npages; i++) {
+		tc = &as->as_tlbcache[TLBCACHE_HASH(vaddr + i * PAGE_SIZE)];
+		if (tc->tc_vpage == vaddr + i * PAGE_SIZE) {
+			tc->tc_vpage = TLBCACHE_EMPTY;
+		}
+	}
+
+	spinlock_acquire(&asid_lock);
+	asid = as->as_asid;
+	gen = as->as_asidgen;
+	mask = as->as_cpumask;
+	spinlock_release(&asid_lock);
+
+	if (gen == 0 || mask == 0) {
+		/* never activated, so in nobody's TLB */
+		return;
+	}
+
+	/* one entry past the limit tells the targets to flush */
+	num = npages > TLBSHOOTDOWN_MAX ? TLBSHOOTDOWN_MAX + 1 : npages;
+	for (i=0; i<num; i++) {
+		ts[i].ts_asid = asid;
+		ts[i].ts_asidgen = gen;
+		ts[i].ts_vaddr = vaddr + i * PAGE_SIZE;
+	}
+
+	spl = splhigh();
+	if (mask & ((uint32_t)1 << curcpu->c_number)) {
+		if (num > TLBSHOOTDOWN_MAX) {
+			vm_tlbshootdown_all();
+		}
+		else {
+			for (i=0; i<num; i++) {
+				vm_tlbshootdown(&ts[i]);
+			}
+		}
+	}
+	ipis = ipi_tlbshootdown_cpus(mask, ts, num);
+	splx(spl);
+	pcounter_add(&dumbvm_stats, DVS_IPIS, ipis);
+	pcounter_add(&dumbvm_stats, DVS_SHOOTREQS, npages);
+
+	if (ipis > 0) {
+		ipi_tlbshootdown_wait(mask);
+	}
+}
+
+/*
+ * Get the entryhi for VPAGE in the current address space, tagged with
+ * the ASID this cpu's TLB is using for it. Call at splhigh.
+ *
+ * Another thread of the same address space may have had it given a
+ * new ASID in a new generation since this cpu activated it. This
+ * cpu's TLB is still from the old generation and may hold entries
+ * under the new ASID for some other address space, so activate again
+ * (which flushes) before loading anything under it. If the generation
+ * moves on after we look, the old ASID is still right for the old
+ * TLB contents, which get flushed at the next activation.
+ */
+static
+uint32_t
+dumbvm_tlbhi(struct dumbvm_cpu *vc, vaddr_t vpage)
+{
+	if (vc->vc_asidgen != asid_generation) {
+		as_activate();
+	}
+	return vpage | (vc->vc_curasid << TLBHI_PIDSHIFT);
+}
+
+/*
+ * Put a translation for VPAGE into this cpu's TLB: into the next
+ * never-used slot since the last flush if there is one, otherwise a
+ * random one. This saves scanning the TLB for an invalid entry.
+ */
+static
+int
+dumbvm_tlbload(vaddr_t vpage, uint32_t elo)
+{
+	struct dumbvm_cpu *vc;
+	uint32_t ehi;
+	int spl;
+
+	/* Disable interrupts on this CPU while frobbing the TLB. */
+	spl = splhigh();
+
+	vc = &dumbvm_cpus[curcpu->c_number];
+	ehi = dumbvm_tlbhi(vc, vpage);
+	if (vc->vc_tlbfree < NUM_TLB) {
+		tlb_write(ehi, elo, vc->vc_tlbfree++);
+		splx(spl);
+		vmstats_inc(VMSTAT_TLB_FAULT_FREE);
+		return 0;
+	}
+	tlb_random(ehi, elo);
+	splx(spl);
+	vmstats_inc(VMSTAT_TLB_FAULT_REPLACE);
+	return 0;
+}
+
+#if OPT_A3
+/*
+ * Replace the translation for VPAGE already in this cpu's TLB, if there
+ * is one; for upgrading a read-only mapping after a write fault.
+ * Loading a second entry for the same page would be fatal.
+ */
+static
+int
+dumbvm_tlbupdate(vaddr_t vpage, uint32_t elo)
+{
+	uint32_t ehi;
+	int spl, index;
+
+	/* EHI carries our own ASID, so probing leaves entryhi as it was */
+	spl = splhigh();
+	ehi = dumbvm_tlbhi(&dumbvm_cpus[curcpu->c_number], vpage);
+	index = tlb_probe(ehi, 0);
+	if (index >= 0) {
+		tlb_write(ehi, elo, index);
+		splx(spl);
+		return 0;
+	}
+	splx(spl);
+	return dumbvm_tlbload(vpage, elo);
+}
+#endif //OPT_A3
+
+/*
+ * Charge a refill that started at cycle START to the refill counters
+ * at PATH (DVS_FAST or DVS_SLOW).
+ */
+static
+void
+dumbvm_refilldone(unsigned path, uint32_t start)
+{
+	uint32_t end;
+
+	end = mips_cycles();
+	pcounter_inc(&dumbvm_stats, path + DVS_RS_COUNT);
+	if (end >= start) {
+		pcounter_inc(&dumbvm_stats, path + DVS_RS_TIMED);
+		pcounter_add(&dumbvm_stats, path + DVS_RS_CYCLES, end - start);
+		pcounter_max(&dumbvm_stats, path + DVS_RS_MAX, end - start);
+	}
+}
+
+static
+void
+tlbcache_clear(struct addrspace *as)
+{
+	unsigned i;
+
+	for (i=0; i<TLBCACHE_SIZE; i++) {
+		as->as_tlbcache[i].tc_vpage = TLBCACHE_EMPTY;
+	}
+}
+
+#if OPT_A3
+/*
+ * Regions. Each maps VR_NPAGES pages of a vmobj, starting at page
+ * VR_OBJPAGE of the object, and they never overlap each other or the
+ * text and data segments. The list is short and only searched on the
+ * slow fault path.
+ */
+
+static
+struct vm_region *
+as_findregion(struct addrspace *as, vaddr_t vaddr)
+{
+	struct vm_region *vr;
+	unsigned i, num;
+
+	num = array_num(&as->as_regions);
+	for (i=0; i<num; i++) {
+		vr = array_get(&as->as_regions, i);
+		if (vaddr >= vr->vr_base &&
+		    vaddr < vr->vr_base + vr->vr_npages * PAGE_SIZE) {
+			return vr;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Does [START, END) overlap a region? If ALL is false, only regions
+ * other than mmaps count. If so, *BUSY is set to where it starts.
+ */
+static
+bool
+as_regionoverlap(struct addrspace *as, vaddr_t start, vaddr_t end,
+		 bool all, vaddr_t *busy)
+{
+	struct vm_region *vr;
+	unsigned i, num;
+
+	num = array_num(&as->as_regions);
+	for (i=0; i<num; i++) {
+		vr = array_get(&as->as_regions, i);
+		if ((all || vr->vr_kind != VR_MMAP) &&
+		    start < vr->vr_base + vr->vr_npages * PAGE_SIZE &&
+		    end > vr->vr_base) {
+			*busy = vr->vr_base;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Does [START, END) overlap anything mmap may not replace: the text
+ * and data segments, or a region that isn't an mmap? If so, *BUSY is
+ * set to where it starts.
+ */
+static
+bool
+as_segoverlap(struct addrspace *as, vaddr_t start, vaddr_t end,
+	      vaddr_t *busy)
+{
+	vaddr_t segs[2][2];
+	unsigned i;
+
+	segs[0][0] = as->as_vbase1;
+	segs[0][1] = as->as_vbase1 + as->as_npages1 * PAGE_SIZE;
+	segs[1][0] = as->as_vbase2;
+	segs[1][1] = as->as_vbase2 + as->as_npages2 * PAGE_SIZE;
+
+	for (i=0; i<2; i++) {
+		if (segs[i][0] < segs[i][1] &&
+		    start < segs[i][1] && end > segs[i][0]) {
+			*busy = segs[i][0];
+			return true;
+		}
+	}
+	return as_regionoverlap(as, start, end, false, busy);
+}
+
+/*
+ * Add a region. Takes over the caller's reference to OBJ on success.
+ */
+static
+int
+as_addregion(struct addrspace *as, vaddr_t base, unsigned npages, int prot,
+	     int kind, bool shared, struct vmobj *obj, unsigned objpage)
+{
+	struct vm_region *vr;
+	int result;
+
+	vr = kmalloc(sizeof(*vr));
+	if (vr == NULL) {
+		return ENOMEM;
+	}
+	vr->vr_base = base;
+	vr->vr_npages = npages;
+	vr->vr_prot = prot;
+	vr->vr_kind = kind;
+	vr->vr_shared = shared;
+	vr->vr_obj = obj;
+	vr->vr_objpage = objpage;
+	result = array_add(&as->as_regions, vr, NULL);
+	if (result) {
+		kfree(vr);
+		return result;
+	}
+	return 0;
+}
+
+/*
+ * Remove region number I, dropping its object.
+ */
+static
+void
+as_removeregion(struct addrspace *as, unsigned i)
+{
+	struct vm_region *vr;
+
+	vr = array_get(&as->as_regions, i);
+	array_remove(&as->as_regions, i);
+	vmobj_decref(vr->vr_obj);
+	kfree(vr);
+}
+
+/*
+ * Find a hole for NPAGES, working down from just below the stack
+ * (leaving a guard page) so as to stay out of the way of the heap.
+ */
+static
+int
+as_findgap(struct addrspace *as, unsigned npages, vaddr_t *ret)
+{
+	vaddr_t top, len, busy;
+
+	len = npages * PAGE_SIZE;
+	top = USERSTACK - (DUMBVM_STACKMAX + 1) * PAGE_SIZE;
+	while (len < top && top - len >= PAGE_SIZE) {
+		if (!as_segoverlap(as, top - len, top, &busy) &&
+		    !as_regionoverlap(as, top - len, top, true, &busy)) {
+			*ret = top - len;
+			return 0;
+		}
+		top = busy;
+	}
+	return ENOMEM;
+}
+
+/*
+ * Fault handling for regions. Writable pages of writeback objects are
+ * mapped read-only until first written, so that the write faults and
+ * the page gets marked dirty. Segments are writable while the program
+ * is being loaded into them.
+ */
+static
+int
+as_regionfault(struct addrspace *as, int faulttype, vaddr_t faultaddress,
+	       paddr_t *paddr, bool *writable)
+{
+	struct vm_region *vr;
+	bool write, dirty;
+	int prot, result;
+
+	vr = as_findregion(as, faultaddress);
+	if (vr == NULL) {
+		return EFAULT;
+	}
+	prot = vr->vr_prot;
+	if (vr->vr_kind == VR_SEGMENT && as->load_complete) {
+		prot |= PROT_WRITE;
+	}
+	write = faulttype != VM_FAULT_READ;
+	if ((prot & (PROT_READ | PROT_WRITE | PROT_EXEC)) == 0 ||
+	    (write && (prot & PROT_WRITE) == 0)) {
+		return EFAULT;
+	}
+	result = vmobj_getpage(vr->vr_obj, vr->vr_objpage +
+			       (faultaddress - vr->vr_base) / PAGE_SIZE,
+			       write, paddr, &dirty);
+	if (result) {
+		return result;
+	}
+	*writable = (prot & PROT_WRITE) != 0 &&
+		(dirty || !vr->vr_obj->vo_writeback);
+	return 0;
+}
+
+int
+as_map(struct addrspace *as, vaddr_t *addr, unsigned npages, int prot,
+       bool shared, bool fixed, struct vmobj *obj, unsigned objpage)
+{
+	vaddr_t start, busy;
+	int result;
+
+	if (npages == 0) {
+		return EINVAL;
+	}
+	if (fixed) {
+		start = *addr;
+		if ((start & PAGE_FRAME) != start || start == 0 ||
+		    npages > (USERSPACETOP - start) / PAGE_SIZE ||
+		    as_segoverlap(as, start, start + npages * PAGE_SIZE,
+				  &busy)) {
+			return EINVAL;
+		}
+		/* a fixed mapping replaces whatever was mapped there */
+		result = as_unmap(as, start, npages);
+		if (result) {
+			return result;
+		}
+	}
+	else {
+		result = as_findgap(as, npages, &start);
+		if (result) {
+			return result;
+		}
+	}
+
+	result = as_addregion(as, start, npages, prot, VR_MMAP, shared,
+			      obj, objpage);
+	if (result) {
+		return result;
+	}
+	*addr = start;
+	return 0;
+}
+
+int
+as_unmap(struct addrspace *as, vaddr_t addr, unsigned npages)
+{
+	struct vm_region *vr, *tail;
+	vaddr_t start, end, vend, ostart, oend;
+	unsigned i, n;
+	int result;
+
+	start = addr;
+	end = addr + npages * PAGE_SIZE;
+	i = 0;
+	while (i < array_num(&as->as_regions)) {
+		vr = array_get(&as->as_regions, i);
+		vend = vr->vr_base + vr->vr_npages * PAGE_SIZE;
+		if (vr->vr_kind != VR_MMAP ||
+		    vend <= start || vr->vr_base >= end) {
+			i++;
+			continue;
+		}
+		ostart = start > vr->vr_base ? start : vr->vr_base;
+		oend = end < vend ? end : vend;
+		n = (oend - ostart) / PAGE_SIZE;
+
+		/* unmapping the middle leaves two regions */
+		tail = NULL;
+		if (ostart > vr->vr_base && oend < vend) {
+			tail = kmalloc(sizeof(*tail));
+			if (tail == NULL) {
+				return ENOMEM;
+			}
+			*tail = *vr;
+			tail->vr_base = oend;
+			tail->vr_npages = (vend - oend) / PAGE_SIZE;
+			tail->vr_objpage += (oend - vr->vr_base) / PAGE_SIZE;
+			result = array_add(&as->as_regions, tail, NULL);
+			if (result) {
+				kfree(tail);
+				return result;
+			}
+			vmobj_incref(vr->vr_obj);
+		}
+
+		vmobj_sync(vr->vr_obj,
+			   vr->vr_objpage + (ostart - vr->vr_base) / PAGE_SIZE,
+			   n);
+		as_invalidate(as, ostart, n);
+
+		if (tail != NULL) {
+			vr->vr_npages = (ostart - vr->vr_base) / PAGE_SIZE;
+		}
+		else if (n == vr->vr_npages) {
+			as_removeregion(as, i);
+			continue;
+		}
+		else if (ostart == vr->vr_base) {
+			vr->vr_base = oend;
+			vr->vr_objpage += n;
+			vr->vr_npages -= n;
+		}
+		else {
+			vr->vr_npages -= n;
+		}
+		i++;
+	}
+	return 0;
 }
 
-void
-vm_tlbshootdown_all(void)
+int
+as_sync(struct addrspace *as, vaddr_t addr, unsigned npages)
 {
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	struct vm_region *vr;
+	vaddr_t start, end, vend, ostart, oend;
+	unsigned i, num;
+	bool found = false;
+	int result;
+
+	start = addr;
+	end = addr + npages * PAGE_SIZE;
+	num = array_num(&as->as_regions);
+	for (i=0; i<num; i++) {
+		vr = array_get(&as->as_regions, i);
+		vend = vr->vr_base + vr->vr_npages * PAGE_SIZE;
+		if (vend <= start || vr->vr_base >= end) {
+			continue;
+		}
+		found = true;
+		ostart = start > vr->vr_base ? start : vr->vr_base;
+		oend = end < vend ? end : vend;
+		result = vmobj_sync(vr->vr_obj, vr->vr_objpage +
+				    (ostart - vr->vr_base) / PAGE_SIZE,
+				    (oend - ostart) / PAGE_SIZE);
+		if (result) {
+			return result;
+		}
+	}
+	return found ? 0 : ENOMEM;
 }
 
-void
-vm_tlbshootdown(const struct tlbshootdown *ts)
+/*
+ * The heap is one region from as_heapbase, covering the pages up to
+ * the break; there is no region while the heap is empty.
+ */
+int
+as_sbrk(struct addrspace *as, int change, vaddr_t *oldbreak)
 {
-	(void)ts;
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	struct vm_region *vr = NULL;
+	vaddr_t newend, busy;
+	unsigned i, num, oldpages, newpages;
+	struct vmobj *obj;
+	int result;
+
+	if (change < 0 && (vaddr_t)-change > as->as_heapend - as->as_heapbase) {
+		return EINVAL;
+	}
+	if (change > 0 && (vaddr_t)change > USERSPACETOP - as->as_heapend) {
+		return ENOMEM;
+	}
+	newend = as->as_heapend + change;
+	oldpages = (as->as_heapend - as->as_heapbase + PAGE_SIZE - 1) / PAGE_SIZE;
+	newpages = (newend - as->as_heapbase + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	num = array_num(&as->as_regions);
+	for (i=0; i<num; i++) {
+		vr = array_get(&as->as_regions, i);
+		if (vr->vr_kind == VR_HEAP) {
+			break;
+		}
+		vr = NULL;
+	}
+	KASSERT(vr != NULL || oldpages == 0);
+
+	if (newpages > oldpages) {
+		if (as_regionoverlap(as, as->as_heapbase + oldpages * PAGE_SIZE,
+				     as->as_heapbase + newpages * PAGE_SIZE,
+				     true, &busy)) {
+			return ENOMEM;
+		}
+		if (vr == NULL) {
+			obj = vmobj_create(NULL, 0, newpages);
+			if (obj == NULL) {
+				return ENOMEM;
+			}
+			result = as_addregion(as, as->as_heapbase, newpages,
+					      PROT_READ | PROT_WRITE, VR_HEAP,
+					      false, obj, 0);
+			if (result) {
+				vmobj_decref(obj);
+				return result;
+			}
+		}
+		else {
+			result = vmobj_resize(vr->vr_obj, newpages);
+			if (result) {
+				return result;
+			}
+			vr->vr_npages = newpages;
+		}
+	}
+	else if (newpages < oldpages) {
+		/* out of the TLBs before the frames go back */
+		as_invalidate(as, as->as_heapbase + newpages * PAGE_SIZE,
+			      oldpages - newpages);
+		if (newpages == 0) {
+			as_removeregion(as, i);
+		}
+		else {
+			vmobj_resize(vr->vr_obj, newpages);
+			vr->vr_npages = newpages;
+		}
+	}
+
+	*oldbreak = as->as_heapend;
+	as->as_heapend = newend;
+	return 0;
 }
+#endif //OPT_A3
 
+/*
+ * The general fault path: work out the translation from the regions
+ * and remember it in the software TLB.
+ */
+static
 int
-vm_fault(int faulttype, vaddr_t faultaddress)
+vm_fault_slow(int faulttype, vaddr_t faultaddress, uint32_t start)
 {
-	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+	vaddr_t vbase1, vtop1, vbase2, vtop2;
 	paddr_t paddr;
-	int i;
+	struct tlbcache_entry *tc;
+	int result;
 #if OPT_A3
-	uint32_t ehi, elo, TLBLO_DIRTY_OFF;
+	uint32_t elo, TLBLO_DIRTY_OFF;
+	bool region = false, writable = false;
 	TLBLO_DIRTY_OFF = TLBLO_DIRTY;
 #else
-	uint32_t ehi, elo;
+	vaddr_t stackbase, stacktop;
+	uint32_t elo;
 #endif //OPTA3
 	struct addrspace *as;
-	int spl;
-
-	faultaddress &= PAGE_FRAME;
 
 	DEBUG(DB_VM, "dumbvm: fault: 0x%x\n", faultaddress);
+	EVTRACE(EV_FAULT, faultaddress, faulttype);
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
 		    #if OPT_A3
-		    	return EROFS;
+			/* text (EROFS), or a first write to a mapped page */
+			break;
 		    #endif
 			/* We always create pages read-write, so we can't get this */
 			panic("dumbvm: got VM_FAULT_READONLY\n");
@@ -284,19 +1151,22 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	KASSERT(as->as_vbase2 != 0);
 	KASSERT(as->as_pbase2 != 0);
 	KASSERT(as->as_npages2 != 0);
-	KASSERT(as->as_stackpbase != 0);
 	KASSERT((as->as_vbase1 & PAGE_FRAME) == as->as_vbase1);
 	KASSERT((as->as_pbase1 & PAGE_FRAME) == as->as_pbase1);
 	KASSERT((as->as_vbase2 & PAGE_FRAME) == as->as_vbase2);
 	KASSERT((as->as_pbase2 & PAGE_FRAME) == as->as_pbase2);
-	KASSERT((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
 
 	vbase1 = as->as_vbase1;
 	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
 	vbase2 = as->as_vbase2;
 	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+#if !OPT_A3
+	/* (with regions, the stack is one of them) */
+	KASSERT(as->as_stackpbase != 0);
+	KASSERT((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
 	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
 	stacktop = USERSTACK;
+#endif
 
 	// code(text)
 	if (faultaddress >= vbase1 && faultaddress < vtop1) {
@@ -312,54 +1182,149 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		paddr = (faultaddress - vbase2) + as->as_pbase2;
 
 	}
+#if !OPT_A3
 	//stack
 	else if (faultaddress >= stackbase && faultaddress < stacktop) {
 
 		paddr = (faultaddress - stackbase) + as->as_stackpbase;
 
 	}
+#endif
 	else {
+#if OPT_A3
+		result = as_regionfault(as, faulttype, faultaddress,
+					&paddr, &writable);
+		if (result) {
+			return result;
+		}
+		region = true;
+#else
 		return EFAULT;
+#endif //OPT_A3
+	}
+#if OPT_A3
+	if (faulttype == VM_FAULT_READONLY && !region) {
+		/* text is the only read-only segment */
+		return EROFS;
 	}
+#endif //OPT_A3
 
 	/* make sure it's page-aligned */
 	KASSERT((paddr & PAGE_FRAME) == paddr);
 #if OPT_A3
-	if(as->load_complete){
+	if (region) {
+		TLBLO_DIRTY_OFF = writable ? TLBLO_DIRTY : 0;
+	}
+	/* shared text is never writable, even while loading the rest */
+	else if(as->load_complete && as->as_text == NULL){
 		TLBLO_DIRTY_OFF = TLBLO_DIRTY;
 	}
+	elo = paddr | TLBLO_DIRTY_OFF | TLBLO_VALID;
+#else
+	elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
 #endif //OPT_A3
-	/* Disable interrupts on this CPU while frobbing the TLB. */
-	spl = splhigh();
+	tc = &as->as_tlbcache[TLBCACHE_HASH(faultaddress)];
+	tc->tc_vpage = faultaddress;
+	tc->tc_elo = elo;
 
-	for (i=0; i<NUM_TLB; i++) {
-		tlb_read(&ehi, &elo, i);
-		if (elo & TLBLO_VALID) {
-			continue;
+	/* dumbvm pages are always resident, so every fault is a reload */
+	vmstats_inc(VMSTAT_TLB_FAULT);
+	vmstats_inc(VMSTAT_TLB_RELOAD);
+
+	DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
+#if OPT_A3
+	if (faulttype == VM_FAULT_READONLY) {
+		result = dumbvm_tlbupdate(faultaddress, elo);
+	}
+	else {
+		result = dumbvm_tlbload(faultaddress, elo);
+	}
+#else
+	result = dumbvm_tlbload(faultaddress, elo);
+#endif //OPT_A3
+	dumbvm_refilldone(DVS_SLOW, start);
+	return result;
+}
+
+/*
+ * TLB miss handler. A read or write miss on a page the software TLB
+ * already knows about is refilled straight from it; everything else
+ * goes the long way round.
+ *
+ * p_addrspace is read without the proc lock: only this thread ever
+ * changes its own process's address space.
+ */
+int
+vm_fault(int faulttype, vaddr_t faultaddress)
+{
+	struct addrspace *as;
+	struct tlbcache_entry *tc;
+	uint32_t start;
+	int result;
+
+	start = mips_cycles();
+	faultaddress &= PAGE_FRAME;
+	curthread->t_usage.tu_faults++;
+
+	if (faulttype != VM_FAULT_READONLY && curproc != NULL &&
+	    (as = curproc->p_addrspace) != NULL) {
+		tc = &as->as_tlbcache[TLBCACHE_HASH(faultaddress)];
+		if (tc->tc_vpage == faultaddress) {
+			vmstats_inc(VMSTAT_TLB_FAULT);
+			vmstats_inc(VMSTAT_TLB_RELOAD);
+			result = dumbvm_tlbload(faultaddress, tc->tc_elo);
+			dumbvm_refilldone(DVS_FAST, start);
+			return result;
 		}
-		ehi = faultaddress;
-	#if OPT_A3
-		elo = paddr | TLBLO_DIRTY_OFF | TLBLO_VALID;
-	#else
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
-	#endif //OPT_A3
-		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
-		tlb_write(ehi, elo, i);
-		splx(spl);
-		return 0;
 	}
+
+	return vm_fault_slow(faulttype, faultaddress, start);
+}
+
+/*
+ * Print and reset the TLB refill statistics, summed over all cpus.
+ * Cycles run from vm_fault entry to the TLB write, so they leave out
+ * the trap entry and return.
+ */
+void
+vm_printstats(void)
+{
+	unsigned i, path;
+	uint64_t timed;
+
+	kprintf("TLB refill cycles:\n");
+	kprintf("%-6s %10s %10s %10s %10s\n",
+		"path", "refills", "timed", "avg", "max");
+	for (i=0; i<2; i++) {
+		path = (i == 0) ? DVS_FAST : DVS_SLOW;
+		timed = pcounter_read(&dumbvm_stats, path + DVS_RS_TIMED);
+		kprintf("%-6s %10llu %10llu %10llu %10llu\n",
+			(i == 0) ? "fast" : "slow",
+			pcounter_read(&dumbvm_stats, path + DVS_RS_COUNT),
+			timed,
+			timed ? pcounter_read(&dumbvm_stats,
+					      path + DVS_RS_CYCLES) / timed : 0,
+			pcounter_readmax(&dumbvm_stats, path + DVS_RS_MAX));
+	}
+
+	kprintf("TLB shootdown: %llu pages requested, %llu IPIs sent, "
+		"%llu entries invalidated, %llu full flushes\n",
+		pcounter_read(&dumbvm_stats, DVS_SHOOTREQS),
+		pcounter_read(&dumbvm_stats, DVS_IPIS),
+		pcounter_read(&dumbvm_stats, DVS_TLBINVAL),
+		pcounter_read(&dumbvm_stats, DVS_TLBFLUSH));
 #if OPT_A3
-	ehi = faultaddress;
-	elo = paddr | TLBLO_DIRTY_OFF | TLBLO_VALID;
-	tlb_random(ehi, elo);
-	splx(spl);
-	return 0;
-#else
-	kprintf("dumbvm: Ran out of TLB entries - cannot handle page fault\n");
- 
-	splx(spl);
-	return EFAULT;
-#endif //opt-a3
+	kprintf("Text cache: %llu hits, %llu misses, %u images cached\n",
+		pcounter_read(&dumbvm_stats, DVS_TEXTHITS),
+		pcounter_read(&dumbvm_stats, DVS_TEXTMISSES),
+		array_num(&textcache));
+#endif //OPT_A3
+}
+
+void
+vm_resetstats(void)
+{
+	pcounter_reset(&dumbvm_stats);
 }
 
 struct addrspace *
@@ -377,8 +1342,18 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_asid = 0;
+	as->as_asidgen = 0;
+	as->as_cpumask = 0;
+	tlbcache_clear(as);
 #if OPT_A3
 	as->load_complete = false;
+	as->as_textro = false;
+	as->as_image = NULL;
+	as->as_text = NULL;
+	array_init(&as->as_regions);
+	as->as_heapbase = 0;
+	as->as_heapend = 0;
 #endif //OPT_A3
 	return as;
 }
@@ -386,17 +1361,43 @@ as_create(void)
 void
 as_destroy(struct addrspace *as)
 {
+#if OPT_A3
+	struct vm_region *vr;
+
+	/* unmapping writes back what was written through shared maps */
+	while (array_num(&as->as_regions) > 0) {
+		vr = array_get(&as->as_regions, 0);
+		vmobj_sync(vr->vr_obj, vr->vr_objpage, vr->vr_npages);
+		as_removeregion(as, 0);
+	}
+	array_cleanup(&as->as_regions);
+
+	if (as->as_text != NULL) {
+		textimage_release(as->as_text);
+	}
+	else {
+		free_kpages(as->as_pbase1);
+	}
+#else
 	free_kpages(as->as_pbase1);
+#endif //OPT_A3
 	free_kpages(as->as_pbase2);
 	free_kpages(as->as_stackpbase);
 	kfree(as);
 }
 
+/*
+ * Switching address spaces only changes the current ASID; the TLB is
+ * flushed only when this cpu's contents are from an older ASID
+ * generation.
+ */
 void
 as_activate(void)
 {
-	int i, spl;
+	int spl;
 	struct addrspace *as;
+	struct dumbvm_cpu *vc;
+	bool flush;
 
 	as = curproc_getas();
 #ifdef UW
@@ -409,8 +1410,32 @@ as_activate(void)
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
-	for (i=0; i<NUM_TLB; i++) {
-		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	spinlock_acquire(&asid_lock);
+	if (as->as_asidgen != asid_generation) {
+		if (asid_next == NUM_ASID) {
+			asid_generation++;
+			asid_next = 0;
+		}
+		as->as_asid = asid_next++;
+		as->as_asidgen = asid_generation;
+		/*
+		 * Keep as_cpumask: other threads of this address space
+		 * may still be running under the old ASID on cpus that
+		 * haven't flushed yet, and need shooting down too.
+		 */
+	}
+	as->as_cpumask |= (uint32_t)1 << curcpu->c_number;
+	vc = &dumbvm_cpus[curcpu->c_number];
+	flush = vc->vc_asidgen != asid_generation;
+	vc->vc_asidgen = asid_generation;
+	vc->vc_curasid = as->as_asid;
+	spinlock_release(&asid_lock);
+
+	if (flush) {
+		dumbvm_tlbflush(vc);
+	}
+	else {
+		tlb_setasid(vc->vc_curasid);
 	}
 
 	splx(spl);
@@ -437,14 +1462,26 @@ as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 
 	npages = sz / PAGE_SIZE;
 
+#if OPT_A3
+	/* the heap starts after the highest segment */
+	if (vaddr + sz > as->as_heapbase) {
+		as->as_heapbase = vaddr + sz;
+		as->as_heapend = as->as_heapbase;
+	}
+#else
 	/* We don't use these - all pages are read-write */
 	(void)readable;
 	(void)writeable;
 	(void)executable;
+#endif //OPT_A3
 
 	if (as->as_vbase1 == 0) {
 		as->as_vbase1 = vaddr;
 		as->as_npages1 = npages;
+#if OPT_A3
+		/* only read-only text can be shared */
+		as->as_textro = !writeable;
+#endif //OPT_A3
 		return 0;
 	}
 
@@ -454,11 +1491,40 @@ as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 		return 0;
 	}
 
+#if OPT_A3
+	/* the rest are regions, zero-filled when touched */
+	{
+		struct vmobj *obj;
+		vaddr_t busy;
+		int result;
+
+		if (npages == 0) {
+			return 0;
+		}
+		if (as_segoverlap(as, vaddr, vaddr + sz, &busy)) {
+			return EINVAL;
+		}
+		obj = vmobj_create(NULL, 0, npages);
+		if (obj == NULL) {
+			return ENOMEM;
+		}
+		result = as_addregion(as, vaddr, npages,
+				      (readable ? PROT_READ : 0) |
+				      (writeable ? PROT_WRITE : 0) |
+				      (executable ? PROT_EXEC : 0),
+				      VR_SEGMENT, false, obj, 0);
+		if (result) {
+			vmobj_decref(obj);
+		}
+		return result;
+	}
+#else
 	/*
 	 * Support for more than two regions is not available.
 	 */
 	kprintf("dumbvm: Warning: too many regions\n");
 	return EUNIMP;
+#endif //OPT_A3
 }
 
 static
@@ -471,30 +1537,51 @@ as_zero_region(paddr_t paddr, unsigned npages)
 int
 as_prepare_load(struct addrspace *as)
 {
-	KASSERT(as->as_pbase1 == 0);
 	KASSERT(as->as_pbase2 == 0);
 	KASSERT(as->as_stackpbase == 0);
 
+#if OPT_A3
+	/* Text may already be there: cached (exec) or shared (fork). */
+	if (as->as_text == NULL && as->as_textro && as->as_image != NULL) {
+		as->as_text = textcache_get(as->as_image,
+					    as->as_vbase1, as->as_npages1);
+		if (as->as_text != NULL) {
+			as->as_pbase1 = as->as_text->ti_pbase;
+		}
+	}
+	if (as->as_text == NULL) {
+		KASSERT(as->as_pbase1 == 0);
+		as->as_pbase1 = getppages(as->as_npages1);
+		if (as->as_pbase1 == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_pbase1, as->as_npages1);
+	}
+#else
+	KASSERT(as->as_pbase1 == 0);
 	as->as_pbase1 = getppages(as->as_npages1);
 	if (as->as_pbase1 == 0) {
 		return ENOMEM;
 	}
+#endif //OPT_A3
 
 	as->as_pbase2 = getppages(as->as_npages2);
 	if (as->as_pbase2 == 0) {
 		return ENOMEM;
 	}
 
+#if OPT_A3
+	/* the stack comes with as_define_stack, a page at a time */
+	as->load_complete = true;
+#else
 	as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
 	if (as->as_stackpbase == 0) {
 		return ENOMEM;
 	}
-#if OPT_A3
-	as->load_complete = true;
-#endif //OPT_A3
 	as_zero_region(as->as_pbase1, as->as_npages1);
-	as_zero_region(as->as_pbase2, as->as_npages2);
 	as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
+#endif //OPT_A3
+	as_zero_region(as->as_pbase2, as->as_npages2);
 
 	return 0;
 }
@@ -505,19 +1592,176 @@ as_complete_load(struct addrspace *as)
 	(void)as;
 #if OPT_A3
 	as->load_complete = false;//since 
+	if (as->as_text == NULL && as->as_textro) {
+		/* if this fails the text just stays private */
+		as->as_text = textimage_create(as, as->as_image);
+	}
+	as->as_image = NULL;
 #endif //OPT_A3
+	/*
+	 * Entries made while loading may allow writes to the text
+	 * segment. They are no longer flushed at every switch, and may be
+	 * on more than one cpu, so shoot them down. The rest of the
+	 * address space's entries stay.
+	 */
+	as_invalidate(as, as->as_vbase1, as->as_npages1);
 	return 0;
 }
 
 int
 as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 {
+#if OPT_A3
+	struct vmobj *obj;
+	vaddr_t base, busy;
+	int result;
+
+	/*
+	 * Reserve DUMBVM_STACKMAX pages; only those the program touches
+	 * get frames, so the stack grows as it is used.
+	 */
+	base = USERSTACK - DUMBVM_STACKMAX * PAGE_SIZE;
+	if (as_segoverlap(as, base, USERSTACK, &busy)) {
+		return ENOMEM;
+	}
+	obj = vmobj_create(NULL, 0, DUMBVM_STACKMAX);
+	if (obj == NULL) {
+		return ENOMEM;
+	}
+	result = as_addregion(as, base, DUMBVM_STACKMAX,
+			      PROT_READ | PROT_WRITE, VR_STACK, false,
+			      obj, 0);
+	if (result) {
+		vmobj_decref(obj);
+		return result;
+	}
+#else
 	KASSERT(as->as_stackpbase != 0);
+#endif //OPT_A3
 
 	*stackptr = USERSTACK;
 	return 0;
 }
 
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	vaddr_t vbase1, vtop1, vbase2, vtop2;
+	paddr_t paddr;
+
+	vbase1 = as->as_vbase1;
+	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
+	vbase2 = as->as_vbase2;
+	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		paddr = as->as_pbase1 + (vaddr - vbase1);
+	}
+	else if (vaddr >= vbase2 && vaddr < vtop2) {
+		paddr = as->as_pbase2 + (vaddr - vbase2);
+	}
+#if !OPT_A3
+	else if (vaddr >= USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE &&
+		 vaddr < USERSTACK) {
+		paddr = as->as_stackpbase +
+			(vaddr - (USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE));
+	}
+#endif
+	else {
+#if OPT_A3
+		struct vm_region *vr;
+		bool dirty;
+		int result;
+
+		/* reading only, so this never dirties the page */
+		vr = as_findregion(as, vaddr);
+		if (vr == NULL || (vr->vr_prot & PROT_READ) == 0) {
+			return EFAULT;
+		}
+		result = vmobj_getpage(vr->vr_obj, vr->vr_objpage +
+				       (vaddr - vr->vr_base) / PAGE_SIZE,
+				       false, &paddr, &dirty);
+		if (result) {
+			return result;
+		}
+		*ret = paddr + (vaddr & ~PAGE_FRAME);
+		return 0;
+#else
+		return EFAULT;
+#endif //OPT_A3
+	}
+	*ret = paddr;
+	return 0;
+}
+
+void
+as_set_image(struct addrspace *as, struct vnode *v)
+{
+#if OPT_A3
+	as->as_image = v;
+#else
+	(void)as;
+	(void)v;
+#endif //OPT_A3
+}
+
+bool
+as_segment_loaded(struct addrspace *as, vaddr_t vaddr)
+{
+#if OPT_A3
+	/* text from an image is complete already; see as_prepare_load */
+	return as->as_text != NULL && as->as_image != NULL &&
+		vaddr >= as->as_vbase1 &&
+		vaddr < as->as_vbase1 + as->as_npages1 * PAGE_SIZE;
+#else
+	(void)as;
+	(void)vaddr;
+	return false;
+#endif //OPT_A3
+}
+
+#if OPT_A3
+/*
+ * Give NEW the regions of OLD: shared regions map the same object,
+ * private ones get a copy of the pages touched so far.
+ */
+static
+int
+as_copyregions(struct addrspace *old, struct addrspace *new)
+{
+	struct vm_region *vr, *nvr;
+	unsigned i, num;
+	int result;
+
+	num = array_num(&old->as_regions);
+	for (i=0; i<num; i++) {
+		vr = array_get(&old->as_regions, i);
+		nvr = kmalloc(sizeof(*nvr));
+		if (nvr == NULL) {
+			return ENOMEM;
+		}
+		*nvr = *vr;
+		if (vr->vr_shared) {
+			vmobj_incref(vr->vr_obj);
+		}
+		else {
+			nvr->vr_obj = vmobj_copy(vr->vr_obj);
+			if (nvr->vr_obj == NULL) {
+				kfree(nvr);
+				return ENOMEM;
+			}
+		}
+		result = array_add(&new->as_regions, nvr, NULL);
+		if (result) {
+			vmobj_decref(nvr->vr_obj);
+			kfree(nvr);
+			return result;
+		}
+	}
+	return 0;
+}
+#endif //OPT_A3
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
@@ -532,28 +1776,67 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	new->as_npages1 = old->as_npages1;
 	new->as_vbase2 = old->as_vbase2;
 	new->as_npages2 = old->as_npages2;
+#if OPT_A3
+	new->as_textro = old->as_textro;
+	if (old->as_text == NULL && old->as_textro && !old->load_complete) {
+		/* text that didn't make it into the cache; share it anyway */
+		old->as_text = textimage_create(old, NULL);
+	}
+	if (old->as_text != NULL) {
+		/* share the text rather than copying it */
+		lock_acquire(textcache_lock);
+		old->as_text->ti_refs++;
+		lock_release(textcache_lock);
+		new->as_text = old->as_text;
+		new->as_pbase1 = old->as_pbase1;
+	}
+#endif //OPT_A3
 
 	/* (Mis)use as_prepare_load to allocate some physical memory. */
 	if (as_prepare_load(new)) {
 		as_destroy(new);
 		return ENOMEM;
 	}
+#if OPT_A3
+	/* nothing is being loaded; don't leave the text writable */
+	new->load_complete = false;
+#endif //OPT_A3
 
 	KASSERT(new->as_pbase1 != 0);
 	KASSERT(new->as_pbase2 != 0);
+#if !OPT_A3
 	KASSERT(new->as_stackpbase != 0);
+#endif
 
+#if OPT_A3
+	if (new->as_text == NULL) {
+		memmove((void *)PADDR_TO_KVADDR(new->as_pbase1),
+			(const void *)PADDR_TO_KVADDR(old->as_pbase1),
+			old->as_npages1*PAGE_SIZE);
+	}
+#else
 	memmove((void *)PADDR_TO_KVADDR(new->as_pbase1),
 		(const void *)PADDR_TO_KVADDR(old->as_pbase1),
 		old->as_npages1*PAGE_SIZE);
+#endif //OPT_A3
 
 	memmove((void *)PADDR_TO_KVADDR(new->as_pbase2),
 		(const void *)PADDR_TO_KVADDR(old->as_pbase2),
 		old->as_npages2*PAGE_SIZE);
 
+#if OPT_A3
+	/* the stack and heap are regions, and come with the rest */
+	new->as_heapbase = old->as_heapbase;
+	new->as_heapend = old->as_heapend;
+	if (as_copyregions(old, new)) {
+		as_destroy(new);
+		return ENOMEM;
+	}
+#else
 	memmove((void *)PADDR_TO_KVADDR(new->as_stackpbase),
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
 		DUMBVM_STACKPAGES*PAGE_SIZE);
+#endif //OPT_A3
 	
 	*ret = new;
 	return 0;
@@ -31,6 +31,7 @@
 #include <kern/unistd.h>
 #include <lib.h>
 #include <mips/trapframe.h>
+#include <mips/specialreg.h>
 #include <cpu.h>
 #include <spl.h>
 #include <clock.h>
@@ -41,6 +42,10 @@
 #include <sys161/bus.h>
 #include <lamebus/lamebus.h>
 #include "autoconf.h"
+#include "opt-kprof.h"
+#if OPT_KPROF
+#include <kprof.h>
+#endif
 
 /*
  * CPU frequency used by the on-chip timer.
@@ -116,6 +121,18 @@ mainbus_bootstrap(void)
 	mips_timer_set(CPU_FREQUENCY / HZ);
 }
 
+/*
+ * Put off this cpu's next hardclock. The timer counts cycles in 32
+ * bits, so at 25 MHz it can't go more than about 170 seconds.
+ */
+void
+mainbus_timer_defer(unsigned ticks)
+{
+	KASSERT(ticks > 0);
+	KASSERT(ticks <= 0xffffffff / (CPU_FREQUENCY / HZ));
+	mips_timer_set(ticks * (CPU_FREQUENCY / HZ));
+}
+
 /*
  * Start all secondary CPUs.
  */
@@ -260,6 +277,16 @@ mainbus_interrupt(struct trapframe *tf)
 	KASSERT(curthread->t_curspl > 0);
 
 	cause = tf->tf_cause;
+
+	/*
+	 * If our hardclock was put off while idle, catch up first. A
+	 * pending timer interrupt is that hardclock even if something
+	 * else came in with it; it's taken as usual, after the others.
+	 */
+	if (curcpu->c_tickdefer > 0) {
+		hardclock_resume((cause & MIPS_TIMER_BIT) != 0);
+	}
+
 	if (cause & LAMEBUS_IRQ_BIT) {
 		lamebus_interrupt(lamebus);
 	}
@@ -270,6 +297,14 @@ mainbus_interrupt(struct trapframe *tf)
 	else if (cause & MIPS_TIMER_BIT) {
 		/* Reset the timer (this clears the interrupt) */
 		mips_timer_set(CPU_FREQUENCY / HZ);
+#if OPT_KPROF
+		if (kprof_enabled) {
+			kprof_sample(tf->tf_epc,
+				     (tf->tf_status & CST_KUp) != 0);
+		}
+#endif
+		/* charge the tick to whoever it interrupted */
+		thread_chargetick((tf->tf_status & CST_KUp) != 0);
 		/* and call hardclock */
 		hardclock();
 	}
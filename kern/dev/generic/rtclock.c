@@ -68,3 +68,21 @@ gettime(time_t *secs, uint32_t *nsecs)
 	KASSERT(the_clock!=NULL);
 	the_clock->rtc_gettime(the_clock->rtc_devdata, secs, nsecs);
 }
+
+/*
+ * Return the time of day as a single nanosecond count, or 0 if no
+ * clock has been attached yet. This is for instrumentation, which
+ * may run before autoconf has found the clock.
+ */
+uint64_t
+gettime_nsecs(void)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	if (the_clock == NULL) {
+		return 0;
+	}
+	the_clock->rtc_gettime(the_clock->rtc_devdata, &secs, &nsecs);
+	return (uint64_t)secs * 1000000000 + nsecs;
+}
@@ -28,9 +28,11 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <platform/bus.h>
 #include <lamebus/ltrace.h>
+#include <bench.h>
 #include "autoconf.h"
 
 /* Registers (offsets within slot) */
@@ -77,6 +79,48 @@ ltrace_dump(uint32_t code)
 	}
 }
 
+/*
+ * Benchmark markers (see bench.h). The trace flags are only read
+ * here, so a change racing with a marker at worst leaves a flag on
+ * or off for one region.
+ */
+
+#define BENCH_MAXFLAGS 8
+
+static char bench_traceflags[BENCH_MAXFLAGS + 1];
+
+void
+bench_begin(unsigned id)
+{
+	unsigned i;
+
+	ltrace_debug(BENCH_CODE(BENCH_BEGIN, id & BENCH_MAXID));
+	for (i=0; bench_traceflags[i] != 0; i++) {
+		ltrace_on(bench_traceflags[i]);
+	}
+}
+
+void
+bench_end(unsigned id)
+{
+	unsigned i;
+
+	for (i=0; bench_traceflags[i] != 0; i++) {
+		ltrace_off(bench_traceflags[i]);
+	}
+	ltrace_debug(BENCH_CODE(BENCH_END, id & BENCH_MAXID));
+}
+
+int
+bench_settrace(const char *flags)
+{
+	if (strlen(flags) > BENCH_MAXFLAGS) {
+		return EINVAL;
+	}
+	strcpy(bench_traceflags, flags);
+	return 0;
+}
+
 int
 config_ltrace(struct ltrace_softc *sc, int ltraceno)
 {
@@ -36,8 +36,48 @@
 
 
 #include <vm.h>
+#include <array.h>
 #include "opt-A3.h"
 struct vnode;
+struct vmobj;
+
+/*
+ * Software TLB: a direct-mapped cache of recent translations, so a
+ * TLB miss on a page seen before can be refilled without walking the
+ * regions. tc_vpage is TLBCACHE_EMPTY (never page-aligned) if unused.
+ */
+#define TLBCACHE_SIZE      64
+#define TLBCACHE_HASH(va)  (((va) >> 12) % TLBCACHE_SIZE)
+#define TLBCACHE_EMPTY     0xffffffff
+
+struct tlbcache_entry {
+  vaddr_t tc_vpage;
+  uint32_t tc_elo;		/* TLB EntryLo to load */
+};
+
+#if OPT_A3
+/*
+ * A region: VR_NPAGES pages of VR_OBJ from page VR_OBJPAGE, mapped at
+ * VR_BASE. Pages are found (and read in, or zeroed) on demand by
+ * vm_fault, so only pages that have been touched take up memory.
+ * Besides mmap, regions hold the heap, the stack, and any program
+ * segments after the first two; only mmap regions can be unmapped.
+ */
+struct vm_region {
+  vaddr_t vr_base;
+  unsigned vr_npages;
+  int vr_prot;			/* PROT_* from <kern/mman.h> */
+  int vr_kind;			/* VR_* below */
+  bool vr_shared;		/* MAP_SHARED: fork shares, not copies */
+  struct vmobj *vr_obj;		/* one reference per region */
+  unsigned vr_objpage;
+};
+
+#define VR_MMAP     0		/* from mmap or shm_attach */
+#define VR_SEGMENT  1		/* program segment from as_define_region */
+#define VR_HEAP     2		/* moved by sbrk */
+#define VR_STACK    3		/* the user stack */
+#endif//OPT_A3
 
 
 /* 
@@ -55,8 +95,18 @@ struct addrspace {
   paddr_t as_pbase2;
   size_t as_npages2;
   paddr_t as_stackpbase;
+  uint32_t as_asid;		/* TLB tag, valid in generation as_asidgen */
+  uint32_t as_asidgen;		/* 0 if never given an ASID */
+  uint32_t as_cpumask;		/* cpus that may hold our TLB entries */
+  struct tlbcache_entry as_tlbcache[TLBCACHE_SIZE];
 #if OPT_A3
   bool load_complete;
+  bool as_textro;		/* region 1 is read-only */
+  struct vnode *as_image;	/* file being loaded, until complete */
+  struct textimage *as_text;	/* shared text frames, or NULL */
+  struct array as_regions;	/* struct vm_region * */
+  vaddr_t as_heapbase;		/* page after the program's segments */
+  vaddr_t as_heapend;		/* the break */
 #endif//OPT_A3
 };
 
@@ -83,7 +133,8 @@ struct addrspace {
  *                the way this works if implementing user-level threads.
  *
  *    as_define_region - set up a region of memory within the address
- *                space.
+ *                space. The first two are loaded up front; any more
+ *                are paged in on demand like the heap.
  *
  *    as_prepare_load - this is called before actually loading from an
  *                executable into the address space.
@@ -94,6 +145,37 @@ struct addrspace {
  *    as_define_stack - set up the stack region in the address space.
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
+ *
+ *    as_translate - find the physical address backing a user virtual
+ *                address. Returns EFAULT if it isn't mapped.
+ *
+ *    as_set_image - tell the address space which file it is about to
+ *                be loaded from, before as_prepare_load, so read-only
+ *                text already in memory for that file can be shared.
+ *
+ *    as_segment_loaded - after as_prepare_load, true if the segment at
+ *                VADDR is already in memory and must not be loaded
+ *                (it may be shared with other processes).
+ *
+ *    as_invalidate - remove a range of pages from every TLB that may
+ *                hold them, before their mapping changes. Sends at
+ *                most one IPI per other cpu, and only to cpus that
+ *                have run the address space.
+ *
+ *    as_map    - map NPAGES of OBJ from page OBJPAGE, at *ADDR if
+ *                FIXED (replacing any region there) or else wherever
+ *                there is room, returning the address in *ADDR. Takes
+ *                over the caller's reference to OBJ on success.
+ *
+ *    as_unmap  - remove any mappings in NPAGES from ADDR, writing back
+ *                dirty shared pages first.
+ *
+ *    as_sync   - write back dirty shared pages in NPAGES from ADDR.
+ *                ENOMEM if nothing is mapped there.
+ *
+ *    as_sbrk   - move the break by CHANGE bytes, returning the old
+ *                one. Pages come and go with the break; they are
+ *                zeroed when first touched.
  */
 
 struct addrspace *as_create(void);
@@ -110,6 +192,23 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_translate(struct addrspace *as, vaddr_t vaddr,
+                               paddr_t *ret);
+void              as_set_image(struct addrspace *as, struct vnode *v);
+bool              as_segment_loaded(struct addrspace *as, vaddr_t vaddr);
+void              as_invalidate(struct addrspace *as, vaddr_t vaddr,
+                                unsigned npages);
+#if OPT_A3
+int               as_map(struct addrspace *as, vaddr_t *addr,
+                         unsigned npages, int prot, bool shared,
+                         bool fixed, struct vmobj *obj, unsigned objpage);
+int               as_unmap(struct addrspace *as, vaddr_t addr,
+                           unsigned npages);
+int               as_sync(struct addrspace *as, vaddr_t addr,
+                          unsigned npages);
+int               as_sbrk(struct addrspace *as, int change,
+                          vaddr_t *oldbreak);
+#endif//OPT_A3
 
 
 /*
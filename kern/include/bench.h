@@ -0,0 +1,27 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/*
+ * Benchmark region markers.
+ *
+ * bench_begin(ID) and bench_end(ID) bracket code to be measured under
+ * System/161. Each passes BENCH_CODE (see kern/bench.h) to the trace
+ * device's debug register, which sys161 logs, so its cycle counts can
+ * be lined up with the region. They cost one bus write each, and
+ * nothing if there is no trace device.
+ *
+ * bench_settrace(FLAGS) names trace161 trace flags (the letters used
+ * on its command line, e.g. "k" for kernel instructions) to turn on
+ * at every bench_begin and off at every bench_end, so a trace covers
+ * just the measured regions. An empty string clears them.
+ *
+ * The markers live with the ltrace driver, in dev/lamebus/ltrace.c.
+ */
+
+#include <kern/bench.h>
+
+void bench_begin(unsigned id);
+void bench_end(unsigned id);
+int bench_settrace(const char *flags);
+
+#endif /* _BENCH_H_ */
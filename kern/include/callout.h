@@ -0,0 +1,64 @@
+#ifndef _CALLOUT_H_
+#define _CALLOUT_H_
+
+/*
+ * Callouts: call a function at some point in the future.
+ *
+ * Each cpu has a hierarchical timer wheel, advanced by its hardclock.
+ * callout_schedule(co, n) puts CO on the current cpu's wheel to go off
+ * N hardclocks from now, on that cpu; it costs the same however far
+ * off that is, and each tick only touches the callouts that are due
+ * (plus, every CALLOUT_SLOTS ticks, a slot's worth being moved down a
+ * level).
+ *
+ * For deadlines finer than a tick, callout_schedule_nsecs(co, when)
+ * goes off once gettime_nsecs() reaches WHEN, using the timer device's
+ * one-shot countdown if there is one (see timerclock_attach) and the
+ * next tick after WHEN otherwise.
+ *
+ * Callout functions are called from the timer interrupt, on no locks,
+ * and must not sleep. A callout goes off once; schedule it again to
+ * repeat. The struct callout belongs to the caller and must stay put
+ * until the callout has gone off or been stopped.
+ */
+
+struct cpu;
+struct spinlock;
+
+struct callout {
+	struct callout *co_next;	/* next on the same list */
+	struct callout **co_prevp;	/* what points to us */
+	uint64_t co_expire;		/* tick or nanosecond it is due */
+	struct spinlock *co_lock;	/* lock of list we're on, or NULL */
+	void (*co_func)(void *);
+	void *co_arg;
+};
+
+/* Set up CO to call FUNC(ARG) when it goes off. */
+void callout_init(struct callout *co, void (*func)(void *), void *arg);
+
+/* Go off TICKS (at least 1) hardclocks from now, on this cpu. */
+void callout_schedule(struct callout *co, unsigned ticks);
+
+/* Go off when gettime_nsecs() reaches WHEN. */
+void callout_schedule_nsecs(struct callout *co, uint64_t when);
+
+/* Cancel CO if it hasn't gone off yet. Returns true if it hadn't. */
+bool callout_stop(struct callout *co);
+
+/*
+ * Ticks until the first callout on this cpu's wheel might be due, or
+ * MAX if that's sooner (or there are none).
+ */
+unsigned callout_nextdue(unsigned max);
+
+/* Set up cpu C's wheel; called from cpu_create. */
+void callout_cpuinit(struct cpu *c);
+
+/* Advance this cpu's wheel by one tick; called from hardclock. */
+void callout_tick(void);
+
+/* Run the fine-grained callouts that are due; called from timerclock. */
+void callout_hires(void);
+
+#endif /* _CALLOUT_H_ */
@@ -38,8 +38,18 @@
  * hardclock() is called on every CPU HZ times a second, possibly only
  * when the CPU is not idle, for scheduling.
  *
- * timerclock() is called on one CPU once a second to allow simple
- * timed operations. (This is a fairly simpleminded interface.)
+ * hardclock() also advances the cpu's callout wheel (see callout.h).
+ *
+ * An idle cpu doesn't take hardclocks it has no use for: the idle
+ * loop calls hardclock_idle(), which puts the next one off until the
+ * cpu's first callout is due, and the next interrupt to arrive on the
+ * cpu (the timer's own, a device's, or a wakeup IPI) calls
+ * hardclock_resume() to run the ticks it missed and start the clock
+ * again.
+ *
+ * timerclock() is called on one CPU when the timer device's one-shot
+ * countdown, started with timerclock_arm(), runs out; it runs the
+ * fine-grained callouts.
  *
  * gettime() may be used to fetch the current time of day.
  * getinterval() computes the time from time1 to time2.
@@ -61,24 +71,49 @@ void hardclock_bootstrap(void);
 void hardclock(void);
 void timerclock(void);
 
+void hardclock_idle(void);
+void hardclock_resume(bool timer);
+
+/*
+ * Called by the timer driver to offer its countdown: ARM(DEVDATA, N)
+ * must make timerclock() get called once, N microseconds from now,
+ * replacing any countdown already going.
+ */
+void timerclock_attach(void *devdata, void (*arm)(void *devdata, uint32_t));
+
+/* Start the countdown. Returns false if there's no timer device. */
+bool timerclock_arm(uint32_t usecs);
+
 void gettime(time_t *seconds, uint32_t *nanoseconds);
 
+/*
+ * gettime_nsecs() is gettime() as one 64-bit nanosecond count, for
+ * timing things. It returns 0 if there is no clock yet.
+ */
+uint64_t gettime_nsecs(void);
+
 void getinterval(time_t secs1, uint32_t nsecs,
                  time_t secs2, uint32_t nsecs2,
                  time_t *rsecs, uint32_t *rnsecs);
 
+/*
+ * clock_nsleep() suspends execution for NSECS nanoseconds, give or
+ * take the time it takes to get going again. Whole hardclock ticks are
+ * slept on the cpu's callout wheel, and what's left on the timer
+ * device. Fails only if it can't allocate the thread's wait channel.
+ */
+int clock_nsleep(uint64_t nsecs);
+
 /*
  * clocksleep() suspends execution for the requested number of seconds,
  * like userlevel sleep(3). (Don't confuse it with wchan_sleep.)
- *
- *  this will be more efficient than clocknap() for longer sleeps
  */
 void clocksleep(int seconds);
 
 /*
  * clocknap() suspends execution for the requested number of timer ticks
  *
- * the timer ticks every LT_GRANULARITY usec (see kern/dev/ltimer.h)
+ * a tick is LT_GRANULARITY usec (see kern/dev/ltimer.h)
  *
  */
 void clocknap(int ticks);
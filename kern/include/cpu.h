@@ -33,6 +33,7 @@
 
 #include <spinlock.h>
 #include <threadlist.h>
+#include <workqueue.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
 
 
@@ -59,7 +60,12 @@ struct cpu {
 	 */
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
+	struct work c_reaper;		/* Destroys them, on our worker */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
+	unsigned c_idleticks;		/* hardclocks that found us idle */
+	unsigned c_skippedticks;	/* of those, ones not taken (tickless) */
+	unsigned c_tickdefer;		/* hardclocks the timer is put off for */
+	uint64_t c_tickdeferat;		/* gettime_nsecs() when it was */
 
 	/*
 	 * Accessed by other cpus.
@@ -152,6 +158,9 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_batch queues several shootdowns with one IPI.
+ * ipi_tlbshootdown_cpus sends a batch to each cpu in a mask but ours.
+ * ipi_tlbshootdown_wait waits until cpus have done their shootdowns.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -166,6 +175,13 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+unsigned ipi_tlbshootdown_batch(struct cpu *target,
+				const struct tlbshootdown *mappings,
+				unsigned num);
+unsigned ipi_tlbshootdown_cpus(uint32_t cpumask,
+			       const struct tlbshootdown *mappings,
+			       unsigned num);
+void ipi_tlbshootdown_wait(uint32_t cpumask);
 
 void interprocessor_interrupt(void);
 
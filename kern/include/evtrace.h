@@ -0,0 +1,106 @@
+#ifndef _EVTRACE_H_
+#define _EVTRACE_H_
+
+/*
+ * Event tracing (evtrace).
+ *
+ * Only available if OPT_EVTRACE is set; otherwise EVTRACE() compiles
+ * to nothing. Each cpu keeps the last EVTRACE_NRECS events it saw in
+ * a ring of fixed-size binary records. Recording an event takes no
+ * locks and prints nothing, so tracing is cheap enough to leave on:
+ * it starts at boot, and etoff/etr in the menu stop it and restart it
+ * with empty rings.
+ *
+ * The menu command et prints the rings merged in time order, one line
+ * per event; "et file" instead writes them to FILE in binary, as a
+ * struct evtrace_header followed by the records, in the kernel's byte
+ * order.
+ *
+ * Events and their arguments:
+ *
+ *    type             arg0              arg1
+ *    EV_SYSCALL       call number       pid
+ *    EV_SYSRET        call number       error, or 0
+ *    EV_SWITCH        next thread       old thread's new state
+ *    EV_SLEEP         wchan             -
+ *    EV_WAKE          wchan             thread woken
+ *    EV_WAKEALL       wchan             -
+ *    EV_FAULT         fault address     fault type
+ *
+ * er_thread is the thread that was running. Syscalls that don't
+ * return (_exit, a successful execv) have no EV_SYSRET. EV_FAULT is
+ * only recorded for faults that go past the TLB refill cache.
+ */
+
+#include "opt-evtrace.h"
+
+#define EV_SYSCALL	1
+#define EV_SYSRET	2
+#define EV_SWITCH	3
+#define EV_SLEEP	4
+#define EV_WAKE		5
+#define EV_WAKEALL	6
+#define EV_FAULT	7
+
+/* Records kept per cpu. */
+#define EVTRACE_NRECS	2048
+
+struct evtrace_rec {
+	uint64_t er_time;		/* nanoseconds, from gettime_nsecs */
+	uint16_t er_type;		/* EV_* */
+	uint16_t er_cpu;		/* cpu number */
+	uint32_t er_thread;		/* struct thread * */
+	uint32_t er_arg0;
+	uint32_t er_arg1;
+};
+
+#define EVTRACE_MAGIC	0x45565452	/* "EVTR" */
+#define EVTRACE_VERSION	1
+
+struct evtrace_header {
+	uint32_t eh_magic;		/* EVTRACE_MAGIC */
+	uint32_t eh_version;		/* EVTRACE_VERSION */
+	uint32_t eh_recsize;		/* sizeof(struct evtrace_rec) */
+	uint32_t eh_nrecs;		/* records that follow */
+};
+
+#if OPT_EVTRACE
+
+struct cpu;
+
+/* True while recording. */
+extern volatile bool evtrace_enabled;
+
+/* Note that cpu C exists; called from cpu_create. */
+void evtrace_cpuinit(struct cpu *c);
+
+/* Allocate the rings and start recording. */
+void evtrace_bootstrap(void);
+
+/* Record an event on this cpu. */
+void evtrace_record(unsigned type, uint32_t arg0, uint32_t arg1);
+
+/* Empty the rings and start recording again. */
+void evtrace_start(void);
+
+/* Stop recording. */
+void evtrace_stop(void);
+
+/* Print the events, or write them to PATH if it is not NULL. */
+int evtrace_dump(char *path);
+
+#define EVTRACE(type, arg0, arg1) \
+	do { \
+		if (evtrace_enabled) { \
+			evtrace_record(type, (uint32_t)(arg0), \
+				       (uint32_t)(arg1)); \
+		} \
+	} while (0)
+
+#else
+
+#define EVTRACE(type, arg0, arg1)
+
+#endif /* OPT_EVTRACE */
+
+#endif /* _EVTRACE_H_ */
@@ -0,0 +1,37 @@
+#ifndef _EXECARGS_H_
+#define _EXECARGS_H_
+
+/*
+ * Argument vectors for execv and runprogram.
+ *
+ * The arguments are gathered into one ARG_MAX buffer already laid out
+ * the way they will sit on the new user stack: the argv pointer array
+ * (argc+1 entries) followed by the packed strings. Until the stack
+ * address is known the pointer slots hold string offsets. Getting the
+ * arguments onto the stack is then a single copyout.
+ *
+ * Buffers come from a small pool, since allocating ARG_MAX of
+ * contiguous kernel memory on every exec is not cheap.
+ *
+ *    execargs_init     - set up an empty execargs.
+ *    execargs_copyin   - gather a user argv; E2BIG if over ARG_MAX.
+ *    execargs_kernel   - gather a kernel argv (for the menu).
+ *    execargs_copyout  - put the arguments on the user stack below
+ *                        *STACKPTR, update it, and hand back argv.
+ *    execargs_cleanup  - give the buffer back. Safe to call twice.
+ */
+
+struct execargs {
+	char *ea_buf;		/* ARG_MAX bytes, from the pool */
+	size_t ea_len;		/* bytes used */
+	unsigned ea_argc;
+};
+
+void execargs_init(struct execargs *ea);
+int execargs_copyin(struct execargs *ea, const_userptr_t uargv);
+int execargs_kernel(struct execargs *ea, char **args, unsigned nargs);
+int execargs_copyout(struct execargs *ea, vaddr_t *stackptr,
+		     userptr_t *uargv);
+void execargs_cleanup(struct execargs *ea);
+
+#endif /* _EXECARGS_H_ */
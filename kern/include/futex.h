@@ -0,0 +1,13 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+/*
+ * Futexes: kernel-side sleep queues for user-space synchronization,
+ * keyed by the physical address of a word of user memory. The system
+ * calls are sys_futex_wait and sys_futex_wake (see syscall.h).
+ */
+
+/* Call once during system startup to allocate the hash table. */
+void futex_bootstrap(void);
+
+#endif /* _FUTEX_H_ */
@@ -0,0 +1,20 @@
+#ifndef _KERN_BENCH_H_
+#define _KERN_BENCH_H_
+
+/*
+ * Benchmark region markers, for the __bench system call (user level)
+ * and bench_begin/bench_end (in the kernel).
+ *
+ * Each marker reaches System/161's trace device as the debug code
+ * BENCH_CODE(op, id), so in the simulator's output region 5 starts at
+ * code 0xbe000005 and ends at 0xbe010005.
+ */
+
+#define BENCH_BEGIN	0
+#define BENCH_END	1
+
+#define BENCH_MAXID	0xffff
+
+#define BENCH_CODE(op, id)	(0xbe000000 | ((op) << 16) | (id))
+
+#endif /* _KERN_BENCH_H_ */
@@ -0,0 +1,26 @@
+#ifndef _KERN_MMAN_H_
+#define _KERN_MMAN_H_
+
+/*
+ * Flags for mmap(), munmap(), msync() and shm_attach(), shared between
+ * the kernel and <sys/mman.h>.
+ */
+
+/* Page protections (mmap PROT). */
+#define PROT_NONE       0
+#define PROT_READ       1
+#define PROT_WRITE      2
+#define PROT_EXEC       4
+
+/* Mapping kind (mmap FLAGS); exactly one of MAP_SHARED and MAP_PRIVATE. */
+#define MAP_SHARED      0x01	/* stores reach the file and other mappers */
+#define MAP_PRIVATE     0x02	/* stores stay in this process */
+#define MAP_FIXED       0x10	/* use ADDR exactly */
+#define MAP_ANON        0x20	/* zeroed memory, not a file; FD ignored */
+
+/* msync FLAGS. Writeback is always synchronous. */
+#define MS_ASYNC        1
+#define MS_SYNC         2
+#define MS_INVALIDATE   4
+
+#endif /* _KERN_MMAN_H_ */
@@ -0,0 +1,40 @@
+#ifndef _KERN_PROCSTAT_H_
+#define _KERN_PROCSTAT_H_
+
+/*
+ * System-wide snapshot returned by procstat() (OS/161 extension).
+ *
+ * procstat(ss, ps, nps) fills in *SS and up to NPS entries of PS, one
+ * per process, and returns how many entries it filled. ss_nprocs says
+ * how many processes there were, which may be more.
+ *
+ * Times are in hardclock ticks, ss_hz of them a second on each cpu.
+ * The kernel's own threads (including the menu) are process 0. A
+ * process that has exited but not yet been let go of by its parent
+ * has no threads left.
+ */
+
+#define PROCSTAT_NAMELEN	32
+
+struct sysstat {
+	__u32 ss_ncpus;			/* cpus running */
+	__u32 ss_hz;			/* ticks per second per cpu */
+	__u64 ss_ticks;			/* ticks so far, all cpus */
+	__u64 ss_idleticks;		/* of those, ones that found a cpu idle */
+	__u32 ss_nprocs;		/* processes */
+};
+
+struct procstat {
+	__pid_t ps_pid;
+	__u32 ps_nthreads;		/* threads; 0 once exited */
+	__u32 ps_uticks;		/* ticks in user mode */
+	__u32 ps_sticks;		/* ticks in the kernel */
+	__u32 ps_nvcsw;			/* switches from going to sleep */
+	__u32 ps_nivcsw;		/* switches while still runnable */
+	__u32 ps_faults;		/* VM faults */
+	__u64 ps_rbytes;		/* bytes read */
+	__u64 ps_wbytes;		/* bytes written */
+	char ps_name[PROCSTAT_NAMELEN];
+};
+
+#endif /* _KERN_PROCSTAT_H_ */
@@ -86,7 +86,7 @@
 //#define SYS_sigaltstack 33
 //                              (resource tracking and usage)
 //#define SYS_wait4      34
-//#define SYS_getrusage  35
+#define SYS_getrusage    35
 //                              (resource limits)
 //#define SYS_getrlimit  36
 //#define SYS_setrlimit  37
@@ -196,6 +196,15 @@
 #define SYS_sync         118
 #define SYS_reboot       119
 //#define SYS___sysctl   120
+//                              (OS/161 extensions)
+#define SYS_futex_wait   121
+#define SYS_futex_wake   122
+#define SYS_spawn        123
+#define SYS_msync        124
+#define SYS_shm_attach   125
+#define SYS_shm_remove   126
+#define SYS___bench      127
+#define SYS_procstat     128
 
 /*CALLEND*/
 
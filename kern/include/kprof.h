@@ -0,0 +1,47 @@
+#ifndef _KPROF_H_
+#define _KPROF_H_
+
+/*
+ * Sampling kernel profiler (kprof).
+ *
+ * Only available if OPT_KPROF is set. While running, every hardclock
+ * tick records the PC the clock interrupt came in at, and whether it
+ * was in user mode, into a ring on the cpu that took it. The rings
+ * belong to their cpus and are only written with interrupts off, so
+ * taking a sample needs no locks; once a ring is full the oldest
+ * samples are overwritten.
+ *
+ * Sampling is off at boot; kprof_start() clears the rings and turns
+ * it on, kprof_stop() turns it off again. kprof_print() sorts the
+ * samples and prints one line per distinct PC:
+ *
+ *    kprof pc 0x8001a2c4 k 57
+ *
+ * (k for kernel mode, u for user) for mk/kprof.sh to match up with
+ * the kernel's symbol table.
+ */
+
+struct cpu;
+
+/* Samples kept per cpu. */
+#define KPROF_NSAMPLES 4096
+
+/* True while sampling. */
+extern volatile bool kprof_enabled;
+
+/* Note that cpu C exists; called from cpu_create. */
+void kprof_cpuinit(struct cpu *c);
+
+/* Take a sample on this cpu. Called from the clock interrupt. */
+void kprof_sample(vaddr_t pc, bool user);
+
+/* Clear the samples and start sampling. */
+int kprof_start(void);
+
+/* Stop sampling. */
+void kprof_stop(void);
+
+/* Print the profile. */
+void kprof_print(void);
+
+#endif /* _KPROF_H_ */
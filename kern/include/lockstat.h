@@ -0,0 +1,82 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock profiling (lockstat).
+ *
+ * Only available if OPT_LOCKSTAT is set. Statistics are kept per lock
+ * *name* for sleep locks, CVs and semaphores (all locks called
+ * "p_wait_lock" share one entry). Spinlocks given a name with
+ * spinlock_setname() are kept per name too; those inside semaphores,
+ * locks, CVs and wait channels are named after them. Other spinlocks
+ * are kept per call site of spinlock_acquire().
+ *
+ * Collection is off at boot; lockstat_reset() clears the counters and
+ * turns it on, lockstat_stop() turns it off again. Times are in
+ * nanoseconds, taken from the realtime clock.
+ *
+ * What the counters mean depends on the kind of entry:
+ *
+ *    kind    acquires       contended        wait             hold
+ *    lock    lock_acquire   had to sleep     time asleep      time held
+ *    sem     P              had to sleep     time asleep      -
+ *    cv      cv_wait        (every wait)     time asleep      -
+ *    spin    acquire        had to spin      time spinning    time held
+ */
+
+#define LOCKSTAT_LOCK   0
+#define LOCKSTAT_SEM    1
+#define LOCKSTAT_CV     2
+#define LOCKSTAT_SPIN   3
+
+#define LOCKSTAT_NAMELEN 24
+
+/* The counters are per-cpu, in lockstat.c. */
+struct lockstat_entry {
+	char ls_name[LOCKSTAT_NAMELEN];	/* lock name (copied) */
+	vaddr_t ls_pc;			/* call site, for spinlocks */
+	unsigned ls_kind;		/* LOCKSTAT_* */
+	volatile bool ls_inuse;		/* slot allocated */
+};
+
+/* True while statistics are being collected. */
+extern volatile bool lockstat_enabled;
+
+/*
+ * Find (or make) the entry for a named lock, CV or semaphore. Called
+ * at create time so the hot paths never search. Never returns NULL;
+ * if the table is full, a shared overflow entry is returned.
+ */
+struct lockstat_entry *lockstat_lookup(const char *name, unsigned kind);
+
+/* Same, for the spinlock call site PC. */
+struct lockstat_entry *lockstat_spinsite(vaddr_t pc);
+
+/* Current timestamp, or 0 if collection is off. */
+uint64_t lockstat_now(void);
+
+/*
+ * Record an acquisition. WAITSTART is the lockstat_now() value from
+ * when the caller first found the lock busy (only used if CONTENDED).
+ * If STAMP is not NULL the acquisition time is stored there for the
+ * matching lockstat_released().
+ */
+void lockstat_acquired(struct lockstat_entry *ent, bool contended,
+		       uint64_t waitstart, uint64_t *stamp);
+
+/* Record a release of something acquired at time STAMP. */
+void lockstat_released(struct lockstat_entry *ent, uint64_t stamp);
+
+/*
+ * Clear all counters and start collecting. The first call allocates
+ * the counters, and can fail.
+ */
+int lockstat_reset(void);
+
+/* Stop collecting. */
+void lockstat_stop(void);
+
+/* Print the table, busiest (by total wait) first. */
+void lockstat_print(void);
+
+#endif /* _LOCKSTAT_H_ */
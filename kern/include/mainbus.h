@@ -52,6 +52,13 @@ void mainbus_interrupt(struct trapframe *);
 /* XXX this interface is not adequately MI */
 size_t mainbus_ramsize(void);
 
+/*
+ * Make this cpu's next timer interrupt (hardclock) come TICKS
+ * hardclock periods from now instead of one. The one after that comes
+ * a period later as usual. See hardclock_idle.
+ */
+void mainbus_timer_defer(unsigned ticks);
+
 /* Switch on an inter-processor interrupt. (Low-level.) */
 void mainbus_send_ipi(struct cpu *target);
 
@@ -0,0 +1,72 @@
+#ifndef _OPENFILE_H_
+#define _OPENFILE_H_
+
+/*
+ * Open files and per-process file tables.
+ *
+ * An openfile is what a file descriptor refers to: either a vnode with
+ * a seek position or one end of a pipe. Openfiles are shared, not
+ * copied, by fork, spawn and dup2, so they are reference counted; the
+ * vnode is closed (or the pipe end dropped) with the last reference.
+ *
+ * The seek position is only meaningful, and of_lock only taken, for
+ * seekable objects. Devices like the console are not, and a reader
+ * blocked on one must not hold up writers sharing the openfile.
+ *
+ * A file table maps descriptors to openfiles. Processes have a single
+ * thread, so the table itself is not locked.
+ *
+ *    openfile_open     - vfs_open PATH and wrap it. May destroy PATH.
+ *    openfile_pipe     - wrap one end of a pipe.
+ *    openfile_incref   - take another reference.
+ *    openfile_decref   - drop one; the last closes the object.
+ *
+ *    filetable_create  - a table with the console on stdin, stdout
+ *                        and stderr.
+ *    filetable_copy    - a table sharing every openfile with FT.
+ *    filetable_destroy - drop all references and free the table.
+ *    filetable_get     - look up FD; EBADF if not open.
+ *    filetable_place   - put OF in the lowest free slot; EMFILE if
+ *                        none. Takes over the caller's reference.
+ *    filetable_set     - put OF at FD, closing what was there.
+ *                        Takes over the caller's reference.
+ *    filetable_close   - close FD; EBADF if not open.
+ */
+
+#include <limits.h>
+#include <spinlock.h>
+
+struct vnode;
+struct pipe;
+struct lock;
+
+struct openfile {
+	struct vnode *of_vnode;		/* file, or NULL for a pipe end */
+	struct pipe *of_pipe;		/* pipe, or NULL for a file */
+	int of_accmode;			/* O_RDONLY, O_WRONLY or O_RDWR */
+	bool of_append;			/* O_APPEND */
+	bool of_seekable;		/* of_offset means something */
+	struct lock *of_lock;		/* protects of_offset */
+	off_t of_offset;		/* seek position */
+	struct spinlock of_reflock;	/* protects of_refcount */
+	unsigned of_refcount;
+};
+
+struct filetable {
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+int openfile_open(char *path, int flags, mode_t mode, struct openfile **ret);
+struct openfile *openfile_pipe(struct pipe *p, int accmode);
+void openfile_incref(struct openfile *of);
+void openfile_decref(struct openfile *of);
+
+struct filetable *filetable_create(void);
+struct filetable *filetable_copy(struct filetable *ft);
+void filetable_destroy(struct filetable *ft);
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_place(struct filetable *ft, struct openfile *of, int *fd);
+int filetable_set(struct filetable *ft, int fd, struct openfile *of);
+int filetable_close(struct filetable *ft, int fd);
+
+#endif /* _OPENFILE_H_ */
@@ -0,0 +1,58 @@
+#ifndef _PCOUNTER_H_
+#define _PCOUNTER_H_
+
+/*
+ * Per-cpu statistics counters (pcounter).
+ *
+ * A pcounter is a fixed set of 64-bit counters, indexed from 0, with
+ * a separate copy on each cpu. Each cpu's copies start on their own
+ * cache line, so bumping a counter never takes a lock and never
+ * touches a line another cpu is writing. The copies are only summed
+ * when somebody reads the counter.
+ *
+ * Define a set with PCOUNTER_DEFINE(name, n) at file scope; it is
+ * static and needs no initialization. Then:
+ *
+ *    pcounter_inc(&name, i)        count one event
+ *    pcounter_add(&name, i, n)     count N
+ *    pcounter_max(&name, i, v)     keep the largest V seen
+ *    pcounter_read(&name, i)       sum over all cpus
+ *    pcounter_readmax(&name, i)    largest over all cpus
+ *    pcounter_reset(&name)         zero everything
+ *
+ * Updates are safe from any context, interrupt handlers included.
+ * Reads and resets take no locks either, so a read that races with
+ * updates (or a reset) may be a little off; this is for statistics,
+ * not for anything that has to be exact.
+ */
+
+#include <platform/maxcpus.h>
+
+/* Bytes per cache line we keep cpus' copies apart by. */
+#define PCOUNTER_CACHELINE	64
+
+/* 64-bit slots per cpu for N counters, rounded up to whole lines. */
+#define PCOUNTER_STRIDE(n) \
+	((((n) * sizeof(uint64_t) + PCOUNTER_CACHELINE - 1) / \
+	  PCOUNTER_CACHELINE) * (PCOUNTER_CACHELINE / sizeof(uint64_t)))
+
+struct pcounter {
+	unsigned pc_num;	/* counters in the set */
+	unsigned pc_stride;	/* slots per cpu */
+	uint64_t *pc_slots;	/* MAXCPUS * pc_stride slots */
+};
+
+#define PCOUNTER_DEFINE(name, n) \
+	static uint64_t name##_slots[MAXCPUS * PCOUNTER_STRIDE(n)] \
+		__attribute__((__aligned__(PCOUNTER_CACHELINE))); \
+	static struct pcounter name = { (n), PCOUNTER_STRIDE(n), name##_slots }
+
+void pcounter_add(struct pcounter *pc, unsigned index, uint64_t n);
+void pcounter_max(struct pcounter *pc, unsigned index, uint64_t v);
+uint64_t pcounter_read(struct pcounter *pc, unsigned index);
+uint64_t pcounter_readmax(struct pcounter *pc, unsigned index);
+void pcounter_reset(struct pcounter *pc);
+
+#define pcounter_inc(pc, index) pcounter_add(pc, index, 1)
+
+#endif /* _PCOUNTER_H_ */
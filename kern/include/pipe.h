@@ -0,0 +1,38 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Pipes.
+ *
+ * A pipe is a PIPE_SIZE ring buffer with a reader end and a writer
+ * end. Reads block until there is data or no writer is left (then
+ * they return 0, end of file); writes block until everything has been
+ * taken, and fail with EPIPE once no reader is left. A write is never
+ * interleaved with another writer's data.
+ *
+ * Writes of at least PIPE_LOANMIN bytes from user space don't go
+ * through the ring. Once the ring has drained, the writer lends its
+ * buffer to the pipe and sleeps; readers copy straight out of the
+ * writer's pages, found with as_translate and read through kseg0, so
+ * the data is copied once instead of twice. The writer being asleep
+ * in write() is what keeps those pages where they are.
+ *
+ *    pipe_create - make a pipe with one reference on each end.
+ *    pipe_close  - drop the end given by ACCMODE (O_RDONLY is the
+ *                  reader); the pipe goes away with the last end.
+ *    pipe_read   - read into UIO.
+ *    pipe_write  - write from UIO.
+ */
+
+#define PIPE_SIZE     4096
+#define PIPE_LOANMIN  PAGE_SIZE
+
+struct pipe;
+struct uio;
+
+int pipe_create(struct pipe **ret);
+void pipe_close(struct pipe *p, int accmode);
+int pipe_read(struct pipe *p, struct uio *uio);
+int pipe_write(struct pipe *p, struct uio *uio);
+
+#endif /* _PIPE_H_ */
@@ -44,7 +44,9 @@
 #include <thread.h> /* required for struct threadarray */
 
 struct addrspace;
+struct procstat;
 struct vnode;
+struct filetable;
 #ifdef UW
 struct semaphore;
 #endif // UW
@@ -56,6 +58,8 @@ struct proc {
 	char *p_name;			/* Name of this process */
 	struct spinlock p_lock;		/* Lock for this structure */
 	struct threadarray p_threads;	/* Threads in this process */
+	struct threadusage p_usage;	/* Usage of threads that have left */
+	struct threadusage p_cusage;	/* Usage of children waited for */
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
 
@@ -79,6 +83,8 @@ struct proc {
 	struct array p_children; //all child process
 	bool canexit;            //do it exit
 	int exitcode;            //exit code
+	bool p_waited;           //usage already given to the parent
+	struct filetable *p_files; //open file descriptors
 	#else
 	#endif//OPT_A2
 };
@@ -116,10 +122,15 @@ struct addrspace *curproc_getas(void);
 
 /* Change the address space of the current process, and return the old one. */
 struct addrspace *curproc_setas(struct addrspace *);
+
+/* Get the usage of all PROC's threads, past and present. */
+void proc_getusage(struct proc *proc, struct threadusage *tu);
 #if OPT_A2
 /*return a valid pid or -1 if no valid pid*/
 pid_t find_pid(void);
 unsigned get_index_proc(pid_t pid);
+/* Describe up to MAX processes into PS; returns how many there are. */
+unsigned proc_snapshot(struct procstat *ps, unsigned max);
 #endif //OPT_A2
 
 #endif /* _PROC_H_ */
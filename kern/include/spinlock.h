@@ -36,6 +36,9 @@
  */
 
 #include <cdefs.h>
+#include "opt-lockstat.h"
+
+struct lockstat_entry;
 
 /* Inlining support - for making sure an out-of-line copy gets built */
 #ifndef SPINLOCK_INLINE
@@ -57,12 +60,21 @@
 struct spinlock {
 	volatile spinlock_data_t lk_lock; /* The memory word where we spin. */
 	struct cpu *lk_holder;		/* CPU holding this lock. */
+#if OPT_LOCKSTAT
+	struct lockstat_entry *lk_stat;	/* Name, or call site of last acquire. */
+	bool lk_named;			/* lk_stat is by name */
+	uint64_t lk_stamp;		/* When it was acquired. */
+#endif
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
  */
+#if OPT_LOCKSTAT
+#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL, NULL, false, 0 }
+#else
 #define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#endif
 
 /*
  * Spinlock functions.
@@ -74,9 +86,15 @@ struct spinlock {
  * release	Release the lock. May re-enable interrupts.
  *
  * do_i_hold	Check if the current CPU holds the lock.
+ *
+ * setname	Have lockstat count the lock under NAME rather than by
+ *		call site; for spinlocks inside other named objects,
+ *		which are all acquired from the same few places. Does
+ *		nothing without OPT_LOCKSTAT.
  */
 
 void spinlock_init(struct spinlock *lk);
+void spinlock_setname(struct spinlock *lk, const char *name);
 void spinlock_cleanup(struct spinlock *lk);
 
 void spinlock_acquire(struct spinlock *lk);
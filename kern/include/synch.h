@@ -36,6 +36,9 @@
 
 
 #include <spinlock.h>
+#include "opt-lockstat.h"
+
+struct lockstat_entry;
 
 /*
  * Dijkstra-style semaphore.
@@ -48,6 +51,9 @@ struct semaphore {
 	struct wchan *sem_wchan;
 	struct spinlock sem_lock;
         volatile int sem_count;
+#if OPT_LOCKSTAT
+        struct lockstat_entry *sem_stat;
+#endif
 };
 
 struct semaphore *sem_create(const char *name, int initial_count);
@@ -79,6 +85,10 @@ struct lock {
         struct spinlock lk_splk;   // enforced atomic lock functions
         struct thread *lk_thread; // Thread that holding this lock
         volatile bool lk_state;     //state now
+#if OPT_LOCKSTAT
+        struct lockstat_entry *lk_stat;
+        uint64_t lk_stamp;          // when lk_thread got it
+#endif
         // (don't forget to mark things volatile as needed)
 };
 
@@ -119,6 +129,9 @@ struct cv {
         char *cv_name;
         // add what you need here
         struct wchan *cv_wchan;
+#if OPT_LOCKSTAT
+        struct lockstat_entry *cv_stat;
+#endif
         // (don't forget to mark things volatile as needed)
 };
 
@@ -30,6 +30,7 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 #include "opt-A2.h"
+#include "opt-A3.h"
 
 struct trapframe; /* from <machine/trapframe.h> */
 
@@ -60,6 +61,8 @@ void enter_new_process(int argc, userptr_t argv, vaddr_t stackptr,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys___bench(int op, unsigned id);
+int sys_nanosleep(userptr_t ureq, userptr_t urem);
 
 #ifdef UW
 int sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval);
@@ -68,6 +71,28 @@ int sys_getpid(pid_t *retval);
 int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retval);
 int sys_fork(pid_t *retval,struct trapframe *tf);
 int sys_execv(char* program, char** args,int32_t *retval);
+int sys_spawn(userptr_t program, userptr_t args, pid_t *retval);
+#if OPT_A2
+int sys_open(userptr_t upath, int flags, mode_t mode, int *retval);
+int sys_read(int fdesc, userptr_t ubuf, unsigned int nbytes, int *retval);
+int sys_close(int fdesc);
+int sys_dup2(int oldfd, int newfd, int *retval);
+int sys_fstat(int fdesc, userptr_t ustat);
+int sys_pipe(userptr_t ufds, int *retval);
+int sys_getrusage(int who, userptr_t uru);
+int sys_procstat(userptr_t uss, userptr_t ups, unsigned nps, int32_t *retval);
+#endif // OPT_A2
+int sys_futex_wait(userptr_t uaddr, int expected);
+int sys_futex_wake(userptr_t uaddr, int nwake, int32_t *retval);
+#if OPT_A3
+int sys_mmap(userptr_t uaddr, size_t len, int prot, int flags, int fd,
+             off_t offset, int32_t *retval);
+int sys_munmap(userptr_t uaddr, size_t len);
+int sys_msync(userptr_t uaddr, size_t len, int flags);
+int sys_shm_attach(int key, size_t len, int prot, int32_t *retval);
+int sys_shm_remove(int key);
+int sys_sbrk(int change, int32_t *retval);
+#endif // OPT_A3
 #endif // UW
 
 #endif /* _SYSCALL_H_ */
@@ -81,9 +81,17 @@ int malloctest(int, char **);
 int mallocstress(int, char **);
 int nettest(int, char **);
 
-/* Routine for running a user-level program. */
-//int runprogram(char *progname);
-int runprogram(char *progname,char **args,unsigned long argc);
+/* microbenchmarks */
+int bench(int, char **);
+int benchtest(int, char **);
+
+/* Routines for running a user-level program. */
+struct execargs;
+struct vnode;
+struct addrspace;
+int runprogram(char *progname, struct execargs *ea);
+int loadprogram(struct vnode *v, struct addrspace *as, struct execargs *ea,
+		vaddr_t *entrypoint, vaddr_t *stackptr, userptr_t *argv);
 
 /* Kernel menu system. */
 void menu(char *argstr);
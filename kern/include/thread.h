@@ -41,6 +41,7 @@
 #include <threadlist.h>
 
 struct cpu;
+struct wchan;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -56,6 +57,22 @@ struct cpu;
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
 
+/*
+ * Resource usage charged to a thread, for getrusage and procstat.
+ * Only updated by the thread itself, or by a clock interrupt on its
+ * cpu while it runs, so no lock; other threads may read it a little
+ * stale.
+ */
+struct threadusage {
+	uint32_t tu_uticks;		/* hardclocks that found it in user mode */
+	uint32_t tu_sticks;		/* hardclocks that found it in the kernel */
+	uint32_t tu_nvcsw;		/* switches because it went to sleep */
+	uint32_t tu_nivcsw;		/* switches while it was still runnable */
+	uint32_t tu_faults;		/* VM faults */
+	uint64_t tu_rbytes;		/* bytes transferred by read() */
+	uint64_t tu_wbytes;		/* bytes transferred by write() */
+};
+
 /* States a thread can be in. */
 typedef enum {
 	S_RUN,		/* running */
@@ -82,6 +99,7 @@ struct thread {
 	void *t_stack;			/* Kernel-level stack */
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
+	bool t_bound;			/* Never migrated off t_cpu */
 	struct proc *t_proc;		/* Process thread belongs to */
 
 	/*
@@ -104,6 +122,8 @@ struct thread {
 	/*
 	 * Public fields
 	 */
+	struct threadusage t_usage;	/* Resources used so far */
+	struct wchan *t_sleepwc;	/* For clock_nsleep; made on first use */
 
 	/* add more here as needed */
 };
@@ -144,6 +164,20 @@ int thread_fork(const char *name, struct proc *proc,
                 void (*func)(void *, unsigned long),
                 void *data1, unsigned long data2);
 
+/*
+ * Like thread_fork, but the new thread runs on cpu C and stays there.
+ * For per-cpu service threads.
+ */
+int thread_fork_bound(const char *name, struct proc *proc, struct cpu *c,
+                      void (*func)(void *, unsigned long),
+                      void *data1, unsigned long data2);
+
+/*
+ * Free the kernel stacks and thread structures that exited threads
+ * left cached for new ones. Called when memory runs short.
+ */
+void thread_trimcaches(void);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
@@ -168,5 +202,24 @@ void schedule(void);
  */
 void thread_consider_migration(void);
 
+/*
+ * Charge a hardclock tick to whatever this cpu was doing: the idle
+ * count if idle, otherwise curthread, in user mode if USER. Called
+ * from the timer interrupt.
+ */
+void thread_chargetick(bool user);
+
+/* How many cpus there are; they are numbered from 0. */
+unsigned thread_numcpus(void);
+
+/* Hardclocks so far, and how many of them found a cpu idle. */
+void thread_cputicks(unsigned *ncpus, uint64_t *ticks, uint64_t *idleticks);
+
+/* Print each cpu's hardclock, idle and skipped tick counts. */
+void thread_printcputicks(void);
+
+/* Add the usage in FROM to TO. */
+void threadusage_add(struct threadusage *to, const struct threadusage *from);
+
 
 #endif /* _THREAD_H_ */
@@ -59,5 +59,16 @@ void free_kpages(vaddr_t addr);
 void vm_tlbshootdown_all(void);
 void vm_tlbshootdown(const struct tlbshootdown *);
 
+/*
+ * A file has been written or truncated; forget any cached copy of it
+ * that later execs would otherwise share.
+ */
+struct vnode;
+void vm_textinval(struct vnode *vn);
+
+/* Print/clear VM statistics (TLB refill latency) for the menu */
+void vm_printstats(void);
+void vm_resetstats(void);
+
 
 #endif /* _VM_H_ */
@@ -0,0 +1,83 @@
+#ifndef _VMOBJ_H_
+#define _VMOBJ_H_
+
+/*
+ * VM objects: the pages behind an mmap'd region.
+ *
+ * An object is an array of page frames, each allocated when its page
+ * is first touched. It is either anonymous (pages start zeroed) or
+ * backed by a vnode, in which case pages are read in from the file at
+ * VO_OFFSET + index * PAGE_SIZE. Objects are reference counted, one
+ * reference per region mapping them, so regions in several address
+ * spaces can share one.
+ *
+ * Every MAP_SHARED mapping of a file uses the one writeback object
+ * for that vnode (vmobj_shared), which covers the file from offset 0.
+ * Pages written through a mapping are marked dirty, and vmobj_sync
+ * writes dirty pages back with VOP_WRITE. Nothing past end of file is
+ * written, so mappings never extend a file. Dirty marks are never
+ * cleared, because other address spaces may still hold writable TLB
+ * entries for the page; a page written once is written back on every
+ * sync.
+ *
+ * Named anonymous objects (shm_attach) live in a table by key, which
+ * holds a reference of its own, so a segment outlives its mappings
+ * until vmobj_unname drops it.
+ *
+ * The object's pages are not the file's buffer cache, so read() and
+ * write() on a file don't see changes made through a mapping until it
+ * is synced, and a mapping doesn't see write()s to pages it already
+ * holds.
+ *
+ *    vmobj_bootstrap - set up the shared-file table.
+ *    vmobj_create    - make a private object of NPAGES pages backed by
+ *                      VN at OFFSET, or anonymous if VN is NULL.
+ *    vmobj_shared    - find or make the writeback object for VN, with
+ *                      at least NPAGES pages.
+ *    vmobj_named     - find or make the anonymous object called KEY,
+ *                      with at least NPAGES pages.
+ *    vmobj_unname    - drop KEY from the table; ENOENT if not there.
+ *    vmobj_resize    - make OBJ NPAGES long, freeing the frames of any
+ *                      pages cut off. Not for shared objects.
+ *    vmobj_copy      - make a private copy of OBJ (for fork).
+ *    vmobj_incref    - take another reference.
+ *    vmobj_decref    - drop one; the last frees the frames. Does not
+ *                      write anything back; sync first.
+ *    vmobj_getpage   - make page INDEX resident and return its frame,
+ *                      marking it dirty if WRITE; *DIRTY says whether
+ *                      it is dirty now.
+ *    vmobj_sync      - write back the dirty pages among NPAGES from
+ *                      FIRST, if OBJ is a writeback object.
+ */
+
+struct vnode;
+struct lock;
+
+struct vmobj {
+	struct lock *vo_lock;		/* protects the pages */
+	struct vnode *vo_vn;		/* backing file, or NULL */
+	off_t vo_offset;		/* file offset of page 0 */
+	bool vo_writeback;		/* dirty pages go back to vo_vn */
+	unsigned vo_npages;
+	paddr_t *vo_pages;		/* frame | VOPAGE_DIRTY, or 0 */
+	unsigned vo_refs;		/* protected by the table lock */
+	int vo_key;			/* name, if in the named table */
+};
+
+/* Low bit of a vo_pages entry; frames are page-aligned. */
+#define VOPAGE_DIRTY  0x1
+
+void vmobj_bootstrap(void);
+struct vmobj *vmobj_create(struct vnode *vn, off_t offset, unsigned npages);
+int vmobj_shared(struct vnode *vn, unsigned npages, struct vmobj **ret);
+int vmobj_named(int key, unsigned npages, struct vmobj **ret);
+int vmobj_unname(int key);
+int vmobj_resize(struct vmobj *obj, unsigned npages);
+struct vmobj *vmobj_copy(struct vmobj *obj);
+void vmobj_incref(struct vmobj *obj);
+void vmobj_decref(struct vmobj *obj);
+int vmobj_getpage(struct vmobj *obj, unsigned index, bool write,
+		  paddr_t *ret, bool *dirty);
+int vmobj_sync(struct vmobj *obj, unsigned first, unsigned npages);
+
+#endif /* _VMOBJ_H_ */
@@ -0,0 +1,59 @@
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Work queues: get a function called soon, by a kernel thread, instead
+ * of right here.
+ *
+ * Each cpu has a worker thread that stays on that cpu and runs the
+ * work queued on it, in order. Use this for cleanup that doesn't need
+ * to be finished before the caller goes on, so that whoever it is
+ * doesn't have to wait for it: the work runs in an ordinary thread,
+ * on no locks, and may sleep.
+ *
+ * workqueue_queue() can be called from anywhere, including interrupt
+ * handlers and with spinlocks held (except the cpu's run queue lock),
+ * and can't fail; the struct work belongs to the caller, must stay put
+ * until its function has been called, and may be queued again as soon
+ * as that has started. workqueue_submit() is the same for one-off
+ * work, allocating the struct work itself, so it can fail.
+ *
+ * Work queued before workqueue_bootstrap() waits for it.
+ */
+
+struct cpu;
+
+struct work {
+	struct work *wk_next;		/* next on the queue */
+	void (*wk_func)(void *);
+	void *wk_arg;
+	bool wk_queued;			/* on a queue, not yet started */
+	bool wk_free;			/* kfree once started */
+};
+
+/* Set up WK to call FUNC(ARG) when it runs. */
+void work_init(struct work *wk, void (*func)(void *), void *arg);
+
+/*
+ * Queue WK on this cpu's worker. Returns false, doing nothing, if it's
+ * already queued and hasn't started.
+ */
+bool workqueue_queue(struct work *wk);
+
+/* Queue FUNC(ARG) on this cpu's worker. */
+int workqueue_submit(void (*func)(void *), void *arg);
+
+/*
+ * Wait until every queue is empty, including of work queued by the
+ * work that was there. Don't call it holding anything queued work
+ * might need, or from queued work.
+ */
+void workqueue_flush(void);
+
+/* Set up cpu C's queue; called from cpu_create. */
+void workqueue_cpuinit(struct cpu *c);
+
+/* Start the worker threads, once all the cpus are running. */
+void workqueue_bootstrap(void);
+
+#endif /* _WORKQUEUE_H_ */
@@ -50,8 +50,12 @@
 #include <vfs.h>
 #include <synch.h>
 #include <kern/fcntl.h>  
+#include <kern/procstat.h>
 #include <array.h>
 #include "opt-A2.h"
+#if OPT_A2
+#include <openfile.h>
+#endif
 #include <limits.h>
 /*
  * The process for the kernel; this holds all the kernel-only threads.
@@ -126,6 +130,8 @@ proc_create(const char *name)
 
 	threadarray_init(&proc->p_threads);
 	spinlock_init(&proc->p_lock);
+	bzero(&proc->p_usage, sizeof(proc->p_usage));
+	bzero(&proc->p_cusage, sizeof(proc->p_cusage));
 
 	/* VM fields */
 	proc->p_addrspace = NULL;
@@ -145,6 +151,8 @@ proc_create(const char *name)
 	}
 	proc->canexit = false;
 	proc->exitcode = 0;
+	proc->p_waited = false;
+	proc->p_files = NULL;
 	
 
 	proc->p_exit_lock = lock_create("p_exit_lock");
@@ -273,6 +281,10 @@ proc_destroy(struct proc *proc)
 	DEBUG(DB_SYSCALL,"children leave2:%d\n",array_num(&proc->p_children));
 	array_cleanup(&proc->p_children);
 	DEBUG(DB_SYSCALL,"children cleanup finish\n");
+	if (proc->p_files != NULL) {
+		filetable_destroy(proc->p_files);
+		proc->p_files = NULL;
+	}
 	lock_destroy(proc->p_exit_lock);
 	lock_destroy(proc->p_wait_lock);
 	cv_destroy(proc->p_cv);
@@ -399,6 +411,20 @@ proc_create_runprogram(const char *name)
 #endif // UW
 
 #if OPT_A2
+	/*
+	 * Children (fork, spawn) share the parent's open files; a
+	 * program started from the menu gets the console.
+	 */
+	if (curproc->p_files != NULL) {
+		proc->p_files = filetable_copy(curproc->p_files);
+	}
+	else {
+		proc->p_files = filetable_create();
+	}
+	if (proc->p_files == NULL) {
+		proc_destroy(proc);
+		return NULL;
+	}
 	//inital locks
 	
 	// initialize children proc array
@@ -457,6 +483,7 @@ proc_remthread(struct thread *t)
 		if (threadarray_get(&proc->p_threads, i) == t) {
 			//DEBUG(DB_SYSCALL,"remove thread array_num: %d",array_num(&proc->p_threads));
 			threadarray_remove(&proc->p_threads, i);
+			threadusage_add(&proc->p_usage, &t->t_usage);
 			spinlock_release(&proc->p_lock);
 			t->t_proc = NULL;
 			return;
@@ -506,3 +533,57 @@ curproc_setas(struct addrspace *newas)
 	spinlock_release(&proc->p_lock);
 	return oldas;
 }
+
+/*
+ * The threads' own counters keep moving while we add them up, so this
+ * is only a snapshot.
+ */
+void
+proc_getusage(struct proc *proc, struct threadusage *tu)
+{
+	struct thread *t;
+	unsigned i, num;
+
+	spinlock_acquire(&proc->p_lock);
+	*tu = proc->p_usage;
+	num = threadarray_num(&proc->p_threads);
+	for (i=0; i<num; i++) {
+		t = threadarray_get(&proc->p_threads, i);
+		threadusage_add(tu, &t->t_usage);
+	}
+	spinlock_release(&proc->p_lock);
+}
+
+#if OPT_A2
+/*
+ * Like find_pid and get_index_proc, this walks procs_list without a
+ * lock, so it must not sleep partway through.
+ */
+unsigned
+proc_snapshot(struct procstat *ps, unsigned max)
+{
+	struct threadusage tu;
+	struct proc *p;
+	unsigned i, num;
+
+	if (procs_list == NULL) {
+		return 0;
+	}
+	num = array_num(procs_list);
+	for (i=0; i<num && i<max; i++) {
+		p = array_get(procs_list, i);
+		proc_getusage(p, &tu);
+		ps[i].ps_pid = (p == kproc) ? 0 : p->p_pid;
+		ps[i].ps_nthreads = threadarray_num(&p->p_threads);
+		ps[i].ps_uticks = tu.tu_uticks;
+		ps[i].ps_sticks = tu.tu_sticks;
+		ps[i].ps_nvcsw = tu.tu_nvcsw;
+		ps[i].ps_nivcsw = tu.tu_nivcsw;
+		ps[i].ps_faults = tu.tu_faults;
+		ps[i].ps_rbytes = tu.tu_rbytes;
+		ps[i].ps_wbytes = tu.tu_wbytes;
+		snprintf(ps[i].ps_name, sizeof(ps[i].ps_name), "%s", p->p_name);
+	}
+	return num;
+}
+#endif //OPT_A2
@@ -48,7 +48,10 @@
 #include <device.h>
 #include <syscall.h>
 #include <test.h>
+#include <futex.h>
+#include <workqueue.h>
 #include <version.h>
+#include <evtrace.h>
 #include "autoconf.h"  // for pseudoconfig
 
 
@@ -124,7 +127,12 @@ boot(void)
 	/* Late phase of initialization. */
 	vm_bootstrap();
 	kprintf_bootstrap();
+	futex_bootstrap();
+#if OPT_EVTRACE
+	evtrace_bootstrap();
+#endif
 	thread_start_cpus();
+	workqueue_bootstrap();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
 	vfs_setbootfs("emu0");
@@ -39,12 +39,25 @@
 #include <proc.h>
 #include <synch.h>
 #include <vfs.h>
+#include <vm.h>
 #include <sfs.h>
 #include <syscall.h>
 #include <test.h>
+#include <execargs.h>
+#include <bench.h>
+#include <uw-vmstats.h>
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
 #include "opt-net.h"
+#include "opt-lockstat.h"
+#if OPT_LOCKSTAT
+#include <lockstat.h>
+#endif
+#include "opt-kprof.h"
+#if OPT_KPROF
+#include <kprof.h>
+#endif
+#include <evtrace.h>
 
 /*
  * In-kernel menu and command dispatcher.
@@ -89,20 +102,22 @@ cmd_progthread(void *ptr, unsigned long nargs)
 {
 	char **args = ptr;
 	char progname[128];
+	struct execargs ea;
 	int result;
 
 	KASSERT(nargs >= 1);
 
-	if (nargs > 2) {
-		kprintf("Warning: argument passing from menu not supported\n");
-	}
-
 	/* Hope we fit. */
 	KASSERT(strlen(args[0]) < sizeof(progname));
 
 	strcpy(progname, args[0]);
 
-	result = runprogram(progname,args,nargs);
+	execargs_init(&ea);
+	result = execargs_kernel(&ea, args, nargs);
+	if (result == 0) {
+		result = runprogram(progname, &ea);
+	}
+	execargs_cleanup(&ea);
 	if (result) {
 		kprintf("Running program %s failed: %s\n", args[0],
 			strerror(result));
@@ -396,6 +411,186 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_vmstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	vmstats_print();
+	vm_printstats();
+	return 0;
+}
+
+static
+int
+cmd_cpustats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	thread_printcputicks();
+	return 0;
+}
+
+static
+int
+cmd_vmstats_reset(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	vmstats_init();
+	vm_resetstats();
+	return 0;
+}
+
+#if OPT_LOCKSTAT
+/*
+ * Lock profiling: lsr clears the counters and starts collecting,
+ * lsoff stops, ls prints.
+ */
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	lockstat_print();
+	return 0;
+}
+
+static
+int
+cmd_lockstat_reset(int nargs, char **args)
+{
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	result = lockstat_reset();
+	if (result) {
+		return result;
+	}
+	kprintf("lockstat: counters cleared, collecting\n");
+	return 0;
+}
+
+static
+int
+cmd_lockstat_off(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	lockstat_stop();
+	return 0;
+}
+#endif
+
+#if OPT_KPROF
+/*
+ * Sampling profiler: kpr clears the samples and starts, kpoff stops,
+ * kp prints.
+ */
+static
+int
+cmd_kprof(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	kprof_print();
+	return 0;
+}
+
+static
+int
+cmd_kprof_start(int nargs, char **args)
+{
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	result = kprof_start();
+	if (result) {
+		return result;
+	}
+	kprintf("kprof: samples cleared, sampling\n");
+	return 0;
+}
+
+static
+int
+cmd_kprof_off(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	kprof_stop();
+	return 0;
+}
+#endif
+
+#if OPT_EVTRACE
+/*
+ * Event tracing: etr empties the rings and starts again, etoff stops,
+ * et prints (or, given a file name, saves the binary records there).
+ */
+static
+int
+cmd_evtrace(int nargs, char **args)
+{
+	if (nargs > 2) {
+		kprintf("Usage: et [file]\n");
+		return EINVAL;
+	}
+	return evtrace_dump(nargs == 2 ? args[1] : NULL);
+}
+
+static
+int
+cmd_evtrace_start(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	evtrace_start();
+	kprintf("evtrace: rings emptied, recording\n");
+	return 0;
+}
+
+static
+int
+cmd_evtrace_off(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	evtrace_stop();
+	return 0;
+}
+#endif
+
+/*
+ * Command for setting the trace161 flags turned on inside benchmark
+ * regions.
+ */
+static
+int
+cmd_benchtrace(int nargs, char **args)
+{
+	if (nargs > 2) {
+		kprintf("Usage: btf [flags]\n");
+		return EINVAL;
+	}
+	return bench_settrace(nargs == 2 ? args[1] : "");
+}
+
 //ASST0
 static
 int 
@@ -463,6 +658,7 @@ static const char *opsmenu[] = {
 	"[q]       Quit and shut down        ",
 	"[dth]     thread debugging message  ",
 	"[dsc]     syscall debugging message ",
+	"[btf]     Trace flags in bench marks",
 	NULL
 };
 
@@ -500,6 +696,8 @@ static const char *testmenu[] = {
 	"[fs3] FS write stress       (4)     ",
 	"[fs4] FS write stress 2     (4)     ",
 	"[fs5] FS create stress      (4)     ",
+	"[bench] Benchmarks [test] [reps]    ",
+	"[bench1] Bench failure test         ",
 	NULL
 };
 
@@ -531,6 +729,17 @@ static const char *mainmenu[] = {
 #endif /* UW */
 #endif
 	"[kh] Kernel heap stats              ",
+	"[vs] VM stats (vsr reset)           ",
+	"[cs] Cpu tick stats                 ",
+#if OPT_LOCKSTAT
+	"[ls] Lock stats (lsr reset, lsoff)  ",
+#endif
+#if OPT_KPROF
+	"[kp] Profile (kpr start, kpoff)     ",
+#endif
+#if OPT_EVTRACE
+	"[et] Event trace [file] (etr, etoff)",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -577,6 +786,7 @@ static struct {
 	{ "halt",	cmd_quit },
 	{ "dth",        cmd_dth},
 	{ "dsc",        cmd_dsc},
+	{ "btf",	cmd_benchtrace },
 #if OPT_SYNCHPROBS
 	/* in-kernel synchronization problem(s) */
 	{ "sp1",	whalemating },
@@ -588,6 +798,24 @@ static struct {
 
 	/* stats */
 	{ "kh",         cmd_kheapstats },
+	{ "vs",		cmd_vmstats },
+	{ "vsr",	cmd_vmstats_reset },
+	{ "cs",		cmd_cpustats },
+#if OPT_LOCKSTAT
+	{ "ls",		cmd_lockstat },
+	{ "lsr",	cmd_lockstat_reset },
+	{ "lsoff",	cmd_lockstat_off },
+#endif
+#if OPT_KPROF
+	{ "kp",		cmd_kprof },
+	{ "kpr",	cmd_kprof_start },
+	{ "kpoff",	cmd_kprof_off },
+#endif
+#if OPT_EVTRACE
+	{ "et",		cmd_evtrace },
+	{ "etr",	cmd_evtrace_start },
+	{ "etoff",	cmd_evtrace_off },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -617,6 +845,10 @@ static struct {
 	{ "fs4",	writestress2 },
 	{ "fs5",	createstress },
 
+	/* benchmarks */
+	{ "bench",	bench },
+	{ "bench1",	benchtest },
+
 	{ NULL, NULL }
 };
 
@@ -0,0 +1,216 @@
+/*
+ * Argument handling for execv and runprogram. See execargs.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <limits.h>
+#include <spinlock.h>
+#include <vm.h>
+#include <copyinout.h>
+#include <execargs.h>
+
+/* Free ARG_MAX buffers kept around for the next exec. */
+#define EXECARGS_POOLSIZE 2
+
+static struct spinlock execargs_pool_lock = SPINLOCK_INITIALIZER;
+static char *execargs_pool[EXECARGS_POOLSIZE];
+static unsigned execargs_npool;
+
+static
+char *
+execargs_getbuf(void)
+{
+	char *buf = NULL;
+
+	spinlock_acquire(&execargs_pool_lock);
+	if (execargs_npool > 0) {
+		buf = execargs_pool[--execargs_npool];
+	}
+	spinlock_release(&execargs_pool_lock);
+
+	if (buf == NULL) {
+		buf = kmalloc(ARG_MAX);
+	}
+	return buf;
+}
+
+static
+void
+execargs_putbuf(char *buf)
+{
+	spinlock_acquire(&execargs_pool_lock);
+	if (execargs_npool < EXECARGS_POOLSIZE) {
+		execargs_pool[execargs_npool++] = buf;
+		buf = NULL;
+	}
+	spinlock_release(&execargs_pool_lock);
+
+	if (buf != NULL) {
+		kfree(buf);
+	}
+}
+
+void
+execargs_init(struct execargs *ea)
+{
+	ea->ea_buf = NULL;
+	ea->ea_len = 0;
+	ea->ea_argc = 0;
+}
+
+void
+execargs_cleanup(struct execargs *ea)
+{
+	if (ea->ea_buf != NULL) {
+		execargs_putbuf(ea->ea_buf);
+		ea->ea_buf = NULL;
+	}
+}
+
+/*
+ * Copy in the user's argv array. It is read a page at a time so that
+ * the usual case, an array that doesn't cross a page boundary, is a
+ * single copyin, without reading past the page it ends in.
+ */
+static
+int
+execargs_copyinptrs(struct execargs *ea, const_userptr_t uargv)
+{
+	userptr_t *slots = (userptr_t *)ea->ea_buf;
+	vaddr_t addr = (vaddr_t)uargv;
+	size_t done, chunk;
+	unsigned i;
+	int result;
+
+	done = 0;
+	i = 0;
+	while (1) {
+		chunk = PAGE_SIZE - ((addr + done) % PAGE_SIZE);
+		if (chunk < sizeof(userptr_t)) {
+			chunk = sizeof(userptr_t);
+		}
+		chunk -= chunk % sizeof(userptr_t);
+		if (done + chunk > ARG_MAX) {
+			chunk = ARG_MAX - done;
+		}
+		if (chunk == 0) {
+			return E2BIG;
+		}
+
+		result = copyin((const_userptr_t)(addr + done),
+				ea->ea_buf + done, chunk);
+		if (result) {
+			return result;
+		}
+		done += chunk;
+
+		for (; i < done / sizeof(userptr_t); i++) {
+			if (slots[i] == NULL) {
+				ea->ea_argc = i;
+				return 0;
+			}
+		}
+	}
+}
+
+int
+execargs_copyin(struct execargs *ea, const_userptr_t uargv)
+{
+	userptr_t *slots;
+	size_t offset, got;
+	unsigned i;
+	int result;
+
+	KASSERT(ea->ea_buf == NULL);
+	ea->ea_buf = execargs_getbuf();
+	if (ea->ea_buf == NULL) {
+		return ENOMEM;
+	}
+	slots = (userptr_t *)ea->ea_buf;
+
+	result = execargs_copyinptrs(ea, uargv);
+	if (result) {
+		return result;
+	}
+
+	/* Strings go after the pointer array; slots become offsets. */
+	offset = (ea->ea_argc + 1) * sizeof(userptr_t);
+	for (i=0; i<ea->ea_argc; i++) {
+		if (offset >= ARG_MAX) {
+			return E2BIG;
+		}
+		result = copyinstr((const_userptr_t)slots[i],
+				   ea->ea_buf + offset, ARG_MAX - offset, &got);
+		if (result == ENAMETOOLONG) {
+			return E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		slots[i] = (userptr_t)offset;
+		offset += got;
+	}
+	ea->ea_len = offset;
+	return 0;
+}
+
+int
+execargs_kernel(struct execargs *ea, char **args, unsigned nargs)
+{
+	userptr_t *slots;
+	size_t offset, len;
+	unsigned i;
+
+	KASSERT(ea->ea_buf == NULL);
+	ea->ea_buf = execargs_getbuf();
+	if (ea->ea_buf == NULL) {
+		return ENOMEM;
+	}
+	slots = (userptr_t *)ea->ea_buf;
+
+	offset = (nargs + 1) * sizeof(userptr_t);
+	if (offset > ARG_MAX) {
+		return E2BIG;
+	}
+	for (i=0; i<nargs; i++) {
+		len = strlen(args[i]) + 1;
+		if (len > ARG_MAX - offset) {
+			return E2BIG;
+		}
+		memcpy(ea->ea_buf + offset, args[i], len);
+		slots[i] = (userptr_t)offset;
+		offset += len;
+	}
+	ea->ea_argc = nargs;
+	ea->ea_len = offset;
+	return 0;
+}
+
+int
+execargs_copyout(struct execargs *ea, vaddr_t *stackptr, userptr_t *uargv)
+{
+	userptr_t *slots = (userptr_t *)ea->ea_buf;
+	vaddr_t base;
+	unsigned i;
+	int result;
+
+	/* keep the stack 8-byte aligned */
+	base = (*stackptr - ea->ea_len) & ~(vaddr_t)7;
+
+	for (i=0; i<ea->ea_argc; i++) {
+		slots[i] = (userptr_t)(base + (vaddr_t)slots[i]);
+	}
+	slots[ea->ea_argc] = NULL;
+
+	result = copyout(ea->ea_buf, (userptr_t)base, ea->ea_len);
+	if (result) {
+		/* the new stack is empty, so it can only be too small */
+		return E2BIG;
+	}
+
+	*stackptr = base;
+	*uargv = (userptr_t)base;
+	return 0;
+}
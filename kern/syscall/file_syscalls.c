@@ -8,7 +8,247 @@
 #include <vfs.h>
 #include <current.h>
 #include <proc.h>
+#include "opt-A2.h"
+#if OPT_A2
+#include <kern/fcntl.h>
+#include <limits.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <stat.h>
+#include <openfile.h>
+#include <pipe.h>
+#include <vm.h>
+#endif // OPT_A2
 
+#if OPT_A2
+/*
+ * File descriptor system calls. Descriptors index curproc->p_files;
+ * see openfile.h. Pipe ends go to the pipe code, everything else to
+ * the vnode, with the seek position kept in the openfile.
+ */
+
+int
+sys_open(userptr_t upath, int flags, mode_t mode, int *retval)
+{
+  struct openfile *of;
+  char *path;
+  int fd;
+  int result;
+
+  path = kmalloc(PATH_MAX);
+  if (path == NULL) {
+    return ENOMEM;
+  }
+  result = copyinstr((const_userptr_t)upath, path, PATH_MAX, NULL);
+  if (result == 0) {
+    result = openfile_open(path, flags, mode, &of);
+  }
+  kfree(path);
+  if (result) {
+    return result;
+  }
+
+  result = filetable_place(curproc->p_files, of, &fd);
+  if (result) {
+    openfile_decref(of);
+    return result;
+  }
+  *retval = fd;
+  return 0;
+}
+
+/*
+ * Common part of read and write.
+ */
+static
+int
+file_rw(int fdesc, userptr_t ubuf, size_t nbytes, enum uio_rw rw,
+	int *retval)
+{
+  struct openfile *of;
+  struct iovec iov;
+  struct uio u;
+  struct stat st;
+  int result;
+
+  result = filetable_get(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  if (of->of_accmode == (rw == UIO_READ ? O_WRONLY : O_RDONLY)) {
+    return EBADF;
+  }
+
+  /* set up a uio structure to refer to the user program's buffer (ubuf) */
+  iov.iov_ubase = ubuf;
+  iov.iov_len = nbytes;
+  u.uio_iov = &iov;
+  u.uio_iovcnt = 1;
+  u.uio_offset = 0;
+  u.uio_resid = nbytes;
+  u.uio_segflg = UIO_USERSPACE;
+  u.uio_rw = rw;
+  u.uio_space = curproc->p_addrspace;
+
+  if (of->of_pipe != NULL) {
+    result = rw == UIO_READ ? pipe_read(of->of_pipe, &u) :
+	    pipe_write(of->of_pipe, &u);
+  }
+  else if (!of->of_seekable) {
+    result = rw == UIO_READ ? VOP_READ(of->of_vnode, &u) :
+	    VOP_WRITE(of->of_vnode, &u);
+  }
+  else {
+    lock_acquire(of->of_lock);
+    if (rw == UIO_WRITE && of->of_append) {
+      result = VOP_STAT(of->of_vnode, &st);
+      if (result) {
+	lock_release(of->of_lock);
+	return result;
+      }
+      of->of_offset = st.st_size;
+    }
+    u.uio_offset = of->of_offset;
+    result = rw == UIO_READ ? VOP_READ(of->of_vnode, &u) :
+	    VOP_WRITE(of->of_vnode, &u);
+    of->of_offset = u.uio_offset;
+    lock_release(of->of_lock);
+  }
+  if (rw == UIO_WRITE && of->of_pipe == NULL) {
+    vm_textinval(of->of_vnode);
+  }
+  if (result) {
+    return result;
+  }
+
+  /* pass back the number of bytes actually transferred */
+  *retval = nbytes - u.uio_resid;
+  KASSERT(*retval >= 0);
+  if (rw == UIO_READ) {
+    curthread->t_usage.tu_rbytes += *retval;
+  }
+  else {
+    curthread->t_usage.tu_wbytes += *retval;
+  }
+  return 0;
+}
+
+int
+sys_read(int fdesc, userptr_t ubuf, unsigned int nbytes, int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: read(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, UIO_READ, retval);
+}
+
+int
+sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: write(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, UIO_WRITE, retval);
+}
+
+int
+sys_close(int fdesc)
+{
+  return filetable_close(curproc->p_files, fdesc);
+}
+
+int
+sys_dup2(int oldfd, int newfd, int *retval)
+{
+  struct openfile *of;
+  int result;
+
+  result = filetable_get(curproc->p_files, oldfd, &of);
+  if (result) {
+    return result;
+  }
+  if (newfd < 0 || newfd >= OPEN_MAX) {
+    return EBADF;
+  }
+  if (newfd != oldfd) {
+    openfile_incref(of);
+    filetable_set(curproc->p_files, newfd, of);
+  }
+  *retval = newfd;
+  return 0;
+}
+
+int
+sys_fstat(int fdesc, userptr_t ustat)
+{
+  struct openfile *of;
+  struct stat st;
+  int result;
+
+  result = filetable_get(curproc->p_files, fdesc, &of);
+  if (result) {
+    return result;
+  }
+  if (of->of_pipe != NULL) {
+    bzero(&st, sizeof(st));
+    st.st_mode = S_IFIFO | 0600;
+    st.st_nlink = 1;
+  }
+  else {
+    result = VOP_STAT(of->of_vnode, &st);
+    if (result) {
+      return result;
+    }
+  }
+  return copyout(&st, ustat, sizeof(st));
+}
+
+int
+sys_pipe(userptr_t ufds, int *retval)
+{
+  struct filetable *ft = curproc->p_files;
+  struct pipe *p;
+  struct openfile *rof, *wof;
+  int fds[2];
+  int result;
+
+  result = pipe_create(&p);
+  if (result) {
+    return result;
+  }
+  rof = openfile_pipe(p, O_RDONLY);
+  if (rof == NULL) {
+    pipe_close(p, O_RDONLY);
+    pipe_close(p, O_WRONLY);
+    return ENOMEM;
+  }
+  wof = openfile_pipe(p, O_WRONLY);
+  if (wof == NULL) {
+    openfile_decref(rof);
+    pipe_close(p, O_WRONLY);
+    return ENOMEM;
+  }
+
+  result = filetable_place(ft, rof, &fds[0]);
+  if (result) {
+    openfile_decref(rof);
+    openfile_decref(wof);
+    return result;
+  }
+  result = filetable_place(ft, wof, &fds[1]);
+  if (result) {
+    filetable_close(ft, fds[0]);
+    openfile_decref(wof);
+    return result;
+  }
+
+  result = copyout(fds, ufds, sizeof(fds));
+  if (result) {
+    filetable_close(ft, fds[0]);
+    filetable_close(ft, fds[1]);
+    return result;
+  }
+  *retval = 0;
+  return 0;
+}
+
+#else // OPT_A2
 /* handler for write() system call                  */
 /*
  * n.b.
@@ -56,5 +296,7 @@ sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
   /* pass back the number of bytes actually written */
   *retval = nbytes - u.uio_resid;
   KASSERT(*retval >= 0);
+  curthread->t_usage.tu_wbytes += *retval;
   return 0;
 }
+#endif // OPT_A2
@@ -0,0 +1,231 @@
+/*
+ * futex_wait() and futex_wake(): block on, and wake threads blocked
+ * on, a word of user memory.
+ *
+ * User code does the fast path itself with atomic operations on the
+ * word and only calls in here when it has to sleep or there may be
+ * sleepers to wake. futex_wait sleeps only if the word still holds the
+ * value the caller expects, checked under the bucket lock, so a wake
+ * issued after the word changes can't be missed.
+ *
+ * Futexes are keyed by the *physical* address of the word, so that
+ * processes sharing the page (see shared memory) rendezvous on the
+ * same futex. Each hash bucket holds the futexes that currently have
+ * waiters; they are made on the first wait and freed by the last
+ * waiter to leave.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <array.h>
+#include <synch.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+#include <futex.h>
+
+#define FUTEX_HASHSIZE 64
+
+struct futex {
+	paddr_t f_paddr;	/* physical address of the word */
+	struct cv *f_cv;	/* sleepers */
+	unsigned f_waiters;	/* asleep and not yet signalled */
+	unsigned f_refs;	/* threads inside futex_wait */
+};
+
+struct futex_bucket {
+	struct lock *fb_lock;
+	struct array fb_futexes;	/* struct futex * */
+};
+
+static struct futex_bucket futex_table[FUTEX_HASHSIZE];
+
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_HASHSIZE; i++) {
+		futex_table[i].fb_lock = lock_create("futex bucket");
+		if (futex_table[i].fb_lock == NULL) {
+			panic("futex_bootstrap: out of memory\n");
+		}
+		array_init(&futex_table[i].fb_futexes);
+	}
+}
+
+static
+struct futex_bucket *
+futex_hash(paddr_t pa)
+{
+	/* words are aligned; mix in the page number */
+	return &futex_table[((pa >> 2) ^ (pa >> 12)) % FUTEX_HASHSIZE];
+}
+
+/*
+ * Find the futex for PA in bucket FB, which must be locked. If CREATE,
+ * make one if there isn't one. Returns NULL if not found or out of
+ * memory.
+ */
+static
+struct futex *
+futex_find(struct futex_bucket *fb, paddr_t pa, bool create)
+{
+	struct futex *f;
+	unsigned i, num;
+
+	num = array_num(&fb->fb_futexes);
+	for (i=0; i<num; i++) {
+		f = array_get(&fb->fb_futexes, i);
+		if (f->f_paddr == pa) {
+			return f;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+
+	f = kmalloc(sizeof(*f));
+	if (f == NULL) {
+		return NULL;
+	}
+	f->f_cv = cv_create("futex");
+	if (f->f_cv == NULL) {
+		kfree(f);
+		return NULL;
+	}
+	f->f_paddr = pa;
+	f->f_waiters = 0;
+	f->f_refs = 0;
+	if (array_add(&fb->fb_futexes, f, NULL)) {
+		cv_destroy(f->f_cv);
+		kfree(f);
+		return NULL;
+	}
+	return f;
+}
+
+/*
+ * Drop a futex from its bucket once nobody is inside futex_wait on it.
+ */
+static
+void
+futex_release(struct futex_bucket *fb, struct futex *f)
+{
+	unsigned i, num;
+
+	KASSERT(f->f_refs > 0);
+	f->f_refs--;
+	if (f->f_refs > 0) {
+		return;
+	}
+	KASSERT(f->f_waiters == 0);
+
+	num = array_num(&fb->fb_futexes);
+	for (i=0; i<num; i++) {
+		if (array_get(&fb->fb_futexes, i) == f) {
+			array_remove(&fb->fb_futexes, i);
+			break;
+		}
+	}
+	cv_destroy(f->f_cv);
+	kfree(f);
+}
+
+/*
+ * Turn a user address into the physical address of the word.
+ */
+static
+int
+futex_paddr(userptr_t uaddr, paddr_t *ret)
+{
+	struct addrspace *as;
+
+	if ((vaddr_t)uaddr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+	as = curproc_getas();
+	if (as == NULL) {
+		return EFAULT;
+	}
+	return as_translate(as, (vaddr_t)uaddr, ret);
+}
+
+int
+sys_futex_wait(userptr_t uaddr, int expected)
+{
+	struct futex_bucket *fb;
+	struct futex *f;
+	paddr_t pa;
+	int val;
+	int result;
+
+	result = futex_paddr(uaddr, &pa);
+	if (result) {
+		return result;
+	}
+	fb = futex_hash(pa);
+
+	lock_acquire(fb->fb_lock);
+
+	result = copyin((const_userptr_t)uaddr, &val, sizeof(val));
+	if (result) {
+		lock_release(fb->fb_lock);
+		return result;
+	}
+	if (val != expected) {
+		/* changed under us; let the caller retry in user space */
+		lock_release(fb->fb_lock);
+		return EAGAIN;
+	}
+
+	f = futex_find(fb, pa, true);
+	if (f == NULL) {
+		lock_release(fb->fb_lock);
+		return ENOMEM;
+	}
+	f->f_refs++;
+	f->f_waiters++;
+	cv_wait(f->f_cv, fb->fb_lock);
+	futex_release(fb, f);
+
+	lock_release(fb->fb_lock);
+	return 0;
+}
+
+int
+sys_futex_wake(userptr_t uaddr, int nwake, int32_t *retval)
+{
+	struct futex_bucket *fb;
+	struct futex *f;
+	paddr_t pa;
+	int woken;
+	int result;
+
+	if (nwake < 0) {
+		return EINVAL;
+	}
+	result = futex_paddr(uaddr, &pa);
+	if (result) {
+		return result;
+	}
+	fb = futex_hash(pa);
+
+	woken = 0;
+	lock_acquire(fb->fb_lock);
+	f = futex_find(fb, pa, false);
+	if (f != NULL) {
+		while (woken < nwake && f->f_waiters > 0) {
+			f->f_waiters--;
+			cv_signal(f->f_cv, fb->fb_lock);
+			woken++;
+		}
+	}
+	lock_release(fb->fb_lock);
+
+	*retval = woken;
+	return 0;
+}
@@ -253,6 +253,7 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		}
 	}
 
+	as_set_image(as, v);
 	result = as_prepare_load(as);
 	if (result) {
 		return result;
@@ -288,6 +289,11 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 			return ENOEXEC;
 		}
 
+		if (as_segment_loaded(as, ph.p_vaddr)) {
+			/* shared text, already in memory */
+			continue;
+		}
+
 		result = load_segment(as, v, ph.p_offset, ph.p_vaddr, 
 				      ph.p_memsz, ph.p_filesz,
 				      ph.p_flags & PF_X);
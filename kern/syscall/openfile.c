@@ -0,0 +1,231 @@
+/*
+ * Open files and file tables. See openfile.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <synch.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <pipe.h>
+#include <openfile.h>
+
+static
+struct openfile *
+openfile_create(struct vnode *v, struct pipe *p, int flags)
+{
+	struct openfile *of;
+
+	of = kmalloc(sizeof(*of));
+	if (of == NULL) {
+		return NULL;
+	}
+	of->of_vnode = v;
+	of->of_pipe = p;
+	of->of_accmode = flags & O_ACCMODE;
+	of->of_append = (flags & O_APPEND) != 0;
+	of->of_seekable = v != NULL && VOP_TRYSEEK(v, 0) == 0;
+	of->of_lock = NULL;
+	if (of->of_seekable) {
+		of->of_lock = lock_create("openfile");
+		if (of->of_lock == NULL) {
+			kfree(of);
+			return NULL;
+		}
+	}
+	of->of_offset = 0;
+	spinlock_init(&of->of_reflock);
+	of->of_refcount = 1;
+	return of;
+}
+
+int
+openfile_open(char *path, int flags, mode_t mode, struct openfile **ret)
+{
+	struct openfile *of;
+	struct vnode *v;
+	int result;
+
+	result = vfs_open(path, flags, mode, &v);
+	if (result) {
+		return result;
+	}
+	of = openfile_create(v, NULL, flags);
+	if (of == NULL) {
+		vfs_close(v);
+		return ENOMEM;
+	}
+	*ret = of;
+	return 0;
+}
+
+struct openfile *
+openfile_pipe(struct pipe *p, int accmode)
+{
+	return openfile_create(NULL, p, accmode);
+}
+
+void
+openfile_incref(struct openfile *of)
+{
+	spinlock_acquire(&of->of_reflock);
+	KASSERT(of->of_refcount > 0);
+	of->of_refcount++;
+	spinlock_release(&of->of_reflock);
+}
+
+void
+openfile_decref(struct openfile *of)
+{
+	unsigned refs;
+
+	spinlock_acquire(&of->of_reflock);
+	KASSERT(of->of_refcount > 0);
+	refs = --of->of_refcount;
+	spinlock_release(&of->of_reflock);
+	if (refs > 0) {
+		return;
+	}
+
+	if (of->of_vnode != NULL) {
+		vfs_close(of->of_vnode);
+	}
+	if (of->of_pipe != NULL) {
+		pipe_close(of->of_pipe, of->of_accmode);
+	}
+	if (of->of_lock != NULL) {
+		lock_destroy(of->of_lock);
+	}
+	spinlock_cleanup(&of->of_reflock);
+	kfree(of);
+}
+
+static
+struct filetable *
+filetable_alloc(void)
+{
+	struct filetable *ft;
+	unsigned i;
+
+	ft = kmalloc(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = NULL;
+	}
+	return ft;
+}
+
+struct filetable *
+filetable_create(void)
+{
+	static const int stdflags[3] = { O_RDONLY, O_WRONLY, O_WRONLY };
+	struct filetable *ft;
+	char path[5];
+	int i;
+
+	ft = filetable_alloc();
+	if (ft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<3; i++) {
+		/* vfs_open can scribble on the path */
+		strcpy(path, "con:");
+		if (openfile_open(path, stdflags[i], 0, &ft->ft_files[i])) {
+			filetable_destroy(ft);
+			return NULL;
+		}
+	}
+	return ft;
+}
+
+struct filetable *
+filetable_copy(struct filetable *ft)
+{
+	struct filetable *newft;
+	unsigned i;
+
+	newft = filetable_alloc();
+	if (newft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_incref(ft->ft_files[i]);
+			newft->ft_files[i] = ft->ft_files[i];
+		}
+	}
+	return newft;
+}
+
+void
+filetable_destroy(struct filetable *ft)
+{
+	unsigned i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_decref(ft->ft_files[i]);
+			ft->ft_files[i] = NULL;
+		}
+	}
+	kfree(ft);
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	if (fd < 0 || fd >= OPEN_MAX || ft->ft_files[fd] == NULL) {
+		return EBADF;
+	}
+	*ret = ft->ft_files[fd];
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct openfile *of, int *fd)
+{
+	int i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] == NULL) {
+			ft->ft_files[i] = of;
+			*fd = i;
+			return 0;
+		}
+	}
+	return EMFILE;
+}
+
+int
+filetable_set(struct filetable *ft, int fd, struct openfile *of)
+{
+	struct openfile *old;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+	old = ft->ft_files[fd];
+	ft->ft_files[fd] = of;
+	if (old != NULL) {
+		openfile_decref(old);
+	}
+	return 0;
+}
+
+int
+filetable_close(struct filetable *ft, int fd)
+{
+	struct openfile *of;
+
+	if (fd < 0 || fd >= OPEN_MAX || ft->ft_files[fd] == NULL) {
+		return EBADF;
+	}
+	of = ft->ft_files[fd];
+	ft->ft_files[fd] = NULL;
+	openfile_decref(of);
+	return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Pipes. See pipe.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <synch.h>
+#include <uio.h>
+#include <vm.h>
+#include <addrspace.h>
+#include <pipe.h>
+
+struct pipe {
+	struct lock *pp_lock;		/* protects everything below */
+	struct lock *pp_wlock;		/* held by a writer for a whole write */
+	struct cv *pp_readcv;		/* readers wait for data */
+	struct cv *pp_writecv;		/* writers wait for room or the loan */
+	char *pp_buf;			/* the ring, PIPE_SIZE bytes */
+	unsigned pp_head;		/* next byte to read */
+	unsigned pp_count;		/* bytes in the ring */
+	struct uio *pp_loan;		/* writer's buffer on loan, or NULL */
+	int pp_loanerr;			/* why the loan ended early */
+	unsigned pp_readers;		/* open reader ends */
+	unsigned pp_writers;		/* open writer ends */
+};
+
+static
+void
+pipe_destroy(struct pipe *p)
+{
+	KASSERT(p->pp_readers == 0 && p->pp_writers == 0);
+	KASSERT(p->pp_loan == NULL);
+
+	kfree(p->pp_buf);
+	cv_destroy(p->pp_writecv);
+	cv_destroy(p->pp_readcv);
+	lock_destroy(p->pp_wlock);
+	lock_destroy(p->pp_lock);
+	kfree(p);
+}
+
+int
+pipe_create(struct pipe **ret)
+{
+	struct pipe *p;
+
+	p = kmalloc(sizeof(*p));
+	if (p == NULL) {
+		return ENOMEM;
+	}
+	p->pp_lock = lock_create("pipe");
+	p->pp_wlock = lock_create("pipe writer");
+	p->pp_readcv = cv_create("pipe read");
+	p->pp_writecv = cv_create("pipe write");
+	p->pp_buf = kmalloc(PIPE_SIZE);
+	if (p->pp_lock == NULL || p->pp_wlock == NULL ||
+	    p->pp_readcv == NULL || p->pp_writecv == NULL ||
+	    p->pp_buf == NULL) {
+		if (p->pp_buf) kfree(p->pp_buf);
+		if (p->pp_writecv) cv_destroy(p->pp_writecv);
+		if (p->pp_readcv) cv_destroy(p->pp_readcv);
+		if (p->pp_wlock) lock_destroy(p->pp_wlock);
+		if (p->pp_lock) lock_destroy(p->pp_lock);
+		kfree(p);
+		return ENOMEM;
+	}
+	p->pp_head = 0;
+	p->pp_count = 0;
+	p->pp_loan = NULL;
+	p->pp_loanerr = 0;
+	p->pp_readers = 1;
+	p->pp_writers = 1;
+	*ret = p;
+	return 0;
+}
+
+void
+pipe_close(struct pipe *p, int accmode)
+{
+	bool dead;
+
+	lock_acquire(p->pp_lock);
+	if (accmode == O_RDONLY) {
+		KASSERT(p->pp_readers > 0);
+		p->pp_readers--;
+	}
+	else {
+		KASSERT(p->pp_writers > 0);
+		p->pp_writers--;
+	}
+	/* wake anyone waiting on the other end to notice */
+	cv_broadcast(p->pp_readcv, p->pp_lock);
+	cv_broadcast(p->pp_writecv, p->pp_lock);
+	dead = p->pp_readers == 0 && p->pp_writers == 0;
+	lock_release(p->pp_lock);
+
+	if (dead) {
+		pipe_destroy(p);
+	}
+}
+
+/*
+ * Copy what we can from the ring into UIO. Called locked.
+ */
+static
+int
+pipe_takering(struct pipe *p, struct uio *uio)
+{
+	unsigned n;
+	int result;
+
+	while (p->pp_count > 0 && uio->uio_resid > 0) {
+		n = p->pp_count;
+		if (n > PIPE_SIZE - p->pp_head) {
+			n = PIPE_SIZE - p->pp_head;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(p->pp_buf + p->pp_head, n, uio);
+		if (result) {
+			return result;
+		}
+		p->pp_head = (p->pp_head + n) % PIPE_SIZE;
+		p->pp_count -= n;
+	}
+	cv_broadcast(p->pp_writecv, p->pp_lock);
+	return 0;
+}
+
+/*
+ * Copy what we can from the loaned writer's buffer into UIO, a page
+ * at a time, advancing the writer's uio as we go. Ends the loan when
+ * the writer's buffer is used up or turns out not to be mapped. Called
+ * locked.
+ */
+static
+int
+pipe_takeloan(struct pipe *p, struct uio *uio)
+{
+	struct uio *lu = p->pp_loan;
+	struct iovec *iov = lu->uio_iov;
+	vaddr_t va;
+	paddr_t pa;
+	size_t n;
+	int result;
+
+	KASSERT(lu->uio_iovcnt == 1);
+
+	while (lu->uio_resid > 0 && uio->uio_resid > 0) {
+		va = (vaddr_t)iov->iov_ubase;
+		result = as_translate(lu->uio_space, va, &pa);
+		if (result) {
+			p->pp_loanerr = result;
+			break;
+		}
+		n = PAGE_SIZE - (va % PAGE_SIZE);
+		if (n > lu->uio_resid) {
+			n = lu->uio_resid;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove((void *)PADDR_TO_KVADDR(pa), n, uio);
+		if (result) {
+			/* our fault, not the writer's; the loan stands */
+			return result;
+		}
+		iov->iov_ubase = (userptr_t)(va + n);
+		iov->iov_len -= n;
+		lu->uio_offset += n;
+		lu->uio_resid -= n;
+	}
+	if (lu->uio_resid == 0 || p->pp_loanerr != 0) {
+		p->pp_loan = NULL;
+	}
+	cv_broadcast(p->pp_writecv, p->pp_lock);
+	return 0;
+}
+
+int
+pipe_read(struct pipe *p, struct uio *uio)
+{
+	size_t startresid = uio->uio_resid;
+	int result = 0;
+
+	lock_acquire(p->pp_lock);
+	while (uio->uio_resid > 0) {
+		if (p->pp_count > 0) {
+			result = pipe_takering(p, uio);
+			break;
+		}
+		if (p->pp_loan != NULL) {
+			result = pipe_takeloan(p, uio);
+			if (result || uio->uio_resid < startresid) {
+				break;
+			}
+			/* loan was bad; the writer will sort it out */
+			continue;
+		}
+		if (p->pp_writers == 0) {
+			/* end of file */
+			break;
+		}
+		cv_wait(p->pp_readcv, p->pp_lock);
+	}
+	lock_release(p->pp_lock);
+	return result;
+}
+
+int
+pipe_write(struct pipe *p, struct uio *uio)
+{
+	size_t startresid = uio->uio_resid;
+	unsigned tail, n;
+	int result = 0;
+
+	lock_acquire(p->pp_wlock);
+	lock_acquire(p->pp_lock);
+	while (uio->uio_resid > 0) {
+		if (p->pp_readers == 0) {
+			result = EPIPE;
+			break;
+		}
+
+		if (uio->uio_segflg == UIO_USERSPACE &&
+		    uio->uio_iovcnt == 1 &&
+		    uio->uio_resid >= PIPE_LOANMIN &&
+		    p->pp_count == 0) {
+			/* lend the rest of the buffer to the readers */
+			p->pp_loan = uio;
+			p->pp_loanerr = 0;
+			cv_broadcast(p->pp_readcv, p->pp_lock);
+			while (p->pp_loan != NULL && p->pp_readers > 0) {
+				cv_wait(p->pp_writecv, p->pp_lock);
+			}
+			p->pp_loan = NULL;
+			if (p->pp_loanerr) {
+				result = p->pp_loanerr;
+				break;
+			}
+			continue;
+		}
+
+		if (p->pp_count == PIPE_SIZE) {
+			cv_wait(p->pp_writecv, p->pp_lock);
+			continue;
+		}
+		tail = (p->pp_head + p->pp_count) % PIPE_SIZE;
+		n = PIPE_SIZE - p->pp_count;
+		if (n > PIPE_SIZE - tail) {
+			n = PIPE_SIZE - tail;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(p->pp_buf + tail, n, uio);
+		if (result) {
+			break;
+		}
+		p->pp_count += n;
+		cv_broadcast(p->pp_readcv, p->pp_lock);
+	}
+	lock_release(p->pp_lock);
+	lock_release(p->pp_wlock);
+
+	/* a short write is not an error once the reader has gone */
+	if (result == EPIPE && uio->uio_resid < startresid) {
+		result = 0;
+	}
+	return result;
+}
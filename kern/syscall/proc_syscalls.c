@@ -16,6 +16,10 @@
 #include <array.h>
 #include <test.h>
 #include <mips/trapframe.h>
+#include <execargs.h>
+#include <kern/fcntl.h>
+#include <vfs.h>
+#include <openfile.h>
 
   /* this implementation of sys__exit does not do anything with the exit code */
   /* this needs to be fixed to get exit() and waitpid() working properly */
@@ -48,6 +52,10 @@ void sys__exit(int exitcode) {
   as_destroy(as);
     proc_remthread(curthread);
   #if OPT_A2
+  //close files now, not when the parent lets us go, so that pipe
+  //readers see end of file
+  filetable_destroy(p->p_files);
+  p->p_files = NULL;
   //kprintf("abcd %d \n", array_num(&p->p_children));
   for (unsigned int i = array_num(&p->p_children); i > 0 ; i--) {
       struct proc *childproc = array_get(&p->p_children,i-1);
@@ -147,6 +155,15 @@ sys_waitpid(pid_t pid,
   //kprintf ("loopend!!!!!!!!!!!!\n");
   lock_release(p->p_wait_lock);
 
+  //the child's usage, and its children's, count towards ours, once
+  if (!p->p_waited) {
+    p->p_waited = true;
+    spinlock_acquire(&curproc->p_lock);
+    threadusage_add(&curproc->p_cusage, &p->p_usage);
+    threadusage_add(&curproc->p_cusage, &p->p_cusage);
+    spinlock_release(&curproc->p_lock);
+  }
+
   exitstatus = p->exitcode;
   result = copyout((void *)&exitstatus,status,sizeof(int));
 
@@ -208,49 +225,166 @@ sys_fork(pid_t *retval,struct trapframe *tf)
 }
 
 int sys_execv(char* program, char **args,int32_t *retval) {
-  (void) args;
-  size_t p_namelen = strlen((char *)program)+1;
-  char c_program[p_namelen];//copied promgram name
-  int no_arg=0;
-  int copy_err;
-  int execv_err;
-
-  //copy the promgram path into kernel and check if successed
-  copy_err = copyinstr((const_userptr_t)program, c_program, p_namelen, NULL);
-  if(copy_err){
-    // return a error code
-    *retval =  copy_err;
-    return -1;
+  char *c_program;
+  struct execargs ea;
+  int result;
+
+  (void)retval;
+
+  //copy the program path into kernel
+  c_program = kmalloc(PATH_MAX);
+  if (c_program == NULL) {
+    return ENOMEM;
+  }
+  result = copyinstr((const_userptr_t)program, c_program, PATH_MAX, NULL);
+  if (result) {
+    kfree(c_program);
+    return result;
   }
 
-  //estimate space for arguments and number of args
-  size_t argslen = 0;
-  while(args[no_arg]){
-    argslen += strlen(((char**)args)[no_arg])+1; //1 for \0
-    no_arg ++;
+  //gather argv (pointer array in one copyin, strings packed behind it)
+  execargs_init(&ea);
+  result = execargs_copyin(&ea, (const_userptr_t)args);
+  if (result == 0) {
+    DEBUG(DB_SYSCALL,"Going to runprogram argc %u \n",ea.ea_argc);
+    result = runprogram(c_program, &ea);
   }
+  //only get here on failure
+  execargs_cleanup(&ea);
+  kfree(c_program);
+  return result;
+}
 
-  //copy args into kernel
-  char* c_args[no_arg];
-  char arg_char_len[argslen];
-  int offset = 0; 
-  for (int i = 0; i < no_arg; ++i)
-  {
-    size_t got;
-    size_t arglen = strlen(((char**)args)[i])+1;
-    char * haha = arg_char_len + offset;
-    copy_err = copyinstr((const_userptr_t)args[i],haha,arglen,&got);
-    if(copy_err){
-       *retval =  copy_err;
-        return -1;
-    }
-    c_args[i] = haha;
-    offset += got;
+/*
+ * Where a spawned child starts running; handed over by sys_spawn.
+ */
+struct spawnstart {
+  vaddr_t ss_entry;
+  vaddr_t ss_stackptr;
+  userptr_t ss_argv;
+};
+
+static
+void
+enter_spawned_process(void *data, unsigned long argc)
+{
+  struct spawnstart ss = *(struct spawnstart *)data;
+
+  kfree(data);
+  enter_new_process(argc, ss.ss_argv, ss.ss_stackptr, ss.ss_entry);
+  panic("enter_new_process returned\n");
+}
+
+/*
+ * spawn(): start PROGRAM with ARGS in a new child process, which is
+ * what fork() followed at once by execv() does, without copying the
+ * parent's address space only to throw it away.
+ *
+ * The program is loaded by the calling thread into the child's fresh
+ * address space, which is switched in for the duration; this process
+ * has only the one thread, and it is busy in here. Doing the load here
+ * rather than in the child means a missing or bad executable comes
+ * back as an error from spawn instead of as an exit status.
+ */
+int
+sys_spawn(userptr_t program, userptr_t args, pid_t *retval)
+{
+  char *c_program;
+  struct execargs ea;
+  struct addrspace *as, *parent_as;
+  struct vnode *v;
+  struct spawnstart *ss;
+  struct proc *childproc;
+  unsigned index;
+  int argc;
+  int result;
+
+  c_program = kmalloc(PATH_MAX);
+  if (c_program == NULL) {
+    return ENOMEM;
+  }
+  result = copyinstr((const_userptr_t)program, c_program, PATH_MAX, NULL);
+  if (result) {
+    kfree(c_program);
+    return result;
+  }
+
+  //named after the program; before vfs_open, which destroys the path
+  childproc = proc_create_runprogram(c_program);
+  if (childproc == NULL) {
+    kfree(c_program);
+    return ENPROC;
   }
-  DEBUG(DB_SYSCALL,"Going to runprogram no_arg %d \n",no_arg);
-  execv_err = runprogram(c_program,c_args,no_arg);
-  //should not be into here
-  return 1;
+
+  //gather argv while our own address space is still current
+  execargs_init(&ea);
+  result = execargs_copyin(&ea, (const_userptr_t)args);
+  if (result) {
+    goto fail_args;
+  }
+
+  ss = kmalloc(sizeof(*ss));
+  if (ss == NULL) {
+    result = ENOMEM;
+    goto fail_args;
+  }
+
+  result = vfs_open(c_program, O_RDONLY, 0, &v);
+  if (result) {
+    goto fail_ss;
+  }
+
+  as = as_create();
+  if (as == NULL) {
+    vfs_close(v);
+    result = ENOMEM;
+    goto fail_ss;
+  }
+
+  //load into the child's address space, then switch back
+  parent_as = curproc_setas(as);
+  as_activate();
+  result = loadprogram(v, as, &ea, &ss->ss_entry, &ss->ss_stackptr,
+		       &ss->ss_argv);
+  curproc_setas(parent_as);
+  as_activate();
+  vfs_close(v);
+  if (result) {
+    goto fail_as;
+  }
+  argc = ea.ea_argc;
+
+  //the child must be ours to wait for before it can run
+  result = array_add(&curproc->p_children, childproc, &index);
+  if (result) {
+    goto fail_as;
+  }
+  childproc->p_addrspace = as;
+
+  result = thread_fork(childproc->p_name, childproc, &enter_spawned_process,
+		       ss, argc);
+  if (result) {
+    array_remove(&curproc->p_children, index);
+    childproc->p_addrspace = NULL;
+    goto fail_as;
+  }
+  execargs_cleanup(&ea);
+  kfree(c_program);
+
+  lock_acquire(childproc->p_exit_lock);
+  *retval = childproc->p_pid;
+  return 0;
+
+ fail_as:
+  //proc_destroy leaves the address space to _exit
+  as_destroy(as);
+ fail_ss:
+  kfree(ss);
+ fail_args:
+  execargs_cleanup(&ea);
+  proc_destroy(childproc);
+  kfree(c_program);
+  return result;
 }
 #else
 #endif
@@ -45,23 +45,60 @@
 #include <syscall.h>
 #include <test.h>
 #include <limits.h>
-#include <copyinout.h>
-#include "opt-A2.h"
+#include <execargs.h>
 
 /*
- * Load program "progname" and start running it in usermode.
- * Does not return except on error.
+ * Load the executable open on V into AS, which must be the current
+ * address space, define its stack and put the arguments from EA on it.
+ * On success returns the entry point, initial stack pointer and user
+ * argv pointer. The caller opens and closes V and keeps EA either way.
+ */
+int
+loadprogram(struct vnode *v, struct addrspace *as, struct execargs *ea,
+	    vaddr_t *entrypoint, vaddr_t *stackptr, userptr_t *argv)
+{
+	int result;
+
+	KASSERT(as == curproc_getas());
+
+	/* Load the executable. */
+	result = load_elf(v, entrypoint);
+	if (result) {
+		return result;
+	}
+
+	/* Define the user stack in the address space */
+	result = as_define_stack(as, stackptr);
+	if (result) {
+		return result;
+	}
+
+	/* Put the arguments on the new stack. */
+	return execargs_copyout(ea, stackptr, argv);
+}
+
+/*
+ * Load program "progname" and start running it in usermode, with the
+ * arguments gathered in EA. Does not return except on error; EA is
+ * released on success and left to the caller on error.
+ *
+ * The old address space, if any, is kept until the new image is loaded
+ * and the arguments are on its stack, so that on error (including E2BIG
+ * for arguments that don't fit the stack) the caller is still there to
+ * return to.
  *
  * Calls vfs_open on progname and thus may destroy it.
  */
 
 int
-runprogram(char *progname,char **args,unsigned long no_arg)
+runprogram(char *progname, struct execargs *ea)
 {
-	DEBUG(DB_SYSCALL,"runprogram no_arg %lu \n",no_arg);
-	struct addrspace *as;
+	DEBUG(DB_SYSCALL,"runprogram argc %u \n",ea->ea_argc);
+	struct addrspace *as, *old_as;
 	struct vnode *v;
 	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	int argc;
 	int result;
 
 	/* Open the file. */
@@ -70,113 +107,40 @@ runprogram(char *progname,char **args,unsigned long no_arg)
 		return result;
 	}
 
-
-
-	/* We should be a new process. */
-	if(curproc_getas()){
-		as_deactivate();
-	}
-	//KASSERT(curproc_getas() == NULL);
-
 	/* Create a new address space. */
 	as = as_create();
 	if (as ==NULL) {
 		vfs_close(v);
 		return ENOMEM;
 	}
+
 	/* Switch to it and activate it. */
-	struct addrspace * pre_as = curproc_setas(as);
-	if (pre_as != NULL) {
-		as_destroy(pre_as);
+	if(curproc_getas()){
+		as_deactivate();
 	}
+	old_as = curproc_setas(as);
 	as_activate();
 
-	/* Load the executable. */
-	result = load_elf(v, &entrypoint);
-	if (result) {
-		/* p_addrspace will go away when curproc is destroyed */
-		vfs_close(v);
-		return result;
-	}
-
-	/* Done with the file now. */
+	/* p_addrspace will go away when curproc is destroyed */
+	result = loadprogram(v, as, ea, &entrypoint, &stackptr, &argv);
 	vfs_close(v);
-
-	/* Define the user stack in the address space */
-	result = as_define_stack(as, &stackptr);
 	if (result) {
-		/* p_addrspace will go away when curproc is destroyed */
+		/* back to the old one, which is still intact */
+		as_deactivate();
+		curproc_setas(old_as);
+		as_activate();
+		as_destroy(as);
 		return result;
 	}
-
-#if OPT_A2
-	DEBUG(DB_SYSCALL,"runprogram point 1 \n");
-	if(no_arg == 0){
-		enter_new_process(0, NULL,stackptr, entrypoint);
-	}else{
-		if(!args){ // only if args is not define
-			char *tem[1] = {NULL};
-			args = tem;
-		}
-		//check length available
-		int args_len = 0;
-		DEBUG(DB_SYSCALL,"runprogram point 5 \n");
-		for (unsigned long i = 0; i < no_arg; i++) {
-			args_len += strlen(args[i]) + 1; // +1 for \0
-			DEBUG(DB_SYSCALL,"check length i: %lu \n",i);
-		}
-		DEBUG(DB_SYSCALL,"runprogram point 6 \n");
-		//get memery space for args
-		size_t ptr_size = sizeof(userptr_t);
-		int arg_mem = (sizeof(char**) * (no_arg+1));
-		if(arg_mem % ptr_size != 0){
-			arg_mem += ptr_size - (arg_mem % ptr_size);
-		}	
-		int args_mem = (sizeof(char) * args_len);
-		if(args_mem % ptr_size != 0){
-			args_mem += ptr_size - (args_mem % ptr_size);
-		}	
-		args_mem += arg_mem;
-
-		 //move the stack pointer back
-		 stackptr -= args_mem;
-
-		 // copy argument values back on the user stack
-		char *argv[no_arg + 1]; 
-		userptr_t c_argv = (userptr_t)stackptr;
-		userptr_t c_val = (userptr_t)(stackptr + arg_mem);
-
-		size_t got;
-		int offset = 0;
-
-		DEBUG(DB_SYSCALL,"runprogram point 3 \n");
-		for (unsigned long i = 0; i < no_arg; i++) {
-			char * arg = args[i];
-			userptr_t dest = (userptr_t)((char *)c_val + offset);
-			result = copyoutstr(arg, dest, strlen(arg) + 1, &got);
-			if (result) {
-				return result;
-			}
-			argv[i] = (char *)dest;
-			offset += got;
-		}
-
-		argv[no_arg] = NULL;
-		DEBUG(DB_SYSCALL,"runprogram point 4 \n");
-		result = copyout(argv, c_argv, (no_arg + 1) * sizeof(char *));
-		if (result) {
-			// Address space copy error
-			return result;
-		}
-		DEBUG(DB_SYSCALL,"runprogram point 2 \n");
-		enter_new_process(no_arg, c_argv,stackptr, entrypoint);
+	if (old_as != NULL) {
+		as_destroy(old_as);
 	}
-#else
-	enter_new_process(0, NULL ,stackptr, entrypoint);
-#endif
+	argc = ea->ea_argc;
+	execargs_cleanup(ea);
+
+	enter_new_process(argc, argv, stackptr, entrypoint);
 
 	/* enter_new_process does not return. */
 	panic("enter_new_process returned\n");
 	return EINVAL;
 }
-
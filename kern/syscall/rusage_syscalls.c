@@ -0,0 +1,112 @@
+/*
+ * getrusage() and procstat(): report the resource usage charged to
+ * threads (see struct threadusage in thread.h) to user level.
+ *
+ * Usage follows a thread into its process's p_usage when it leaves the
+ * process, and a process's usage (with that of the children it waited
+ * for) into its parent's p_cusage when the parent waits for it.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/procstat.h>
+#include <lib.h>
+#include <clock.h>
+#include <copyinout.h>
+#include <current.h>
+#include <thread.h>
+#include <proc.h>
+#include <syscall.h>
+
+/* Bytes per block for ru_inblock and ru_oublock. */
+#define RUSAGE_BLOCKSIZE 512
+
+static
+void
+ticks_to_timeval(uint32_t ticks, struct timeval *tv)
+{
+	tv->tv_sec = ticks / HZ;
+	tv->tv_usec = (ticks % HZ) * (1000000 / HZ);
+}
+
+/*
+ * There are no major faults (nothing is ever paged in from disk), and
+ * reads and writes are counted in bytes, so the block counts are those
+ * rounded up to RUSAGE_BLOCKSIZE. procstat has the exact byte counts.
+ */
+int
+sys_getrusage(int who, userptr_t uru)
+{
+	struct threadusage tu;
+	struct rusage ru;
+
+	switch (who) {
+	    case RUSAGE_SELF:
+		proc_getusage(curproc, &tu);
+		break;
+	    case RUSAGE_CHILDREN:
+		spinlock_acquire(&curproc->p_lock);
+		tu = curproc->p_cusage;
+		spinlock_release(&curproc->p_lock);
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	bzero(&ru, sizeof(ru));
+	ticks_to_timeval(tu.tu_uticks, &ru.ru_utime);
+	ticks_to_timeval(tu.tu_sticks, &ru.ru_stime);
+	ru.ru_minflt = tu.tu_faults;
+	ru.ru_inblock = (tu.tu_rbytes + RUSAGE_BLOCKSIZE - 1) / RUSAGE_BLOCKSIZE;
+	ru.ru_oublock = (tu.tu_wbytes + RUSAGE_BLOCKSIZE - 1) / RUSAGE_BLOCKSIZE;
+	ru.ru_nvcsw = tu.tu_nvcsw;
+	ru.ru_nivcsw = tu.tu_nivcsw;
+
+	return copyout(&ru, uru, sizeof(ru));
+}
+
+/*
+ * The snapshot is taken into a kernel buffer sized for the processes
+ * there are now; if more turn up before we look, they are counted in
+ * ss_nprocs but not described.
+ */
+int
+sys_procstat(userptr_t uss, userptr_t ups, unsigned nps, int32_t *retval)
+{
+	struct sysstat ss;
+	struct procstat *ps;
+	unsigned max, num;
+	int result;
+
+	max = proc_snapshot(NULL, 0);
+	if (max > nps) {
+		max = nps;
+	}
+	ps = NULL;
+	if (max > 0) {
+		ps = kmalloc(max * sizeof(*ps));
+		if (ps == NULL) {
+			return ENOMEM;
+		}
+		bzero(ps, max * sizeof(*ps));
+	}
+
+	bzero(&ss, sizeof(ss));
+	ss.ss_hz = HZ;
+	thread_cputicks(&ss.ss_ncpus, &ss.ss_ticks, &ss.ss_idleticks);
+	ss.ss_nprocs = proc_snapshot(ps, max);
+	num = ss.ss_nprocs < max ? ss.ss_nprocs : max;
+
+	result = copyout(&ss, uss, sizeof(ss));
+	if (result == 0 && num > 0) {
+		result = copyout(ps, ups, num * sizeof(*ps));
+	}
+	kfree(ps);
+	if (result) {
+		return result;
+	}
+	*retval = num;
+	return 0;
+}
@@ -28,9 +28,13 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <lib.h>
 #include <clock.h>
 #include <copyinout.h>
 #include <syscall.h>
+#include <bench.h>
 
 /*
  * Example system call: get the time of day.
@@ -56,3 +60,53 @@ sys___time(userptr_t user_seconds_ptr, userptr_t user_nanoseconds_ptr)
 
 	return 0;
 }
+
+/*
+ * Mark the start or end of benchmark region ID. See bench.h.
+ */
+int
+sys___bench(int op, unsigned id)
+{
+	if (id > BENCH_MAXID) {
+		return EINVAL;
+	}
+	switch (op) {
+	    case BENCH_BEGIN:
+		bench_begin(id);
+		return 0;
+	    case BENCH_END:
+		bench_end(id);
+		return 0;
+	}
+	return EINVAL;
+}
+
+/*
+ * Sleep for the time in UREQ. Nothing can interrupt the sleep, so if
+ * UREM isn't NULL the time left in it is always zero.
+ */
+int
+sys_nanosleep(userptr_t ureq, userptr_t urem)
+{
+	struct timespec req, rem;
+	int result;
+
+	result = copyin(ureq, &req, sizeof(req));
+	if (result) {
+		return result;
+	}
+	if (req.tv_sec < 0 || req.tv_nsec < 0 || req.tv_nsec >= 1000000000) {
+		return EINVAL;
+	}
+
+	result = clock_nsleep((uint64_t)req.tv_sec * 1000000000 + req.tv_nsec);
+	if (result) {
+		return result;
+	}
+
+	if (urem != NULL) {
+		bzero(&rem, sizeof(rem));
+		result = copyout(&rem, urem, sizeof(rem));
+	}
+	return result;
+}
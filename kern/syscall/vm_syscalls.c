@@ -0,0 +1,224 @@
+/*
+ * mmap(), munmap() and msync(): map files, or anonymous memory, into
+ * the address space; shm_attach() and shm_remove(): named anonymous
+ * memory; sbrk(): move the end of the heap.
+ *
+ * A mapping is a region in the address space (see addrspace.h) over a
+ * vmobj (see vmobj.h); nothing is read until the pages are touched.
+ * MAP_SHARED mappings of a file all use the file's one writeback
+ * object, so they see each other's changes, and what is written
+ * through them goes back to the file on msync, munmap or exit.
+ * MAP_PRIVATE mappings get an object of their own, and their changes
+ * are never written back.
+ *
+ * MAP_ANON mappings are zero-filled memory with no file. Shared ones
+ * stay shared across fork, so related processes can use them to
+ * exchange data; shm_attach gives unrelated processes the same thing
+ * by key.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/mman.h>
+#include <lib.h>
+#include <current.h>
+#include <proc.h>
+#include <vnode.h>
+#include <addrspace.h>
+#include <openfile.h>
+#include <vmobj.h>
+#include <syscall.h>
+
+/*
+ * Check ADDR and LEN for munmap and msync, and turn LEN into pages.
+ */
+static
+int
+vm_userrange(userptr_t uaddr, size_t len, unsigned *npages)
+{
+	vaddr_t addr = (vaddr_t)uaddr;
+
+	if ((addr & PAGE_FRAME) != addr || len == 0 ||
+	    addr >= USERSPACETOP || len > USERSPACETOP - addr) {
+		return EINVAL;
+	}
+	*npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+	return 0;
+}
+
+/*
+ * Get the object for a mapping of FD: the file's writeback object for
+ * MAP_SHARED, else a private one.
+ */
+static
+int
+mmap_fileobj(int fd, off_t offset, unsigned npages, int prot, bool shared,
+	     struct vmobj **obj, unsigned *objpage)
+{
+	struct openfile *of;
+	int result;
+
+	result = filetable_get(curproc->p_files, fd, &of);
+	if (result) {
+		return result;
+	}
+	if (of->of_vnode == NULL) {
+		/* a pipe */
+		return ENODEV;
+	}
+	/* pages are read in, so the file must be open for reading */
+	if (of->of_accmode == O_WRONLY ||
+	    (shared && (prot & PROT_WRITE) && of->of_accmode != O_RDWR)) {
+		return EACCES;
+	}
+	result = VOP_MMAP(of->of_vnode);
+	if (result) {
+		return result;
+	}
+
+	if (shared) {
+		*objpage = offset / PAGE_SIZE;
+		return vmobj_shared(of->of_vnode, *objpage + npages, obj);
+	}
+	*objpage = 0;
+	*obj = vmobj_create(of->of_vnode, offset, npages);
+	if (*obj == NULL) {
+		return ENOMEM;
+	}
+	return 0;
+}
+
+int
+sys_mmap(userptr_t uaddr, size_t len, int prot, int flags, int fd,
+	 off_t offset, int32_t *retval)
+{
+	struct vmobj *obj;
+	vaddr_t addr;
+	unsigned npages, objpage;
+	bool shared, fixed;
+	int result;
+
+	shared = (flags & MAP_SHARED) != 0;
+	fixed = (flags & MAP_FIXED) != 0;
+	if (shared == ((flags & MAP_PRIVATE) != 0) ||
+	    (flags & ~(MAP_SHARED | MAP_PRIVATE | MAP_FIXED | MAP_ANON)) ||
+	    (prot & ~(PROT_READ | PROT_WRITE | PROT_EXEC)) != 0) {
+		return EINVAL;
+	}
+	if (len == 0 || offset < 0 || offset % PAGE_SIZE != 0 ||
+	    offset / PAGE_SIZE > USERSPACETOP / PAGE_SIZE) {
+		return EINVAL;
+	}
+	if (len > USERSPACETOP) {
+		return ENOMEM;
+	}
+	npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+	addr = (vaddr_t)uaddr;
+
+	if (flags & MAP_ANON) {
+		/* vr_shared alone decides whether fork shares it */
+		obj = vmobj_create(NULL, 0, npages);
+		if (obj == NULL) {
+			return ENOMEM;
+		}
+		objpage = 0;
+	}
+	else {
+		result = mmap_fileobj(fd, offset, npages, prot, shared,
+				      &obj, &objpage);
+		if (result) {
+			return result;
+		}
+	}
+
+	result = as_map(curproc_getas(), &addr, npages, prot, shared, fixed,
+			obj, objpage);
+	if (result) {
+		vmobj_decref(obj);
+		return result;
+	}
+	*retval = (int32_t)addr;
+	return 0;
+}
+
+int
+sys_munmap(userptr_t uaddr, size_t len)
+{
+	unsigned npages;
+	int result;
+
+	result = vm_userrange(uaddr, len, &npages);
+	if (result) {
+		return result;
+	}
+	return as_unmap(curproc_getas(), (vaddr_t)uaddr, npages);
+}
+
+int
+sys_msync(userptr_t uaddr, size_t len, int flags)
+{
+	unsigned npages;
+	int result;
+
+	if ((flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)) != 0 ||
+	    (flags & (MS_ASYNC | MS_SYNC)) == (MS_ASYNC | MS_SYNC)) {
+		return EINVAL;
+	}
+	result = vm_userrange(uaddr, len, &npages);
+	if (result) {
+		return result;
+	}
+	/* always synchronous; shared mappings are always coherent */
+	return as_sync(curproc_getas(), (vaddr_t)uaddr, npages);
+}
+
+int
+sys_shm_attach(int key, size_t len, int prot, int32_t *retval)
+{
+	struct vmobj *obj;
+	vaddr_t addr;
+	unsigned npages;
+	int result;
+
+	if (len == 0 || (prot & ~(PROT_READ | PROT_WRITE | PROT_EXEC)) != 0) {
+		return EINVAL;
+	}
+	if (len > USERSPACETOP) {
+		return ENOMEM;
+	}
+	npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	result = vmobj_named(key, npages, &obj);
+	if (result) {
+		return result;
+	}
+	result = as_map(curproc_getas(), &addr, npages, prot, true, false,
+			obj, 0);
+	if (result) {
+		vmobj_decref(obj);
+		return result;
+	}
+	*retval = (int32_t)addr;
+	return 0;
+}
+
+int
+sys_shm_remove(int key)
+{
+	return vmobj_unname(key);
+}
+
+int
+sys_sbrk(int change, int32_t *retval)
+{
+	vaddr_t oldbreak;
+	int result;
+
+	result = as_sbrk(curproc_getas(), change, &oldbreak);
+	if (result) {
+		return result;
+	}
+	*retval = (int32_t)oldbreak;
+	return 0;
+}
@@ -0,0 +1,608 @@
+/*
+ * bench - microbenchmarks run from the kernel menu.
+ *
+ * Usage: bench [test] [reps]
+ *
+ * Each test is run REPS times (default BENCH_REPS) and prints one
+ * line:
+ *
+ *   bench <test> n=<reps> min_cyc=.. med_cyc=.. max_cyc=.. min_us=..
+ *         med_us=.. max_us=.. [kbps=..]
+ *
+ * all on one line, so runs from different kernels can be compared
+ * with diff or a script. Times are per operation; the fast tests time
+ * a batch of BENCH_BATCH operations per rep and divide, so the clock
+ * reads don't swamp what is being measured. kbps, for the file tests,
+ * is from the median.
+ *
+ *   yield     thread_yield to another thread on this cpu and back
+ *   lockcv    hand a token to another thread and back with a lock and
+ *             a cv
+ *   exec      run /testbin/ubench, which exits at once: process
+ *             creation, exec, exit and teardown
+ *   syscall   getpid from user level, timed by /testbin/ubench
+ *   fork      fork, _exit and waitpid, timed by /testbin/ubench
+ *   sfs       sequential and random 4K reads and writes of a
+ *             BENCH_FILEKB file, bench.tmp in the current directory
+ *             (cd to the filesystem to measure first)
+ *   all       all of the above
+ *
+ * The user-level tests print their own lines in the same format.
+ * Each test runs inside a bench_begin/bench_end region numbered by
+ * its place in benchtable, starting from 1.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <clock.h>
+#include <uio.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <synch.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <execargs.h>
+#include <bench.h>
+#include <test.h>
+
+/*
+ * For turning nanoseconds into cycles. This is CPU_FREQUENCY from
+ * lamebus_machdep.c, in MHz; the clock we read counts nanoseconds.
+ */
+#define BENCH_MHZ	25
+
+#define BENCH_REPS	50
+#define BENCH_MAXREPS	10000
+#define BENCH_BATCH	100
+#define BENCH_PROG	"/testbin/ubench"
+#define BENCH_NOPROG	"/testbin/nonexistent"	/* for benchtest */
+#define BENCH_FILE	"bench.tmp"
+#define BENCH_FILEKB	256
+#define BENCH_BLOCK	4096
+#define BENCH_NBLOCKS	(BENCH_FILEKB * 1024 / BENCH_BLOCK)
+
+/*
+ * Samples, in nanoseconds per operation.
+ */
+struct bench_samples {
+	uint64_t *bs_ns;
+	unsigned bs_num;
+	unsigned bs_max;
+};
+
+static
+int
+bench_init(struct bench_samples *bs, unsigned reps)
+{
+	bs->bs_ns = kmalloc(reps * sizeof(uint64_t));
+	if (bs->bs_ns == NULL) {
+		return ENOMEM;
+	}
+	bs->bs_num = 0;
+	bs->bs_max = reps;
+	return 0;
+}
+
+static
+void
+bench_cleanup(struct bench_samples *bs)
+{
+	kfree(bs->bs_ns);
+	bs->bs_ns = NULL;
+}
+
+static
+void
+bench_add(struct bench_samples *bs, uint64_t start, unsigned ops)
+{
+	KASSERT(bs->bs_num < bs->bs_max);
+	bs->bs_ns[bs->bs_num++] = (gettime_nsecs() - start) / ops;
+}
+
+static
+void
+bench_printtime(const char *what, uint64_t ns)
+{
+	kprintf(" %s_us=%llu.%03llu", what, ns / 1000, ns % 1000);
+}
+
+/*
+ * Sort the samples (there are few enough for insertion sort) and
+ * print the line for test NAME. BYTES is how much each operation
+ * moves, or 0.
+ */
+static
+void
+bench_report(const char *name, struct bench_samples *bs, size_t bytes)
+{
+	uint64_t *ns = bs->bs_ns;
+	uint64_t t, min, med, max;
+	unsigned i, j;
+
+	if (bs->bs_num == 0) {
+		kprintf("bench %s n=0\n", name);
+		return;
+	}
+	for (i=1; i<bs->bs_num; i++) {
+		t = ns[i];
+		for (j=i; j>0 && ns[j-1] > t; j--) {
+			ns[j] = ns[j-1];
+		}
+		ns[j] = t;
+	}
+	min = ns[0];
+	med = ns[bs->bs_num / 2];
+	max = ns[bs->bs_num - 1];
+
+	kprintf("bench %s n=%u min_cyc=%llu med_cyc=%llu max_cyc=%llu",
+		name, bs->bs_num, min * BENCH_MHZ / 1000,
+		med * BENCH_MHZ / 1000, max * BENCH_MHZ / 1000);
+	bench_printtime("min", min);
+	bench_printtime("med", med);
+	bench_printtime("max", max);
+	if (bytes > 0) {
+		kprintf(" kbps=%llu",
+			med ? (uint64_t)bytes * 1000000000ULL / 1024 / med : 0);
+	}
+	kprintf("\n");
+	bs->bs_num = 0;
+}
+
+////////////////////////////////////////////////////////////
+// thread tests
+
+/*
+ * The partner thread for yield and lockcv. New threads start on the
+ * forking thread's cpu, so the two normally share a run queue; if
+ * the partner migrates, yield stops switching and the numbers say so.
+ */
+static volatile bool bench_done;
+static volatile unsigned bench_turn;
+static struct lock *bench_lock;
+static struct cv *bench_cv;
+static struct semaphore *bench_exitsem;
+
+static
+void
+bench_yielder(void *p, unsigned long n)
+{
+	(void)p;
+	(void)n;
+
+	while (!bench_done) {
+		thread_yield();
+	}
+	V(bench_exitsem);
+}
+
+/*
+ * Wait until it is WHO's turn, then pass the token on.
+ */
+static
+void
+bench_handoff(unsigned who)
+{
+	lock_acquire(bench_lock);
+	while (bench_turn != who) {
+		cv_wait(bench_cv, bench_lock);
+	}
+	bench_turn = !who;
+	cv_signal(bench_cv, bench_lock);
+	lock_release(bench_lock);
+}
+
+static
+void
+bench_lockcvpartner(void *p, unsigned long n)
+{
+	unsigned long i;
+
+	(void)p;
+
+	for (i=0; i<n; i++) {
+		bench_handoff(1);
+	}
+	V(bench_exitsem);
+}
+
+static
+int
+bench_yield(unsigned reps, struct bench_samples *bs)
+{
+	uint64_t start;
+	unsigned r, i;
+	int result;
+
+	bench_done = false;
+	result = thread_fork("bench yield", NULL, bench_yielder, NULL, 0);
+	if (result) {
+		return result;
+	}
+	for (r=0; r<reps; r++) {
+		start = gettime_nsecs();
+		for (i=0; i<BENCH_BATCH; i++) {
+			thread_yield();
+		}
+		bench_add(bs, start, BENCH_BATCH);
+	}
+	bench_done = true;
+	P(bench_exitsem);
+	bench_report("yield", bs, 0);
+	return 0;
+}
+
+static
+int
+bench_lockcv(unsigned reps, struct bench_samples *bs)
+{
+	uint64_t start;
+	unsigned r, i;
+	int result;
+
+	bench_turn = 0;
+	result = thread_fork("bench lockcv", NULL, bench_lockcvpartner, NULL,
+			     reps * BENCH_BATCH);
+	if (result) {
+		return result;
+	}
+	for (r=0; r<reps; r++) {
+		start = gettime_nsecs();
+		for (i=0; i<BENCH_BATCH; i++) {
+			bench_handoff(0);
+		}
+		bench_add(bs, start, BENCH_BATCH);
+	}
+	P(bench_exitsem);
+	bench_report("lockcv", bs, 0);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// user-level tests
+
+/* runprogram's error, if it failed; read after the process is gone */
+static int bench_progresult;
+
+/*
+ * Run the program ARGS[0] in this new process. If that fails, take
+ * the process apart the way _exit would, so that bench_runprog wakes
+ * up, and leave it the error.
+ */
+static
+void
+bench_progthread(void *ptr, unsigned long nargs)
+{
+	char **args = ptr;
+	char progname[128];
+	struct execargs ea;
+	struct addrspace *as;
+	struct proc *p;
+	int result;
+
+	/* runprogram destroys the name it gets */
+	execargs_init(&ea);
+	if (strlen(args[0]) >= sizeof(progname)) {
+		result = ENAMETOOLONG;
+	}
+	else {
+		strcpy(progname, args[0]);
+		result = execargs_kernel(&ea, args, nargs);
+	}
+	if (result == 0) {
+		result = runprogram(progname, &ea);
+	}
+	execargs_cleanup(&ea);
+
+	bench_progresult = result;
+	as_deactivate();
+	as = curproc_setas(NULL);
+	if (as != NULL) {
+		as_destroy(as);
+	}
+	p = curproc;
+	proc_remthread(curthread);
+	proc_destroy(p);
+}
+
+/*
+ * Run the program ARGS[0] with ARGS and wait for it, and anything it
+ * forks, to finish, like the menu's p command. Fails if it couldn't be
+ * run.
+ */
+static
+int
+bench_runprog(int nargs, char **args)
+{
+	struct proc *proc;
+	int result;
+
+	proc = proc_create_runprogram(args[0]);
+	if (proc == NULL) {
+		return ENOMEM;
+	}
+	bench_progresult = 0;
+	result = thread_fork(args[0], proc, bench_progthread, args, nargs);
+	if (result) {
+		proc_destroy(proc);
+		return result;
+	}
+#ifdef UW
+	P(no_proc_sem);
+#endif
+	return bench_progresult;
+}
+
+static
+int
+bench_exec(unsigned reps, struct bench_samples *bs)
+{
+	char *args[2];
+	uint64_t start;
+	unsigned r;
+	int result;
+
+	args[0] = (char *)BENCH_PROG;
+	args[1] = NULL;
+	for (r=0; r<reps; r++) {
+		start = gettime_nsecs();
+		result = bench_runprog(1, args);
+		if (result) {
+			return result;
+		}
+		bench_add(bs, start, 1);
+	}
+	bench_report("exec", bs, 0);
+	return 0;
+}
+
+/*
+ * Have BENCH_PROG run test NAME; it prints its own line.
+ */
+static
+int
+bench_user(const char *name, unsigned reps)
+{
+	char repsbuf[16];
+	char *args[4];
+
+	snprintf(repsbuf, sizeof(repsbuf), "%u", reps);
+	args[0] = (char *)BENCH_PROG;
+	args[1] = (char *)name;
+	args[2] = repsbuf;
+	args[3] = NULL;
+	return bench_runprog(3, args);
+}
+
+static
+int
+bench_syscall(unsigned reps, struct bench_samples *bs)
+{
+	(void)bs;
+	return bench_user("syscall", reps);
+}
+
+static
+int
+bench_fork(unsigned reps, struct bench_samples *bs)
+{
+	(void)bs;
+	return bench_user("fork", reps);
+}
+
+////////////////////////////////////////////////////////////
+// file system tests
+
+/*
+ * Do BENCH_NBLOCKS block transfers between BUF and BENCH_FILE, in
+ * order or at pseudo-random blocks; the same seed each time, so every
+ * run touches the same blocks.
+ */
+static
+int
+bench_filepass(char *buf, enum uio_rw rw, bool rnd, uint32_t *seed)
+{
+	char path[sizeof(BENCH_FILE)];
+	struct vnode *vn;
+	struct iovec iov;
+	struct uio ku;
+	unsigned i, block;
+	int result;
+
+	strcpy(path, BENCH_FILE);
+	result = vfs_open(path, rw == UIO_READ ? O_RDONLY : O_WRONLY|O_CREAT,
+			  0664, &vn);
+	if (result) {
+		return result;
+	}
+	for (i=0; i<BENCH_NBLOCKS; i++) {
+		block = i;
+		if (rnd) {
+			*seed = *seed * 1103515245 + 12345;
+			block = (*seed >> 16) % BENCH_NBLOCKS;
+		}
+		uio_kinit(&iov, &ku, buf, BENCH_BLOCK,
+			  (off_t)block * BENCH_BLOCK, rw);
+		result = rw == UIO_READ ? VOP_READ(vn, &ku) : VOP_WRITE(vn, &ku);
+		if (result == 0 && ku.uio_resid != 0) {
+			result = EIO;
+		}
+		if (result) {
+			break;
+		}
+	}
+	vfs_close(vn);
+	return result;
+}
+
+static
+int
+bench_sfs(unsigned reps, struct bench_samples *bs)
+{
+	static const struct {
+		const char *name;
+		enum uio_rw rw;
+		bool rnd;
+	} passes[] = {
+		/* write first, so the reads have a whole file */
+		{ "sfs_seqwrite", UIO_WRITE, false },
+		{ "sfs_seqread", UIO_READ, false },
+		{ "sfs_randwrite", UIO_WRITE, true },
+		{ "sfs_randread", UIO_READ, true },
+	};
+	char path[sizeof(BENCH_FILE)];
+	uint64_t start;
+	uint32_t seed;
+	unsigned p, r, i;
+	char *buf;
+	int result = 0;
+
+	buf = kmalloc(BENCH_BLOCK);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<BENCH_BLOCK; i++) {
+		buf[i] = i * 31;
+	}
+
+	for (p=0; p<sizeof(passes)/sizeof(passes[0]); p++) {
+		seed = 1;
+		for (r=0; r<reps; r++) {
+			start = gettime_nsecs();
+			result = bench_filepass(buf, passes[p].rw,
+						passes[p].rnd, &seed);
+			if (result) {
+				goto out;
+			}
+			bench_add(bs, start, 1);
+		}
+		bench_report(passes[p].name, bs, BENCH_FILEKB * 1024);
+	}
+
+ out:
+	kfree(buf);
+	strcpy(path, BENCH_FILE);
+	vfs_remove(path);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+
+static const struct {
+	const char *name;
+	int (*func)(unsigned reps, struct bench_samples *bs);
+} benchtable[] = {
+	{ "yield",	bench_yield },
+	{ "lockcv",	bench_lockcv },
+	{ "exec",	bench_exec },
+	{ "syscall",	bench_syscall },
+	{ "fork",	bench_fork },
+	{ "sfs",	bench_sfs },
+	{ NULL, NULL }
+};
+
+int
+bench(int nargs, char **args)
+{
+	struct bench_samples bs;
+	const char *test = "all";
+	unsigned reps = BENCH_REPS;
+	unsigned i, ran = 0;
+	int result = 0;
+
+	if (nargs > 3) {
+		kprintf("Usage: bench [yield|lockcv|exec|syscall|fork|sfs|all]"
+			" [reps]\n");
+		return EINVAL;
+	}
+	if (nargs > 1) {
+		test = args[1];
+	}
+	if (nargs > 2) {
+		reps = atoi(args[2]);
+		if (reps == 0 || reps > BENCH_MAXREPS) {
+			kprintf("bench: reps must be 1 to %u\n", BENCH_MAXREPS);
+			return EINVAL;
+		}
+	}
+
+	if (bench_init(&bs, reps)) {
+		return ENOMEM;
+	}
+	bench_exitsem = sem_create("bench exit", 0);
+	bench_lock = lock_create("bench");
+	bench_cv = cv_create("bench");
+	if (bench_exitsem == NULL || bench_lock == NULL || bench_cv == NULL) {
+		result = ENOMEM;
+		goto out;
+	}
+
+	for (i=0; benchtable[i].name != NULL; i++) {
+		if (strcmp(test, "all") && strcmp(test, benchtable[i].name)) {
+			continue;
+		}
+		ran++;
+		bench_begin(i + 1);
+		result = benchtable[i].func(reps, &bs);
+		bench_end(i + 1);
+		if (result) {
+			kprintf("bench: %s: %s\n", benchtable[i].name,
+				strerror(result));
+			goto out;
+		}
+	}
+	if (ran == 0) {
+		kprintf("bench: unknown test %s\n", test);
+		result = EINVAL;
+	}
+
+ out:
+	if (bench_cv != NULL) {
+		cv_destroy(bench_cv);
+	}
+	if (bench_lock != NULL) {
+		lock_destroy(bench_lock);
+	}
+	if (bench_exitsem != NULL) {
+		sem_destroy(bench_exitsem);
+	}
+	bench_cv = NULL;
+	bench_lock = NULL;
+	bench_exitsem = NULL;
+	bench_cleanup(&bs);
+	return result;
+}
+
+/*
+ * Check that a bench whose program can't be run fails with the error,
+ * rather than hanging or panicking. Twice, since a first failure that
+ * left the process count wrong would hang the second.
+ */
+int
+benchtest(int nargs, char **args)
+{
+	char *pargs[2];
+	unsigned i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting bench test...\n");
+	pargs[0] = (char *)BENCH_NOPROG;
+	pargs[1] = NULL;
+	for (i=0; i<2; i++) {
+		result = bench_runprog(1, pargs);
+		if (result != ENOENT) {
+			kprintf("benchtest: running %s: got %s, expected %s\n",
+				BENCH_NOPROG, strerror(result),
+				strerror(ENOENT));
+			return EINVAL;
+		}
+	}
+	kprintf("Bench test complete\n");
+	return 0;
+}
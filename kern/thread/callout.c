@@ -0,0 +1,327 @@
+/*
+ * Callouts. See callout.h.
+ *
+ * A wheel has CALLOUT_LEVELS levels of CALLOUT_SLOTS slots. A slot on
+ * level L covers CALLOUT_SLOTS^L ticks, so level 0 holds the callouts
+ * due in the next CALLOUT_SLOTS ticks, one slot per tick, level 1 the
+ * ones due in the next CALLOUT_SLOTS^2, and so on. Each time the low
+ * bits of the tick count for a level roll over to zero, the next slot
+ * of the level above is emptied and its callouts put back in lower
+ * down, where they now belong. Anything due beyond the top level's
+ * reach goes off at the end of it instead; clock_nsleep looks at the
+ * time when it wakes up, so for it that's only a spurious wakeup.
+ *
+ * The fine-grained callouts are on one list, soonest first, with the
+ * timer device counting down to the first of them.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+#include <clock.h>
+#include <platform/maxcpus.h>
+#include <callout.h>
+
+#define CALLOUT_LEVELS		4
+#define CALLOUT_SLOTBITS	6
+#define CALLOUT_SLOTS		(1 << CALLOUT_SLOTBITS)
+#define CALLOUT_SLOTMASK	(CALLOUT_SLOTS - 1)
+
+/* Ticks the whole wheel covers. */
+#define CALLOUT_REACH \
+	((uint64_t)1 << (CALLOUT_LEVELS * CALLOUT_SLOTBITS))
+
+struct callout_wheel {
+	struct spinlock cw_lock;
+	uint64_t cw_now;		/* ticks done so far */
+	struct callout *cw_slots[CALLOUT_LEVELS][CALLOUT_SLOTS];
+};
+
+static struct callout_wheel *callout_wheels[MAXCPUS];
+
+static struct spinlock callout_hireslock = SPINLOCK_INITIALIZER;
+static struct callout *callout_hireslist;
+
+void
+callout_init(struct callout *co, void (*func)(void *), void *arg)
+{
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+	co->co_expire = 0;
+	co->co_lock = NULL;
+	co->co_func = func;
+	co->co_arg = arg;
+}
+
+void
+callout_cpuinit(struct cpu *c)
+{
+	struct callout_wheel *cw;
+
+	KASSERT(c->c_number < MAXCPUS);
+	cw = kmalloc(sizeof(*cw));
+	if (cw == NULL) {
+		panic("callout_cpuinit: Out of memory\n");
+	}
+	spinlock_init(&cw->cw_lock);
+	cw->cw_now = 0;
+	bzero(cw->cw_slots, sizeof(cw->cw_slots));
+	callout_wheels[c->c_number] = cw;
+}
+
+/*
+ * Put CO on the list at *PP, which LOCK protects and is held.
+ */
+static
+void
+callout_link(struct callout **pp, struct callout *co, struct spinlock *lock)
+{
+	co->co_next = *pp;
+	co->co_prevp = pp;
+	if (co->co_next != NULL) {
+		co->co_next->co_prevp = &co->co_next;
+	}
+	*pp = co;
+	co->co_lock = lock;
+}
+
+static
+void
+callout_unlink(struct callout *co)
+{
+	*co->co_prevp = co->co_next;
+	if (co->co_next != NULL) {
+		co->co_next->co_prevp = co->co_prevp;
+	}
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+	co->co_lock = NULL;
+}
+
+/*
+ * Put CO, which is due at or after cw_now, in the slot it belongs in.
+ */
+static
+void
+callout_wheel_add(struct callout_wheel *cw, struct callout *co)
+{
+	uint64_t delta;
+	unsigned level, slot;
+
+	KASSERT(co->co_expire >= cw->cw_now);
+	delta = co->co_expire - cw->cw_now;
+	if (delta >= CALLOUT_REACH) {
+		co->co_expire = cw->cw_now + CALLOUT_REACH - 1;
+		delta = CALLOUT_REACH - 1;
+	}
+	for (level = 0; level < CALLOUT_LEVELS - 1; level++) {
+		if (delta < (uint64_t)1 << ((level + 1) * CALLOUT_SLOTBITS)) {
+			break;
+		}
+	}
+	slot = (co->co_expire >> (level * CALLOUT_SLOTBITS)) & CALLOUT_SLOTMASK;
+	callout_link(&cw->cw_slots[level][slot], co, &cw->cw_lock);
+}
+
+void
+callout_schedule(struct callout *co, unsigned ticks)
+{
+	struct callout_wheel *cw;
+	int spl;
+
+	callout_stop(co);
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	/* stay on this cpu until we're on its wheel */
+	spl = splhigh();
+	cw = callout_wheels[curcpu->c_number];
+	spinlock_acquire(&cw->cw_lock);
+	co->co_expire = cw->cw_now + ticks;
+	callout_wheel_add(cw, co);
+	spinlock_release(&cw->cw_lock);
+	splx(spl);
+}
+
+bool
+callout_stop(struct callout *co)
+{
+	struct spinlock *lock;
+
+	/* it can move between our looking and our locking */
+	while ((lock = co->co_lock) != NULL) {
+		spinlock_acquire(lock);
+		if (co->co_lock == lock) {
+			callout_unlink(co);
+			spinlock_release(lock);
+			return true;
+		}
+		spinlock_release(lock);
+	}
+	return false;
+}
+
+/*
+ * Take CO off its list (whose lock LOCK is held) and call it, without
+ * the lock. Returns with the lock held again.
+ */
+static
+void
+callout_fire(struct callout *co, struct spinlock *lock)
+{
+	void (*func)(void *);
+	void *arg;
+
+	callout_unlink(co);
+	func = co->co_func;
+	arg = co->co_arg;
+	spinlock_release(lock);
+	func(arg);
+	spinlock_acquire(lock);
+}
+
+void
+callout_tick(void)
+{
+	struct callout_wheel *cw;
+	struct callout *co, *next;
+	unsigned level, slot;
+
+	cw = callout_wheels[curcpu->c_number];
+	spinlock_acquire(&cw->cw_lock);
+	cw->cw_now++;
+
+	/* move the next slot of each level that has come round down */
+	for (level = 1; level < CALLOUT_LEVELS; level++) {
+		if ((cw->cw_now &
+		     (((uint64_t)1 << (level * CALLOUT_SLOTBITS)) - 1)) != 0) {
+			break;
+		}
+		slot = (cw->cw_now >> (level * CALLOUT_SLOTBITS)) &
+			CALLOUT_SLOTMASK;
+		co = cw->cw_slots[level][slot];
+		cw->cw_slots[level][slot] = NULL;
+		for (; co != NULL; co = next) {
+			next = co->co_next;
+			callout_wheel_add(cw, co);
+		}
+	}
+
+	slot = cw->cw_now & CALLOUT_SLOTMASK;
+	while ((co = cw->cw_slots[0][slot]) != NULL) {
+		callout_fire(co, &cw->cw_lock);
+	}
+	spinlock_release(&cw->cw_lock);
+}
+
+/*
+ * A callout on level 0 is due at its tick. One on a higher level is
+ * due no sooner than its slot comes round and is moved down, which is
+ * when the tick count reaches the start of the span the slot covers.
+ * Within a level the slots come round in order starting after the
+ * current one, so only the first one in use on each level counts.
+ */
+unsigned
+callout_nextdue(unsigned max)
+{
+	struct callout_wheel *cw;
+	uint64_t base, due, best;
+	unsigned level, shift, cur, d;
+
+	cw = callout_wheels[curcpu->c_number];
+	best = max;
+	spinlock_acquire(&cw->cw_lock);
+	for (level = 0; level < CALLOUT_LEVELS; level++) {
+		shift = level * CALLOUT_SLOTBITS;
+		base = cw->cw_now >> shift;
+		cur = base & CALLOUT_SLOTMASK;
+		for (d = 1; d <= CALLOUT_SLOTS; d++) {
+			if (cw->cw_slots[level][(cur + d) & CALLOUT_SLOTMASK]
+			    != NULL) {
+				due = ((base + d) << shift) - cw->cw_now;
+				if (due < best) {
+					best = due;
+				}
+				break;
+			}
+		}
+	}
+	spinlock_release(&cw->cw_lock);
+	return best;
+}
+
+/*
+ * Start the timer device counting down to the first fine-grained
+ * callout. The countdown is in whole microseconds, so round up.
+ */
+static
+bool
+callout_hiresarm(uint64_t now)
+{
+	uint64_t usecs;
+
+	KASSERT(spinlock_do_i_hold(&callout_hireslock));
+	KASSERT(callout_hireslist != NULL);
+
+	if (callout_hireslist->co_expire <= now) {
+		usecs = 1;
+	}
+	else {
+		usecs = (callout_hireslist->co_expire - now + 999) / 1000;
+		if (usecs > 0xffffffff) {
+			usecs = 0xffffffff;
+		}
+	}
+	return timerclock_arm(usecs);
+}
+
+void
+callout_schedule_nsecs(struct callout *co, uint64_t when)
+{
+	struct callout **pp;
+	uint64_t now;
+	uint64_t tick = 1000000000 / HZ;
+
+	callout_stop(co);
+	now = gettime_nsecs();
+
+	spinlock_acquire(&callout_hireslock);
+	for (pp = &callout_hireslist; *pp != NULL; pp = &(*pp)->co_next) {
+		if ((*pp)->co_expire > when) {
+			break;
+		}
+	}
+	co->co_expire = when;
+	callout_link(pp, co, &callout_hireslock);
+	if (callout_hireslist == co && !callout_hiresarm(now)) {
+		/* no timer device; the tick after WHEN will have to do */
+		callout_unlink(co);
+		spinlock_release(&callout_hireslock);
+		callout_schedule(co, when > now ? (when - now + tick - 1) / tick
+				 : 1);
+		return;
+	}
+	spinlock_release(&callout_hireslock);
+}
+
+void
+callout_hires(void)
+{
+	struct callout *co;
+	uint64_t now;
+
+	spinlock_acquire(&callout_hireslock);
+	while ((co = callout_hireslist) != NULL) {
+		now = gettime_nsecs();
+		if (co->co_expire > now) {
+			callout_hiresarm(now);
+			break;
+		}
+		callout_fire(co, &callout_hireslock);
+	}
+	spinlock_release(&callout_hireslock);
+}
@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <cpu.h>
 #include <wchan.h>
@@ -35,13 +36,16 @@
 #include <thread.h>
 #include <lamebus/ltimer.h>
 #include <current.h>
+#include <mainbus.h>
+#include <callout.h>
 
 /*
  * Time handling.
  *
- * This is pretty primitive. A real kernel will typically have some
- * kind of support for scheduling callbacks to happen at specific
- * points in the future, usually with more resolution that one second.
+ * Timed sleeps use callouts (see callout.h): whole ticks on the cpu's
+ * callout wheel, the last fraction of a tick on the timer device's
+ * one-shot countdown. Each sleeping thread has its own wait channel,
+ * so the callout wakes exactly the thread whose time is up.
  *
  * A real kernel also has to maintain the time of day; in OS/161 we
  * skimp on that because we have a known-good hardware clock.
@@ -54,24 +58,21 @@
 #define SCHEDULE_HARDCLOCKS	4	/* Reschedule every 4 hardclocks. */
 #define MIGRATE_HARDCLOCKS	16	/* Migrate every 16 hardclocks. */
 
-/*
- * Once a second, everything waiting on lbolt is awakened by CPU 0.
- */
-static struct wchan *lbolt;
-/*
- * Once every LT_GRANULARITY usec, everything on minibolt is awakenened by CPU 0
- */
-static struct wchan *minibolt;
+/* Nanoseconds per hardclock. */
+#define TICK_NSECS	(1000000000 / HZ)
 
-/* 
- * number of minibolts per second
+/*
+ * Longest an idle cpu puts its hardclock off for. It has to run the
+ * missed ticks one at a time when it wakes up, so don't let that get
+ * out of hand.
  */
-#define MINI_PER_SECOND (1000000/LT_GRANULARITY);
+#define IDLE_MAXTICKS	(HZ * 10)
 
 /*
- * minibolt countdown
+ * The timer device's countdown, if we have one.
  */
-static int minicount;
+static void *timerclock_dev;
+static void (*timerclock_armfunc)(void *devdata, uint32_t usecs);
 
 /*
  * Setup.
@@ -79,33 +80,35 @@ static int minicount;
 void
 hardclock_bootstrap(void)
 {
-	lbolt = wchan_create("lbolt");
-	if (lbolt == NULL) {
-		panic("Couldn't create lbolt\n");
-	}
-	minibolt = wchan_create("minibolt");
-	if (minibolt == NULL) {
-		panic("Couldn't create minibolt\n");
+	/* nothing; the callout wheels are set up with their cpus */
+}
+
+void
+timerclock_attach(void *devdata, void (*arm)(void *devdata, uint32_t))
+{
+	KASSERT(timerclock_armfunc == NULL);
+	timerclock_dev = devdata;
+	timerclock_armfunc = arm;
+}
+
+bool
+timerclock_arm(uint32_t usecs)
+{
+	if (timerclock_armfunc == NULL) {
+		return false;
 	}
-	minicount = MINI_PER_SECOND;
-	/* we assume MINI_PER_SECOND > 0 */
-	KASSERT(minicount > 0);
+	timerclock_armfunc(timerclock_dev, usecs);
+	return true;
 }
 
 /*
- * This is called once every every LT_GRANULARITY usec, on one processor,
- * by the timer code.
+ * This is called, on one processor, when the timer device's countdown
+ * runs out.
  */
 void
 timerclock(void)
 {
-	/* Broadcast on minibolt */
-	wchan_wakeall(minibolt);
-	/* Broadcast on lbolt if a second has elapsed */
-	if (--minicount <= 0) {
-	  minicount = MINI_PER_SECOND;
-	  wchan_wakeall(lbolt);
-	}
+	callout_hires();
 }
 
 /*
@@ -120,6 +123,7 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	callout_tick();
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
@@ -129,17 +133,136 @@ hardclock(void)
 	thread_yield();
 }
 
+/*
+ * Called from the idle loop, on no locks and with interrupts off, just
+ * before the cpu waits for an interrupt. If nothing on this cpu's
+ * wheel is due for a while, put off the next hardclock until it is;
+ * there's nothing else for an idle cpu's hardclock to do. (Fine-
+ * grained callouts are on the timer device, not the hardclock.)
+ */
+void
+hardclock_idle(void)
+{
+	unsigned ticks;
+	uint64_t now;
+
+	KASSERT(curcpu->c_isidle);
+	KASSERT(curthread->t_curspl > 0);
+
+	if (curcpu->c_tickdefer > 0) {
+		/* still put off; woken by something other than an interrupt */
+		return;
+	}
+	ticks = callout_nextdue(IDLE_MAXTICKS);
+	if (ticks < 2) {
+		return;
+	}
+	now = gettime_nsecs();
+	if (now == 0) {
+		/* no clock to tell how many ticks we missed */
+		return;
+	}
+	curcpu->c_tickdefer = ticks;
+	curcpu->c_tickdeferat = now;
+	mainbus_timer_defer(ticks);
+}
+
+/*
+ * Called first thing in any interrupt on a cpu whose hardclock was put
+ * off. Run the ticks it missed, as idle ticks, so the callout wheel
+ * and the tick counts are up to date before anything else looks at
+ * them, and go back to taking a hardclock every tick.
+ *
+ * If TIMER, the put-off hardclock is pending, perhaps along with other
+ * interrupts, so all but one of the ticks were missed. The pending one
+ * is left alone to be run as usual by the timer interrupt, now or once
+ * the others have been handled, rather than also being counted here.
+ * Otherwise, count how many whole ticks have gone by, which can't
+ * include the last one since the timer hasn't gone off, and start the
+ * timer again from now.
+ */
+void
+hardclock_resume(bool timer)
+{
+	uint64_t elapsed;
+	unsigned skipped, i;
+
+	KASSERT(curcpu->c_tickdefer > 0);
+
+	skipped = curcpu->c_tickdefer - 1;
+	if (!timer) {
+		elapsed = (gettime_nsecs() - curcpu->c_tickdeferat) / TICK_NSECS;
+		if (elapsed < skipped) {
+			skipped = elapsed;
+		}
+		mainbus_timer_defer(1);
+	}
+	curcpu->c_tickdefer = 0;
+
+	/* nothing is due before the end, but levels may need moving down */
+	for (i=0; i<skipped; i++) {
+		curcpu->c_hardclocks++;
+		curcpu->c_idleticks++;
+		callout_tick();
+	}
+	curcpu->c_skippedticks += skipped;
+}
+
+static
+void
+clock_wake(void *wc)
+{
+	wchan_wakeall(wc);
+}
+
+/*
+ * Sleep on the wheel while there's at least a tick to go, rounding
+ * down since the current tick is already partly over; then sleep out
+ * the rest on the timer device. Nothing else uses the thread's wait
+ * channel, so every wakeup is the callout's, but the callout may have
+ * gone off early (see callout.c), so check the time each time round.
+ */
+int
+clock_nsleep(uint64_t nsecs)
+{
+	struct callout co;
+	struct wchan *wc;
+	uint64_t now, when;
+
+	wc = curthread->t_sleepwc;
+	if (wc == NULL) {
+		wc = wchan_create("clocksleep");
+		if (wc == NULL) {
+			return ENOMEM;
+		}
+		curthread->t_sleepwc = wc;
+	}
+
+	callout_init(&co, clock_wake, wc);
+	when = gettime_nsecs() + nsecs;
+	while ((now = gettime_nsecs()) < when) {
+		wchan_lock(wc);
+		if (when - now >= TICK_NSECS) {
+			callout_schedule(&co, (when - now) / TICK_NSECS);
+		}
+		else {
+			callout_schedule_nsecs(&co, when);
+		}
+		wchan_sleep(wc);
+	}
+	return 0;
+}
+
 /*
  * Suspend execution for n seconds.
  */
 void
 clocksleep(int num_secs)
 {
-  while (num_secs > 0) {
-    wchan_lock(lbolt);
-    wchan_sleep(lbolt);
-    num_secs--;
-  }
+	if (num_secs > 0) {
+		/* if we can't sleep, we can only return early */
+		(void)clock_nsleep((uint64_t)num_secs * 1000000000);
+	}
 }
 
 /*
@@ -149,9 +272,7 @@ clocksleep(int num_secs)
 void
 clocknap(int num_ticks)
 {
-  while (num_ticks > 0) {
-    wchan_lock(minibolt);
-    wchan_sleep(minibolt);
-    num_ticks--;
-  }
+	if (num_ticks > 0) {
+		(void)clock_nsleep((uint64_t)num_ticks * LT_GRANULARITY * 1000);
+	}
 }
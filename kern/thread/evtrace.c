@@ -0,0 +1,249 @@
+/*
+ * Event tracing. See evtrace.h.
+ *
+ * Like the profiler's rings, each cpu's ring is only written by that
+ * cpu, with interrupts off, so recording needs no locks. The rings are
+ * allocated in evtrace_bootstrap, once the VM system is up and all the
+ * cpus have been found.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <current.h>
+#include <clock.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <platform/maxcpus.h>
+#include <evtrace.h>
+
+struct evtrace_cpu {
+	struct evtrace_rec *ec_recs;	/* the ring, or NULL */
+	unsigned ec_count;		/* events recorded since start */
+};
+
+static struct evtrace_cpu evtrace_cpus[MAXCPUS];
+static unsigned evtrace_ncpus;
+
+volatile bool evtrace_enabled = false;
+
+void
+evtrace_cpuinit(struct cpu *c)
+{
+	KASSERT(c->c_number < MAXCPUS);
+	if (c->c_number >= evtrace_ncpus) {
+		evtrace_ncpus = c->c_number + 1;
+	}
+}
+
+void
+evtrace_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<evtrace_ncpus; i++) {
+		evtrace_cpus[i].ec_recs =
+			kmalloc(EVTRACE_NRECS * sizeof(struct evtrace_rec));
+		if (evtrace_cpus[i].ec_recs == NULL) {
+			panic("evtrace_bootstrap: out of memory\n");
+		}
+		evtrace_cpus[i].ec_count = 0;
+	}
+	evtrace_enabled = true;
+}
+
+void
+evtrace_record(unsigned type, uint32_t arg0, uint32_t arg1)
+{
+	struct evtrace_cpu *ec;
+	struct evtrace_rec *r;
+	int spl;
+
+	/* interrupt handlers wake threads, so keep them off the ring */
+	spl = splhigh();
+	ec = &evtrace_cpus[curcpu->c_number];
+	r = &ec->ec_recs[ec->ec_count % EVTRACE_NRECS];
+	ec->ec_count++;
+	r->er_time = gettime_nsecs();
+	r->er_type = type;
+	r->er_cpu = curcpu->c_number;
+	r->er_thread = (uint32_t)curthread;
+	r->er_arg0 = arg0;
+	r->er_arg1 = arg1;
+	splx(spl);
+}
+
+void
+evtrace_start(void)
+{
+	unsigned i;
+
+	evtrace_enabled = false;
+	for (i=0; i<evtrace_ncpus; i++) {
+		evtrace_cpus[i].ec_count = 0;
+	}
+	evtrace_enabled = true;
+}
+
+void
+evtrace_stop(void)
+{
+	evtrace_enabled = false;
+}
+
+/*
+ * Shell sort by time. Each ring is already in order (apart from where
+ * it wraps), so this doesn't have much to do.
+ */
+static
+void
+evtrace_sort(struct evtrace_rec *v, unsigned n)
+{
+	struct evtrace_rec t;
+	unsigned gap, i, j;
+
+	for (gap = 1; gap < n / 3; gap = gap * 3 + 1) {
+		/* nothing */
+	}
+	for (; gap > 0; gap /= 3) {
+		for (i=gap; i<n; i++) {
+			t = v[i];
+			for (j=i; j>=gap && v[j-gap].er_time > t.er_time;
+			     j -= gap) {
+				v[j] = v[j-gap];
+			}
+			v[j] = t;
+		}
+	}
+}
+
+static
+void
+evtrace_print(const struct evtrace_rec *r)
+{
+	static const char *const names[] = {
+		"?", "syscall", "sysret", "switch", "sleep", "wake",
+		"wakeall", "fault",
+	};
+
+	kprintf("et %llu.%09llu cpu %u thread 0x%08x %s",
+		r->er_time / 1000000000, r->er_time % 1000000000,
+		r->er_cpu, r->er_thread,
+		r->er_type <= EV_FAULT ? names[r->er_type] : names[0]);
+
+	switch (r->er_type) {
+	    case EV_SYSCALL:
+		kprintf(" call %u pid %u\n", r->er_arg0, r->er_arg1);
+		break;
+	    case EV_SYSRET:
+		kprintf(" call %u err %u\n", r->er_arg0, r->er_arg1);
+		break;
+	    case EV_SWITCH:
+		kprintf(" to 0x%08x state %u\n", r->er_arg0, r->er_arg1);
+		break;
+	    case EV_SLEEP:
+	    case EV_WAKEALL:
+		kprintf(" wchan 0x%08x\n", r->er_arg0);
+		break;
+	    case EV_WAKE:
+		kprintf(" wchan 0x%08x thread 0x%08x\n",
+			r->er_arg0, r->er_arg1);
+		break;
+	    case EV_FAULT:
+		kprintf(" addr 0x%08x type %u\n", r->er_arg0, r->er_arg1);
+		break;
+	    default:
+		kprintf(" 0x%08x 0x%08x\n", r->er_arg0, r->er_arg1);
+		break;
+	}
+}
+
+static
+int
+evtrace_write(char *path, struct evtrace_rec *recs, unsigned n)
+{
+	struct evtrace_header eh;
+	struct vnode *vn;
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	eh.eh_magic = EVTRACE_MAGIC;
+	eh.eh_version = EVTRACE_VERSION;
+	eh.eh_recsize = sizeof(struct evtrace_rec);
+	eh.eh_nrecs = n;
+
+	result = vfs_open(path, O_WRONLY|O_CREAT|O_TRUNC, 0664, &vn);
+	if (result) {
+		return result;
+	}
+	uio_kinit(&iov, &ku, &eh, sizeof(eh), 0, UIO_WRITE);
+	result = VOP_WRITE(vn, &ku);
+	if (result == 0) {
+		uio_kinit(&iov, &ku, recs, n * sizeof(*recs), sizeof(eh),
+			  UIO_WRITE);
+		result = VOP_WRITE(vn, &ku);
+	}
+	if (result == 0 && ku.uio_resid != 0) {
+		result = ENOSPC;
+	}
+	vfs_close(vn);
+	return result;
+}
+
+/*
+ * Copy the rings out first: kprintf and the file system can sleep,
+ * and while recording is on, the rings keep moving.
+ */
+int
+evtrace_dump(char *path)
+{
+	struct evtrace_cpu *ec;
+	struct evtrace_rec *all;
+	unsigned i, n, num, lost;
+	int result = 0;
+
+	if (evtrace_ncpus == 0 || evtrace_cpus[0].ec_recs == NULL) {
+		kprintf("evtrace: not set up\n");
+		return ENXIO;
+	}
+	all = kmalloc(evtrace_ncpus * EVTRACE_NRECS *
+		      sizeof(struct evtrace_rec));
+	if (all == NULL) {
+		return ENOMEM;
+	}
+
+	n = 0;
+	lost = 0;
+	for (i=0; i<evtrace_ncpus; i++) {
+		ec = &evtrace_cpus[i];
+		num = ec->ec_count;
+		if (num > EVTRACE_NRECS) {
+			lost += num - EVTRACE_NRECS;
+			num = EVTRACE_NRECS;
+		}
+		memcpy(all + n, ec->ec_recs, num * sizeof(struct evtrace_rec));
+		n += num;
+	}
+	evtrace_sort(all, n);
+
+	if (path != NULL) {
+		result = evtrace_write(path, all, n);
+	}
+	else {
+		for (i=0; i<n; i++) {
+			evtrace_print(&all[i]);
+		}
+	}
+	kprintf("evtrace: %s, %u events", evtrace_enabled ? "on" : "off", n);
+	if (lost > 0) {
+		kprintf(" (%u older ones overwritten)", lost);
+	}
+	kprintf("\n");
+	kfree(all);
+	return result;
+}
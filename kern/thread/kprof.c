@@ -0,0 +1,161 @@
+/*
+ * Sampling kernel profiler. See kprof.h.
+ *
+ * Each cpu has a ring of KPROF_NSAMPLES words, allocated the first
+ * time profiling is started. A sample is the interrupted PC with the
+ * low bit set if it was in user mode; PCs are always word-aligned, so
+ * the bit is free.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <cpu.h>
+#include <current.h>
+#include <clock.h>
+#include <platform/maxcpus.h>
+#include <kprof.h>
+
+#define KPROF_USER 0x1
+
+struct kprof_cpu {
+	uint32_t *kc_samples;		/* the ring, or NULL */
+	unsigned kc_count;		/* samples taken since start */
+};
+
+static struct kprof_cpu kprof_cpus[MAXCPUS];
+static unsigned kprof_ncpus;
+
+volatile bool kprof_enabled = false;
+
+void
+kprof_cpuinit(struct cpu *c)
+{
+	KASSERT(c->c_number < MAXCPUS);
+	if (c->c_number >= kprof_ncpus) {
+		kprof_ncpus = c->c_number + 1;
+	}
+}
+
+/*
+ * Called with interrupts off, and only ever touches this cpu's ring,
+ * so no other cpu can be writing it.
+ */
+void
+kprof_sample(vaddr_t pc, bool user)
+{
+	struct kprof_cpu *kc;
+
+	kc = &kprof_cpus[curcpu->c_number];
+	if (kc->kc_samples == NULL) {
+		return;
+	}
+	kc->kc_samples[kc->kc_count % KPROF_NSAMPLES] =
+		(pc & ~(vaddr_t)KPROF_USER) | (user ? KPROF_USER : 0);
+	kc->kc_count++;
+}
+
+int
+kprof_start(void)
+{
+	struct kprof_cpu *kc;
+	unsigned i;
+
+	kprof_enabled = false;
+	for (i=0; i<kprof_ncpus; i++) {
+		kc = &kprof_cpus[i];
+		if (kc->kc_samples == NULL) {
+			kc->kc_samples =
+				kmalloc(KPROF_NSAMPLES * sizeof(uint32_t));
+			if (kc->kc_samples == NULL) {
+				return ENOMEM;
+			}
+		}
+		kc->kc_count = 0;
+	}
+	kprof_enabled = true;
+	return 0;
+}
+
+void
+kprof_stop(void)
+{
+	kprof_enabled = false;
+}
+
+/*
+ * Shell sort; there are at most a few tens of thousands of samples,
+ * and this only runs when someone asks for the profile.
+ */
+static
+void
+kprof_sort(uint32_t *v, unsigned n)
+{
+	unsigned gap, i, j;
+	uint32_t t;
+
+	for (gap = 1; gap < n / 3; gap = gap * 3 + 1) {
+		/* nothing */
+	}
+	for (; gap > 0; gap /= 3) {
+		for (i=gap; i<n; i++) {
+			t = v[i];
+			for (j=i; j>=gap && v[j-gap] > t; j -= gap) {
+				v[j] = v[j-gap];
+			}
+			v[j] = t;
+		}
+	}
+}
+
+/*
+ * Copy the rings out before printing, since kprintf can sleep and the
+ * rings keep filling if we're still running.
+ */
+void
+kprof_print(void)
+{
+	struct kprof_cpu *kc;
+	uint32_t *all;
+	unsigned i, n, num, run, lost;
+
+	if (kprof_ncpus == 0 || kprof_cpus[0].kc_samples == NULL) {
+		kprintf("kprof: never started\n");
+		return;
+	}
+	all = kmalloc(kprof_ncpus * KPROF_NSAMPLES * sizeof(uint32_t));
+	if (all == NULL) {
+		kprintf("kprof: out of memory\n");
+		return;
+	}
+
+	kprintf("kprof: %s, %u samples per second per cpu\n",
+		kprof_enabled ? "running" : "stopped", HZ);
+	n = 0;
+	lost = 0;
+	for (i=0; i<kprof_ncpus; i++) {
+		kc = &kprof_cpus[i];
+		num = kc->kc_count;
+		kprintf("kprof cpu %u samples %u\n", i, num);
+		if (num > KPROF_NSAMPLES) {
+			lost += num - KPROF_NSAMPLES;
+			num = KPROF_NSAMPLES;
+		}
+		memcpy(all + n, kc->kc_samples, num * sizeof(uint32_t));
+		n += num;
+	}
+	if (lost > 0) {
+		kprintf("kprof: %u oldest samples overwritten\n", lost);
+	}
+
+	kprof_sort(all, n);
+	for (i=0; i<n; i += run) {
+		for (run=1; i+run<n && all[i+run] == all[i]; run++) {
+			/* nothing */
+		}
+		kprintf("kprof pc 0x%08x %c %u\n",
+			all[i] & ~(uint32_t)KPROF_USER,
+			(all[i] & KPROF_USER) ? 'u' : 'k', run);
+	}
+	kfree(all);
+}
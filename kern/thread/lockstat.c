@@ -0,0 +1,435 @@
+/*
+ * Lock profiling. See lockstat.h for what gets recorded.
+ *
+ * The table of entries only ever grows, so it can be searched without
+ * a lock; a slot is published by setting ls_inuse after the rest of
+ * it is filled in. Adding an entry takes a bare test-and-set word
+ * rather than a struct spinlock, since spinlock_acquire() reports into
+ * here and a real spinlock would recurse.
+ *
+ * The counters are per-cpu, so recording an acquisition or release
+ * takes no lock at all and every cpu writes only its own memory. They
+ * are allocated by the first lockstat_reset(), for the cpus there
+ * are, rather than taking MAXCPUS copies of the table at boot.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <platform/maxcpus.h>
+#include <lockstat.h>
+
+/* Number of entries; one slot is reserved for overflow. */
+#define LOCKSTAT_NENTRIES 256
+#define LOCKSTAT_OVERFLOW (LOCKSTAT_NENTRIES - 1)
+
+static struct lockstat_entry lockstat_table[LOCKSTAT_NENTRIES];
+static volatile spinlock_data_t lockstat_word = SPINLOCK_DATA_INITIALIZER;
+
+/* Counters for each entry, at LS_* offsets from LS_NCOUNTERS * slot. */
+#define LS_ACQUIRES	0
+#define LS_CONTENDED	1
+#define LS_WAIT		2	/* total */
+#define LS_WMAX		3	/* largest */
+#define LS_HOLD		4	/* total */
+#define LS_HMAX		5	/* largest */
+#define LS_NCOUNTERS	6
+#define LS_PERCPU	(LOCKSTAT_NENTRIES * LS_NCOUNTERS)
+
+/* Each cpu's counters, LS_PERCPU of them, or NULL if none yet. */
+static uint64_t *lockstat_percpu[MAXCPUS];
+
+/* Keep the compiler from moving stores across a slot's publication. */
+#define LS_BARRIER() __asm volatile("" ::: "memory")
+
+volatile bool lockstat_enabled = false;
+
+static const char *const lockstat_kindnames[] = {
+	"lock",
+	"sem",
+	"cv",
+	"spin",
+};
+
+/*
+ * Take and drop the lock for adding entries. Interrupts are turned
+ * off so an interrupt handler on this cpu can't deadlock against us;
+ * this uses splraise/spllower like spinlock_acquire so it works before
+ * curcpu exists, since semaphores get created that early.
+ */
+static
+void
+lockstat_lock(void)
+{
+	splraise(IPL_NONE, IPL_HIGH);
+	while (spinlock_data_get(&lockstat_word) != 0 ||
+	       spinlock_data_testandset(&lockstat_word) != 0) {
+		/* spin */
+	}
+}
+
+static
+void
+lockstat_unlock(void)
+{
+	spinlock_data_set(&lockstat_word, 0);
+	spllower(IPL_HIGH, IPL_NONE);
+}
+
+/*
+ * Names are kept truncated to LOCKSTAT_NAMELEN-1 characters; compare
+ * them the same way.
+ */
+static
+void
+lockstat_setname(char *buf, const char *name)
+{
+	unsigned i;
+
+	for (i=0; i<LOCKSTAT_NAMELEN-1 && name[i] != 0; i++) {
+		buf[i] = name[i];
+	}
+	buf[i] = 0;
+}
+
+static
+bool
+lockstat_samename(const char *buf, const char *name)
+{
+	unsigned i;
+
+	for (i=0; i<LOCKSTAT_NAMELEN-1; i++) {
+		if (buf[i] != name[i]) {
+			return false;
+		}
+		if (buf[i] == 0) {
+			return true;
+		}
+	}
+	return true;
+}
+
+/*
+ * Hash a name or a PC into the table; djb2, as good as any.
+ */
+static
+unsigned
+lockstat_hash(const char *name, vaddr_t pc)
+{
+	unsigned h = 5381;
+	unsigned i;
+
+	if (name != NULL) {
+		for (i=0; i<LOCKSTAT_NAMELEN-1 && name[i] != 0; i++) {
+			h = h * 33 + (unsigned char)name[i];
+		}
+	}
+	return (h ^ (pc >> 2)) % LOCKSTAT_OVERFLOW;
+}
+
+static
+bool
+lockstat_matches(struct lockstat_entry *ent, const char *name, vaddr_t pc,
+		 unsigned kind)
+{
+	return ent->ls_kind == kind && ent->ls_pc == pc &&
+		(name == NULL || lockstat_samename(ent->ls_name, name));
+}
+
+/*
+ * Open-addressed search, without the lock. Returns the entry, or NULL
+ * with *SLOTP set to the first free slot if it isn't there (or the
+ * overflow slot if the table is full).
+ */
+static
+struct lockstat_entry *
+lockstat_search(const char *name, vaddr_t pc, unsigned kind, unsigned *slotp)
+{
+	struct lockstat_entry *ent;
+	unsigned i, slot;
+
+	slot = lockstat_hash(name, pc);
+	for (i=0; i<LOCKSTAT_OVERFLOW; i++) {
+		ent = &lockstat_table[slot];
+		if (!ent->ls_inuse) {
+			*slotp = slot;
+			return NULL;
+		}
+		LS_BARRIER();
+		if (lockstat_matches(ent, name, pc, kind)) {
+			return ent;
+		}
+		slot = (slot + 1) % LOCKSTAT_OVERFLOW;
+	}
+	*slotp = LOCKSTAT_OVERFLOW;
+	return NULL;
+}
+
+/*
+ * Find the entry, adding it if missing. Only adding takes the lock;
+ * the search is repeated under it in case another cpu got there first.
+ */
+static
+struct lockstat_entry *
+lockstat_find(const char *name, vaddr_t pc, unsigned kind)
+{
+	struct lockstat_entry *ent;
+	unsigned slot;
+
+	ent = lockstat_search(name, pc, kind, &slot);
+	if (ent != NULL) {
+		return ent;
+	}
+
+	lockstat_lock();
+	ent = lockstat_search(name, pc, kind, &slot);
+	if (ent == NULL) {
+		ent = &lockstat_table[slot];
+		if (!ent->ls_inuse) {
+			ent->ls_kind = kind;
+			ent->ls_pc = pc;
+			if (slot == LOCKSTAT_OVERFLOW) {
+				strcpy(ent->ls_name, "(overflow)");
+			}
+			else if (name != NULL) {
+				lockstat_setname(ent->ls_name, name);
+			}
+			else {
+				snprintf(ent->ls_name, sizeof(ent->ls_name),
+					 "0x%08x", (unsigned)pc);
+			}
+			LS_BARRIER();
+			ent->ls_inuse = true;
+		}
+	}
+	lockstat_unlock();
+	return ent;
+}
+
+struct lockstat_entry *
+lockstat_lookup(const char *name, unsigned kind)
+{
+	KASSERT(name != NULL);
+	return lockstat_find(name, 0, kind);
+}
+
+struct lockstat_entry *
+lockstat_spinsite(vaddr_t pc)
+{
+	return lockstat_find(NULL, pc, LOCKSTAT_SPIN);
+}
+
+/*
+ * This cpu's counters for ENT, or NULL if it has none. Call with
+ * interrupts off, so as to stay on the cpu.
+ */
+static
+uint64_t *
+lockstat_mycounts(struct lockstat_entry *ent)
+{
+	uint64_t *counts;
+
+	counts = lockstat_percpu[curcpu->c_number];
+	if (counts == NULL) {
+		return NULL;
+	}
+	return counts + (unsigned)(ent - lockstat_table) * LS_NCOUNTERS;
+}
+
+uint64_t
+lockstat_now(void)
+{
+	if (!lockstat_enabled) {
+		return 0;
+	}
+	return gettime_nsecs();
+}
+
+void
+lockstat_acquired(struct lockstat_entry *ent, bool contended,
+		  uint64_t waitstart, uint64_t *stamp)
+{
+	uint64_t now, wait, *c;
+	int spl;
+
+	if (!lockstat_enabled || ent == NULL) {
+		if (stamp != NULL) {
+			*stamp = 0;
+		}
+		return;
+	}
+
+	now = gettime_nsecs();
+	wait = (contended && waitstart != 0 && now > waitstart) ?
+		now - waitstart : 0;
+
+	spl = splhigh();
+	c = lockstat_mycounts(ent);
+	if (c != NULL) {
+		c[LS_ACQUIRES]++;
+		if (contended) {
+			c[LS_CONTENDED]++;
+			c[LS_WAIT] += wait;
+			if (wait > c[LS_WMAX]) {
+				c[LS_WMAX] = wait;
+			}
+		}
+	}
+	splx(spl);
+
+	if (stamp != NULL) {
+		*stamp = now;
+	}
+}
+
+void
+lockstat_released(struct lockstat_entry *ent, uint64_t stamp)
+{
+	uint64_t now, held, *c;
+	int spl;
+
+	/* stamp is 0 if collection was off when this was acquired */
+	if (!lockstat_enabled || ent == NULL || stamp == 0) {
+		return;
+	}
+
+	now = gettime_nsecs();
+	if (now <= stamp) {
+		return;
+	}
+	held = now - stamp;
+
+	spl = splhigh();
+	c = lockstat_mycounts(ent);
+	if (c != NULL) {
+		c[LS_HOLD] += held;
+		if (held > c[LS_HMAX]) {
+			c[LS_HMAX] = held;
+		}
+	}
+	splx(spl);
+}
+
+/*
+ * Counters are cleared but slots are kept, because live locks point
+ * at them.
+ */
+int
+lockstat_reset(void)
+{
+	unsigned i, ncpus;
+
+	ncpus = thread_numcpus();
+	for (i=0; i<ncpus; i++) {
+		if (lockstat_percpu[i] == NULL) {
+			lockstat_percpu[i] =
+				kmalloc(LS_PERCPU * sizeof(uint64_t));
+			if (lockstat_percpu[i] == NULL) {
+				return ENOMEM;
+			}
+		}
+	}
+	for (i=0; i<ncpus; i++) {
+		bzero(lockstat_percpu[i], LS_PERCPU * sizeof(uint64_t));
+	}
+	lockstat_enabled = true;
+	return 0;
+}
+
+void
+lockstat_stop(void)
+{
+	lockstat_enabled = false;
+}
+
+/*
+ * Print in descending order of total wait time. The output is one
+ * line per entry so it can be grepped and diffed; times are in
+ * microseconds. The counters are summed over the cpus once, up front,
+ * and may move slightly while we do.
+ */
+void
+lockstat_print(void)
+{
+	struct lockstat_sums {
+		uint64_t s_count[LS_NCOUNTERS];
+		bool s_printed;
+	} *sums, *sp, *best;
+	struct lockstat_entry *ent;
+	uint64_t v, *counts;
+	unsigned i, c, cpu, bestidx;
+
+	sums = kmalloc(LOCKSTAT_NENTRIES * sizeof(*sums));
+	if (sums == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		return;
+	}
+	for (i=0; i<LOCKSTAT_NENTRIES; i++) {
+		sp = &sums[i];
+		ent = &lockstat_table[i];
+		for (c=0; c<LS_NCOUNTERS; c++) {
+			sp->s_count[c] = 0;
+		}
+		for (cpu=0; ent->ls_inuse && cpu<MAXCPUS; cpu++) {
+			counts = lockstat_percpu[cpu];
+			if (counts == NULL) {
+				continue;
+			}
+			counts += i * LS_NCOUNTERS;
+			for (c=0; c<LS_NCOUNTERS; c++) {
+				v = counts[c];
+				if (c == LS_WMAX || c == LS_HMAX) {
+					if (v > sp->s_count[c]) {
+						sp->s_count[c] = v;
+					}
+				}
+				else {
+					sp->s_count[c] += v;
+				}
+			}
+		}
+		sp->s_printed = sp->s_count[LS_ACQUIRES] == 0;
+	}
+
+	kprintf("lockstat: %s\n", lockstat_enabled ? "running" : "stopped");
+	kprintf("%-4s %-24s %10s %10s %12s %10s %12s %10s\n",
+		"kind", "name", "acquires", "contended",
+		"wait_us", "wmax_us", "hold_us", "hmax_us");
+
+	while (1) {
+		best = NULL;
+		bestidx = 0;
+		for (i=0; i<LOCKSTAT_NENTRIES; i++) {
+			sp = &sums[i];
+			if (sp->s_printed) {
+				continue;
+			}
+			if (best == NULL ||
+			    sp->s_count[LS_WAIT] > best->s_count[LS_WAIT]) {
+				best = sp;
+				bestidx = i;
+			}
+		}
+		if (best == NULL) {
+			break;
+		}
+		best->s_printed = true;
+		ent = &lockstat_table[bestidx];
+
+		kprintf("%-4s %-24s %10llu %10llu %12llu %10llu %12llu %10llu\n",
+			lockstat_kindnames[ent->ls_kind], ent->ls_name,
+			best->s_count[LS_ACQUIRES],
+			best->s_count[LS_CONTENDED],
+			best->s_count[LS_WAIT] / 1000,
+			best->s_count[LS_WMAX] / 1000,
+			best->s_count[LS_HOLD] / 1000,
+			best->s_count[LS_HMAX] / 1000);
+	}
+	kfree(sums);
+}
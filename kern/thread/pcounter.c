@@ -0,0 +1,86 @@
+/*
+ * Per-cpu statistics counters. See pcounter.h.
+ *
+ * A cpu only ever writes its own slots, and only with interrupts off
+ * so that it can't be preempted (or moved to another cpu) between
+ * finding its slots and updating them.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <current.h>
+#include <pcounter.h>
+
+static
+uint64_t *
+pcounter_slot(struct pcounter *pc, unsigned cpunum, unsigned index)
+{
+	return &pc->pc_slots[cpunum * pc->pc_stride + index];
+}
+
+void
+pcounter_add(struct pcounter *pc, unsigned index, uint64_t n)
+{
+	int spl;
+
+	KASSERT(index < pc->pc_num);
+	spl = splhigh();
+	*pcounter_slot(pc, curcpu->c_number, index) += n;
+	splx(spl);
+}
+
+void
+pcounter_max(struct pcounter *pc, unsigned index, uint64_t v)
+{
+	uint64_t *slot;
+	int spl;
+
+	KASSERT(index < pc->pc_num);
+	spl = splhigh();
+	slot = pcounter_slot(pc, curcpu->c_number, index);
+	if (v > *slot) {
+		*slot = v;
+	}
+	splx(spl);
+}
+
+/*
+ * Cpus that never came up have all-zero slots, so there's no need to
+ * know how many there are.
+ */
+uint64_t
+pcounter_read(struct pcounter *pc, unsigned index)
+{
+	uint64_t sum = 0;
+	unsigned i;
+
+	KASSERT(index < pc->pc_num);
+	for (i=0; i<MAXCPUS; i++) {
+		sum += *pcounter_slot(pc, i, index);
+	}
+	return sum;
+}
+
+uint64_t
+pcounter_readmax(struct pcounter *pc, unsigned index)
+{
+	uint64_t max = 0, v;
+	unsigned i;
+
+	KASSERT(index < pc->pc_num);
+	for (i=0; i<MAXCPUS; i++) {
+		v = *pcounter_slot(pc, i, index);
+		if (v > max) {
+			max = v;
+		}
+	}
+	return max;
+}
+
+void
+pcounter_reset(struct pcounter *pc)
+{
+	bzero(pc->pc_slots, MAXCPUS * pc->pc_stride * sizeof(uint64_t));
+}
@@ -36,6 +36,7 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <current.h>	/* for curcpu */
+#include <lockstat.h>
 
 /*
  * Spinlocks.
@@ -50,6 +51,26 @@ spinlock_init(struct spinlock *lk)
 {
 	spinlock_data_set(&lk->lk_lock, 0);
 	lk->lk_holder = NULL;
+#if OPT_LOCKSTAT
+	lk->lk_stat = NULL;
+	lk->lk_named = false;
+	lk->lk_stamp = 0;
+#endif
+}
+
+/*
+ * Count the lock under NAME in lockstat.
+ */
+void
+spinlock_setname(struct spinlock *lk, const char *name)
+{
+#if OPT_LOCKSTAT
+	lk->lk_stat = lockstat_lookup(name, LOCKSTAT_SPIN);
+	lk->lk_named = true;
+#else
+	(void)lk;
+	(void)name;
+#endif
 }
 
 /*
@@ -73,6 +94,11 @@ void
 spinlock_acquire(struct spinlock *lk)
 {
 	struct cpu *mycpu;
+#if OPT_LOCKSTAT
+	bool contended = false;
+	uint64_t waitstart = 0;
+	vaddr_t pc;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -99,6 +125,12 @@ spinlock_acquire(struct spinlock *lk)
 		 * we don't.
 		 */
 		if (spinlock_data_get(&lk->lk_lock) != 0) {
+#if OPT_LOCKSTAT
+			if (!contended && mycpu != NULL) {
+				contended = true;
+				waitstart = lockstat_now();
+			}
+#endif
 			continue;
 		}
 		if (spinlock_data_testandset(&lk->lk_lock) != 0) {
@@ -108,6 +140,25 @@ spinlock_acquire(struct spinlock *lk)
 	}
 
 	lk->lk_holder = mycpu;
+
+#if OPT_LOCKSTAT
+	/*
+	 * Unless the lock has a name, charge the call site. Usually
+	 * the same site reacquires, so keep the last one around.
+	 */
+	if (lockstat_enabled && mycpu != NULL) {
+		pc = (vaddr_t)__builtin_return_address(0);
+		if (!lk->lk_named &&
+		    (lk->lk_stat == NULL || lk->lk_stat->ls_pc != pc)) {
+			lk->lk_stat = lockstat_spinsite(pc);
+		}
+		lockstat_acquired(lk->lk_stat, contended, waitstart,
+				  &lk->lk_stamp);
+	}
+	else {
+		lk->lk_stamp = 0;
+	}
+#endif
 }
 
 /*
@@ -121,6 +172,13 @@ spinlock_release(struct spinlock *lk)
 		KASSERT(lk->lk_holder == curcpu->c_self);
 	}
 
+#if OPT_LOCKSTAT
+	if (lk->lk_stamp != 0) {
+		lockstat_released(lk->lk_stat, lk->lk_stamp);
+		lk->lk_stamp = 0;
+	}
+#endif
+
 	lk->lk_holder = NULL;
 	spinlock_data_set(&lk->lk_lock, 0);
 	spllower(IPL_HIGH, IPL_NONE);
@@ -39,6 +39,7 @@
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <lockstat.h>
 
 ////////////////////////////////////////////////////////////
 //
@@ -70,7 +71,11 @@ sem_create(const char *name, int initial_count)
     }
 
     spinlock_init(&sem->sem_lock);
+    spinlock_setname(&sem->sem_lock, sem->sem_name);
         sem->sem_count = initial_count;
+#if OPT_LOCKSTAT
+        sem->sem_stat = lockstat_lookup(name, LOCKSTAT_SEM);
+#endif
 
         return sem;
 }
@@ -90,6 +95,11 @@ sem_destroy(struct semaphore *sem)
 void 
 P(struct semaphore *sem)
 {
+#if OPT_LOCKSTAT
+        bool contended = false;
+        uint64_t waitstart = 0;
+#endif
+
         KASSERT(sem != NULL);
 
         /*
@@ -118,6 +128,12 @@ P(struct semaphore *sem)
          * Exercise: how would you implement strict FIFO
          * ordering?
          */
+#if OPT_LOCKSTAT
+        if (!contended) {
+                contended = true;
+                waitstart = lockstat_now();
+        }
+#endif
         wchan_lock(sem->sem_wchan);
         spinlock_release(&sem->sem_lock);
         wchan_sleep(sem->sem_wchan);
@@ -127,6 +143,9 @@ P(struct semaphore *sem)
         KASSERT(sem->sem_count > 0);
         sem->sem_count--;
     spinlock_release(&sem->sem_lock);
+#if OPT_LOCKSTAT
+        lockstat_acquired(sem->sem_stat, contended, waitstart, NULL);
+#endif
 }
 
 void
@@ -172,8 +191,13 @@ lock_create(const char *name)
                 return NULL;
         }
         spinlock_init(&lock->lk_splk);
+        spinlock_setname(&lock->lk_splk, lock->lk_name);
         lock->lk_thread=NULL; // Thread that holding this lock
         lock->lk_state=false;     //state now
+#if OPT_LOCKSTAT
+        lock->lk_stat = lockstat_lookup(name, LOCKSTAT_LOCK);
+        lock->lk_stamp = 0;
+#endif
         //A1 end
         return lock;
 }
@@ -193,12 +217,23 @@ lock_destroy(struct lock *lock)
 void
 lock_acquire(struct lock *lock)
 {
+#if OPT_LOCKSTAT
+        bool contended = false;
+        uint64_t waitstart = 0;
+#endif
+
         // Write this
         KASSERT(lock != NULL);
         //KASSERT(curthread->t_in_interrupt == false);
 
         spinlock_acquire(&lock->lk_splk);
         while (lock->lk_state){
+#if OPT_LOCKSTAT
+            if (!contended) {
+                contended = true;
+                waitstart = lockstat_now();
+            }
+#endif
             wchan_lock(lock->lk_wchan);
             spinlock_release(&lock->lk_splk);
             wchan_sleep(lock->lk_wchan);
@@ -206,6 +241,10 @@ lock_acquire(struct lock *lock)
         }
         lock->lk_state = true;
         lock->lk_thread = curthread;
+#if OPT_LOCKSTAT
+        lockstat_acquired(lock->lk_stat, contended, waitstart,
+                          &lock->lk_stamp);
+#endif
         spinlock_release(&lock->lk_splk);
         //(void)lock;  // suppress warning until code gets written
         
@@ -218,6 +257,10 @@ lock_release(struct lock *lock)
         // Write this
         KASSERT(lock != NULL);
         spinlock_acquire(&lock->lk_splk);
+#if OPT_LOCKSTAT
+        lockstat_released(lock->lk_stat, lock->lk_stamp);
+        lock->lk_stamp = 0;
+#endif
         lock->lk_state = false;
         lock->lk_thread = NULL;
         wchan_wakeone(lock->lk_wchan);
@@ -270,6 +313,9 @@ cv_create(const char *name)
             kfree(cv);
             return NULL;
         }
+#if OPT_LOCKSTAT
+        cv->cv_stat = lockstat_lookup(name, LOCKSTAT_CV);
+#endif
         return cv;
 }
 
@@ -287,12 +333,23 @@ cv_destroy(struct cv *cv)
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
+#if OPT_LOCKSTAT
+    uint64_t waitstart;
+#endif
+
         // Write this
     KASSERT(cv != NULL);
     KASSERT(lock != NULL);
+#if OPT_LOCKSTAT
+    waitstart = lockstat_now();
+#endif
     wchan_lock(cv->cv_wchan);
     lock_release(lock);
     wchan_sleep(cv->cv_wchan);
+#if OPT_LOCKSTAT
+    /* every wait sleeps, so count it as contended */
+    lockstat_acquired(cv->cv_stat, true, waitstart, NULL);
+#endif
     lock_acquire(lock);
         //(void)cv;    // suppress warning until code gets written
         //(void)lock;  // suppress warning until code gets written
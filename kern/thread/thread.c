@@ -50,8 +50,17 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <evtrace.h>
+#include <callout.h>
+#include <workqueue.h>
+#include <platform/maxcpus.h>
+#include <clock.h>
 
 #include "opt-synchprobs.h"
+#include "opt-kprof.h"
+#if OPT_KPROF
+#include <kprof.h>
+#endif
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -72,6 +81,8 @@ static struct cpuarray allcpus;
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
+static void exorcise(void *unused);
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -111,6 +122,170 @@ thread_checkstack(struct thread *thread)
 	}
 }
 
+/*
+ * Per-cpu caches of kernel stacks and thread structures.
+ *
+ * thread_destroy puts what it would have freed in the current cpu's
+ * cache, and thread_create and thread_fork take from there before
+ * going to kmalloc. A cached stack keeps its guard band, so it isn't
+ * set up again; a cached thread keeps its t_sleepwc. The caches are
+ * small, and thread_trimcaches() empties them all when the VM system
+ * runs out of pages.
+ *
+ * Each cache is normally only used by its own cpu, but has a spinlock
+ * so the trimming can be done from any cpu, and so it doesn't matter
+ * if we move to another cpu between picking a cache and using it.
+ */
+#define THREADCACHE_STACKS	4
+#define THREADCACHE_THREADS	8
+
+struct threadcache {
+	struct spinlock tc_lock;
+	unsigned tc_nstacks;
+	unsigned tc_nthreads;
+	void *tc_stacks[THREADCACHE_STACKS];
+	struct thread *tc_threads[THREADCACHE_THREADS];
+};
+
+static struct threadcache threadcaches[MAXCPUS];
+
+/* Set once curcpu works; the boot cpu's first thread comes before. */
+static bool threadcache_ready;
+
+static
+void *
+threadcache_getstack(void)
+{
+	struct threadcache *tc;
+	void *stack = NULL;
+
+	if (!threadcache_ready) {
+		return NULL;
+	}
+	tc = &threadcaches[curcpu->c_number];
+	spinlock_acquire(&tc->tc_lock);
+	if (tc->tc_nstacks > 0) {
+		stack = tc->tc_stacks[--tc->tc_nstacks];
+	}
+	spinlock_release(&tc->tc_lock);
+	return stack;
+}
+
+/* Returns false if the cache is full. */
+static
+bool
+threadcache_putstack(void *stack)
+{
+	struct threadcache *tc;
+	bool done = false;
+
+	if (!threadcache_ready) {
+		return false;
+	}
+	tc = &threadcaches[curcpu->c_number];
+	spinlock_acquire(&tc->tc_lock);
+	if (tc->tc_nstacks < THREADCACHE_STACKS) {
+		tc->tc_stacks[tc->tc_nstacks++] = stack;
+		done = true;
+	}
+	spinlock_release(&tc->tc_lock);
+	return done;
+}
+
+static
+struct thread *
+threadcache_getthread(void)
+{
+	struct threadcache *tc;
+	struct thread *thread = NULL;
+
+	if (!threadcache_ready) {
+		return NULL;
+	}
+	tc = &threadcaches[curcpu->c_number];
+	spinlock_acquire(&tc->tc_lock);
+	if (tc->tc_nthreads > 0) {
+		thread = tc->tc_threads[--tc->tc_nthreads];
+	}
+	spinlock_release(&tc->tc_lock);
+	return thread;
+}
+
+/* Returns false if the cache is full. */
+static
+bool
+threadcache_putthread(struct thread *thread)
+{
+	struct threadcache *tc;
+	bool done = false;
+
+	if (!threadcache_ready) {
+		return false;
+	}
+	tc = &threadcaches[curcpu->c_number];
+	spinlock_acquire(&tc->tc_lock);
+	if (tc->tc_nthreads < THREADCACHE_THREADS) {
+		tc->tc_threads[tc->tc_nthreads++] = thread;
+		done = true;
+	}
+	spinlock_release(&tc->tc_lock);
+	return done;
+}
+
+/*
+ * Free everything in every cpu's cache. Take things out one at a time
+ * and free them without the lock, since freeing may need other locks.
+ */
+void
+thread_trimcaches(void)
+{
+	struct threadcache *tc;
+	struct thread *thread;
+	void *stack;
+	unsigned i;
+
+	if (!threadcache_ready) {
+		return;
+	}
+	for (i=0; i<MAXCPUS; i++) {
+		tc = &threadcaches[i];
+		while (1) {
+			spinlock_acquire(&tc->tc_lock);
+			stack = tc->tc_nstacks > 0 ?
+				tc->tc_stacks[--tc->tc_nstacks] : NULL;
+			thread = tc->tc_nthreads > 0 ?
+				tc->tc_threads[--tc->tc_nthreads] : NULL;
+			spinlock_release(&tc->tc_lock);
+			if (stack == NULL && thread == NULL) {
+				break;
+			}
+			kfree(stack);
+			if (thread != NULL) {
+				if (thread->t_sleepwc != NULL) {
+					wchan_destroy(thread->t_sleepwc);
+				}
+				kfree(thread);
+			}
+		}
+	}
+}
+
+/*
+ * Give back a thread structure, keeping its t_sleepwc if it's cached.
+ */
+static
+void
+thread_free(struct thread *thread)
+{
+	if (threadcache_putthread(thread)) {
+		return;
+	}
+	if (thread->t_sleepwc != NULL) {
+		wchan_destroy(thread->t_sleepwc);
+	}
+	kfree(thread);
+}
+
 /*
  * Create a thread. This is used both to create a first thread
  * for each CPU and to create subsequent forked threads.
@@ -120,17 +295,26 @@ struct thread *
 thread_create(const char *name)
 {
 	struct thread *thread;
+	struct wchan *sleepwc;
 
 	DEBUGASSERT(name != NULL);
 
-	thread = kmalloc(sizeof(*thread));
-	if (thread == NULL) {
-		return NULL;
+	thread = threadcache_getthread();
+	if (thread != NULL) {
+		sleepwc = thread->t_sleepwc;
+	}
+	else {
+		thread = kmalloc(sizeof(*thread));
+		if (thread == NULL) {
+			return NULL;
+		}
+		sleepwc = NULL;
 	}
 
 	thread->t_name = kstrdup(name);
 	if (thread->t_name == NULL) {
-		kfree(thread);
+		thread->t_sleepwc = sleepwc;
+		thread_free(thread);
 		return NULL;
 	}
 	thread->t_wchan_name = "NEW";
@@ -142,6 +326,7 @@ thread_create(const char *name)
 	thread->t_stack = NULL;
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
+	thread->t_bound = false;
 	thread->t_proc = NULL;
 
 	/* Interrupt state fields */
@@ -149,6 +334,9 @@ thread_create(const char *name)
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
 
+	bzero(&thread->t_usage, sizeof(thread->t_usage));
+	thread->t_sleepwc = sleepwc;
+
 	/* If you add to struct thread, be sure to initialize here */
 
 	return thread;
@@ -179,7 +367,12 @@ cpu_create(unsigned hardware_number)
 
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
+	work_init(&c->c_reaper, exorcise, NULL);
 	c->c_hardclocks = 0;
+	c->c_idleticks = 0;
+	c->c_skippedticks = 0;
+	c->c_tickdefer = 0;
+	c->c_tickdeferat = 0;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -193,6 +386,14 @@ cpu_create(unsigned hardware_number)
 	if (result != 0) {
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
+	callout_cpuinit(c);
+	workqueue_cpuinit(c);
+#if OPT_KPROF
+	kprof_cpuinit(c);
+#endif
+#if OPT_EVTRACE
+	evtrace_cpuinit(c);
+#endif
 
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
@@ -250,7 +451,11 @@ thread_destroy(struct thread *thread)
 	/* Thread subsystem fields */
 	KASSERT(thread->t_proc == NULL);
 	if (thread->t_stack != NULL) {
-		kfree(thread->t_stack);
+		/* a cached stack has to have its guard band intact */
+		thread_checkstack(thread);
+		if (!threadcache_putstack(thread->t_stack)) {
+			kfree(thread->t_stack);
+		}
 	}
 	threadlistnode_cleanup(&thread->t_listnode);
 	thread_machdep_cleanup(&thread->t_machdep);
@@ -259,25 +464,50 @@ thread_destroy(struct thread *thread)
 	thread->t_wchan_name = "DESTROYED";
 
 	kfree(thread->t_name);
-	kfree(thread);
+	thread_free(thread);
 }
 
 /*
  * Clean up zombies. (Zombies are threads that have exited but still
  * need to have thread_destroy called on them.)
  *
- * The list of zombies is per-cpu.
+ * The list of zombies is per-cpu, and added to by thread_switch, so
+ * only look at it with interrupts off. This runs on the cpu's worker
+ * (see workqueue.h), which stays on the cpu, rather than at the end of
+ * every context switch, so whoever is switching to doesn't wait for
+ * it.
  */
 static
 void
-exorcise(void)
+exorcise(void *unused)
 {
 	struct thread *z;
+	int spl;
 
+	(void)unused;
+	KASSERT(curthread->t_bound);
+
+	spl = splhigh();
 	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
+		splx(spl);
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
 		thread_destroy(z);
+		spl = splhigh();
+	}
+	splx(spl);
+}
+
+/*
+ * Have the zombies cleaned up, if there are any. Called after each
+ * switch, once the thread that exited is off the cpu for good.
+ */
+static
+void
+exorcise_soon(void)
+{
+	if (!threadlist_isempty(&curcpu->c_zombies)) {
+		workqueue_queue(&curcpu->c_reaper);
 	}
 }
 
@@ -348,9 +578,16 @@ thread_bootstrap(void)
 {
 	struct cpu *bootcpu;
 	struct thread *bootthread;
+	unsigned i;
 
 	cpuarray_init(&allcpus);
 
+	for (i=0; i<MAXCPUS; i++) {
+		spinlock_init(&threadcaches[i].tc_lock);
+		threadcaches[i].tc_nstacks = 0;
+		threadcaches[i].tc_nthreads = 0;
+	}
+
 	/*
 	 * Create the cpu structure for the bootup CPU, the one we're
 	 * currently running on. Assume the hardware number is 0; that
@@ -376,6 +613,7 @@ thread_bootstrap(void)
 	 */
 	curthread->t_cpu = curcpu;
 	curcpu->c_curthread = curthread;
+	threadcache_ready = true;
 
 	/* cpu_create() should have set t_proc. */
 	KASSERT(curthread->t_proc != NULL);
@@ -471,14 +709,16 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
  * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
  *
  * The new thread is created in the process P. If P is null, the
- * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * process is inherited from the caller. It will start on cpu C, and
+ * if BOUND, never be migrated off it.
  */
+static
 int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+thread_fork_on(const char *name,
+	       struct proc *proc,
+	       struct cpu *c, bool bound,
+	       void (*entrypoint)(void *data1, unsigned long data2),
+	       void *data1, unsigned long data2)
 {
 	struct thread *newthread;
 	int result;
@@ -492,20 +732,24 @@ thread_fork(const char *name,
 		return ENOMEM;
 	}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
+	/* Allocate a stack, or reuse one that's already set up */
+	newthread->t_stack = threadcache_getstack();
 	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
+		newthread->t_stack = kmalloc(STACK_SIZE);
+		if (newthread->t_stack == NULL) {
+			thread_destroy(newthread);
+			return ENOMEM;
+		}
+		thread_checkstack_init(newthread);
 	}
-	thread_checkstack_init(newthread);
 
 	/*
 	 * Now we clone various fields from the parent thread.
 	 */
 
 	/* Thread subsystem fields */
-	newthread->t_cpu = curthread->t_cpu;
+	newthread->t_cpu = c;
+	newthread->t_bound = bound;
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -528,12 +772,36 @@ thread_fork(const char *name,
 	/* Set up the switchframe so entrypoint() gets called */
 	switchframe_init(newthread, entrypoint, data1, data2);
 
-	/* Lock the current cpu's run queue and make the new thread runnable */
+	/* Lock its cpu's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
 	return 0;
 }
 
+/*
+ * The new thread starts on the same CPU as the caller, unless the
+ * scheduler intervenes first.
+ */
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	return thread_fork_on(name, proc, curthread->t_cpu, false,
+			      entrypoint, data1, data2);
+}
+
+int
+thread_fork_bound(const char *name,
+		  struct proc *proc,
+		  struct cpu *c,
+		  void (*entrypoint)(void *data1, unsigned long data2),
+		  void *data1, unsigned long data2)
+{
+	return thread_fork_on(name, proc, c, true, entrypoint, data1, data2);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -627,6 +895,10 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 	 * Note that c_isidle becomes true briefly even if we don't go
 	 * idle. However, because one is supposed to hold the runqueue
 	 * lock to look at it, this should not be visible or matter.
+	 *
+	 * Before idling, hardclock_idle() puts off the next hardclock
+	 * until this cpu has a callout due; whatever interrupt wakes
+	 * us starts the clock again (see hardclock_resume).
 	 */
 
 	/* The current cpu is now idle. */
@@ -635,12 +907,24 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
+			hardclock_idle();
 			cpu_idle();
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
 
+	if (next != cur) {
+		if (newstate == S_SLEEP) {
+			cur->t_usage.tu_nvcsw++;
+		}
+		else if (newstate == S_READY) {
+			cur->t_usage.tu_nivcsw++;
+		}
+	}
+
+	EVTRACE(EV_SWITCH, next, newstate);
+
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
 	 * curthread and it may not be, depending on how curthread and
@@ -712,7 +996,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 	as_activate();
 
 	/* Clean up dead threads. */
-	exorcise();
+	exorcise_soon();
 
 	/* Turn interrupts back on. */
 	splx(spl);
@@ -745,7 +1029,7 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 	as_activate();
 
 	/* Clean up dead threads. */
-	exorcise();
+	exorcise_soon();
 
 	/* Enable interrupts. */
 	spl0();
@@ -819,6 +1103,81 @@ thread_yield(void)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Usage accounting.
+ */
+
+void
+thread_chargetick(bool user)
+{
+	if (curcpu->c_isidle) {
+		curcpu->c_idleticks++;
+	}
+	else if (user) {
+		curthread->t_usage.tu_uticks++;
+	}
+	else {
+		curthread->t_usage.tu_sticks++;
+	}
+}
+
+unsigned
+thread_numcpus(void)
+{
+	return cpuarray_num(&allcpus);
+}
+
+/*
+ * The counters are only written by their own cpus, so this just reads
+ * them; the totals may be a tick or so out.
+ */
+void
+thread_cputicks(unsigned *ncpus, uint64_t *ticks, uint64_t *idleticks)
+{
+	struct cpu *c;
+	unsigned i;
+
+	*ncpus = cpuarray_num(&allcpus);
+	*ticks = 0;
+	*idleticks = 0;
+	for (i=0; i<*ncpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		*ticks += c->c_hardclocks;
+		*idleticks += c->c_idleticks;
+	}
+}
+
+/*
+ * Print each cpu's tick counts, for the menu.
+ */
+void
+thread_printcputicks(void)
+{
+	struct cpu *c;
+	unsigned i;
+
+	kprintf("cpu   hardclocks       idle    skipped\n");
+	for (i=0; i<cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		kprintf("%3u %12u %10u %10u\n", c->c_number, c->c_hardclocks,
+			c->c_idleticks, c->c_skippedticks);
+	}
+}
+
+void
+threadusage_add(struct threadusage *to, const struct threadusage *from)
+{
+	to->tu_uticks += from->tu_uticks;
+	to->tu_sticks += from->tu_sticks;
+	to->tu_nvcsw += from->tu_nvcsw;
+	to->tu_nivcsw += from->tu_nivcsw;
+	to->tu_faults += from->tu_faults;
+	to->tu_rbytes += from->tu_rbytes;
+	to->tu_wbytes += from->tu_wbytes;
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Scheduler.
  *
@@ -915,9 +1274,10 @@ thread_consider_migration(void)
 			 * Why? And what?) so shuffle it to the end of
 			 * the list and decrement to_send in order to
 			 * skip it. Then it goes back on our own run
-			 * queue below.
+			 * queue below. Threads bound to this cpu are
+			 * skipped the same way.
 			 */
-			if (t == curthread) {
+			if (t == curthread || t->t_bound) {
 				threadlist_addtail(&victims, t);
 				to_send--;
 				continue;
@@ -981,6 +1341,7 @@ wchan_create(const char *name)
 		return NULL;
 	}
 	spinlock_init(&wc->wc_lock);
+	spinlock_setname(&wc->wc_lock, name);
 	threadlist_init(&wc->wc_threads);
 	wc->wc_name = name;
 	return wc;
@@ -1025,6 +1386,7 @@ wchan_sleep(struct wchan *wc)
 	/* may not sleep in an interrupt handler */
 	KASSERT(!curthread->t_in_interrupt);
 
+	EVTRACE(EV_SLEEP, wc, 0);
 	thread_switch(S_SLEEP, wc);
 }
 
@@ -1050,6 +1412,7 @@ wchan_wakeone(struct wchan *wc)
 		return;
 	}
 
+	EVTRACE(EV_WAKE, wc, target);
 	thread_make_runnable(target, false);
 }
 
@@ -1064,6 +1427,8 @@ wchan_wakeall(struct wchan *wc)
 
 	threadlist_init(&list);
 
+	EVTRACE(EV_WAKEALL, wc, 0);
+
 	/*
 	 * Lock the channel and grab all the threads, moving them to a
 	 * private list.
@@ -1143,23 +1508,101 @@ ipi_broadcast(int code)
 void
 ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 {
+	ipi_tlbshootdown_batch(target, mapping, 1);
+}
+
+/*
+ * Queue NUM shootdowns on TARGET with one interrupt. If a shootdown
+ * IPI is already pending there, the new entries join its queue and no
+ * further interrupt is sent. Returns the number of IPIs sent (0 or 1).
+ */
+unsigned
+ipi_tlbshootdown_batch(struct cpu *target, const struct tlbshootdown *mappings,
+		       unsigned num)
+{
+	unsigned i, sent;
 	int n;
 
 	spinlock_acquire(&target->c_ipi_lock);
 
-	n = target->c_numshootdown;
-	if (n == TLBSHOOTDOWN_MAX) {
-		target->c_numshootdown = TLBSHOOTDOWN_ALL;
-	}
-	else {
-		target->c_shootdown[n] = *mapping;
+	for (i=0; i<num; i++) {
+		n = target->c_numshootdown;
+		if (n == TLBSHOOTDOWN_ALL) {
+			break;
+		}
+		if (n == TLBSHOOTDOWN_MAX) {
+			target->c_numshootdown = TLBSHOOTDOWN_ALL;
+			break;
+		}
+		target->c_shootdown[n] = mappings[i];
 		target->c_numshootdown = n+1;
 	}
 
-	target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
-	mainbus_send_ipi(target);
+	sent = 0;
+	if ((target->c_ipi_pending & (1U << IPI_TLBSHOOTDOWN)) == 0) {
+		target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
+		mainbus_send_ipi(target);
+		sent = 1;
+	}
 
 	spinlock_release(&target->c_ipi_lock);
+	return sent;
+}
+
+/*
+ * Send a batch of shootdowns to every cpu in CPUMASK (bit N for cpu
+ * number N) except the current one. Call at splhigh, so "the current
+ * one" stays put while the caller handles its own TLB. Returns the
+ * number of IPIs sent.
+ */
+unsigned
+ipi_tlbshootdown_cpus(uint32_t cpumask, const struct tlbshootdown *mappings,
+		      unsigned num)
+{
+	unsigned i, sent;
+	struct cpu *c;
+
+	KASSERT(curthread->t_curspl > 0);
+
+	sent = 0;
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		KASSERT(c->c_number < 32);
+		if (c == curcpu->c_self ||
+		    (cpumask & ((uint32_t)1 << c->c_number)) == 0) {
+			continue;
+		}
+		sent += ipi_tlbshootdown_batch(c, mappings, num);
+	}
+	return sent;
+}
+
+/*
+ * Wait until no cpu in CPUMASK has a shootdown outstanding. This must
+ * be called with interrupts on: two cpus shooting at each other would
+ * otherwise wait forever.
+ */
+void
+ipi_tlbshootdown_wait(uint32_t cpumask)
+{
+	unsigned i;
+	struct cpu *c;
+	bool pending;
+
+	KASSERT(curthread->t_curspl == 0);
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if ((cpumask & ((uint32_t)1 << c->c_number)) == 0) {
+			continue;
+		}
+		do {
+			spinlock_acquire(&c->c_ipi_lock);
+			pending = (c->c_ipi_pending &
+				   (1U << IPI_TLBSHOOTDOWN)) != 0;
+			spinlock_release(&c->c_ipi_lock);
+		} while (pending);
+	}
 }
 
 void
@@ -0,0 +1,232 @@
+/*
+ * Work queues. See workqueue.h.
+ *
+ * Each cpu's queue is a FIFO list under a spinlock, so that work can
+ * be queued from interrupt handlers. The worker sleeps on wq_wchan
+ * when the queue is empty. wq_nqueued and wq_ndone count the work
+ * queued and finished, so a flush can tell when a queue has caught up
+ * without having to find its own place in it.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <platform/maxcpus.h>
+#include <workqueue.h>
+
+struct workqueue {
+	struct spinlock wq_lock;
+	struct work *wq_head;
+	struct work **wq_tailp;
+	unsigned wq_nqueued;		/* queued so far */
+	unsigned wq_ndone;		/* of those, finished */
+	struct wchan *wq_wchan;		/* worker waits here for work */
+	struct wchan *wq_flushwc;	/* flushes wait here for the worker */
+	struct cpu *wq_cpu;
+	struct thread *wq_thread;	/* the worker */
+};
+
+static struct workqueue *workqueues[MAXCPUS];
+static bool workqueue_running;
+
+void
+work_init(struct work *wk, void (*func)(void *), void *arg)
+{
+	wk->wk_next = NULL;
+	wk->wk_func = func;
+	wk->wk_arg = arg;
+	wk->wk_queued = false;
+	wk->wk_free = false;
+}
+
+void
+workqueue_cpuinit(struct cpu *c)
+{
+	struct workqueue *wq;
+
+	KASSERT(c->c_number < MAXCPUS);
+	wq = kmalloc(sizeof(*wq));
+	if (wq == NULL) {
+		panic("workqueue_cpuinit: Out of memory\n");
+	}
+	spinlock_init(&wq->wq_lock);
+	wq->wq_head = NULL;
+	wq->wq_tailp = &wq->wq_head;
+	wq->wq_nqueued = 0;
+	wq->wq_ndone = 0;
+	wq->wq_wchan = wchan_create("workqueue");
+	wq->wq_flushwc = wchan_create("workflush");
+	if (wq->wq_wchan == NULL || wq->wq_flushwc == NULL) {
+		panic("workqueue_cpuinit: Out of memory\n");
+	}
+	wq->wq_cpu = c;
+	wq->wq_thread = NULL;
+	workqueues[c->c_number] = wq;
+}
+
+/*
+ * WK's flag is only looked at under the lock of the queue it's being
+ * put on, so the same struct work mustn't be queued from two cpus at
+ * once; everything that queues one so far is serialized already.
+ */
+bool
+workqueue_queue(struct work *wk)
+{
+	struct workqueue *wq;
+	int spl;
+
+	/* stay on this cpu until we're on its queue */
+	spl = splhigh();
+	wq = workqueues[curcpu->c_number];
+	spinlock_acquire(&wq->wq_lock);
+	if (wk->wk_queued) {
+		spinlock_release(&wq->wq_lock);
+		splx(spl);
+		return false;
+	}
+	wk->wk_queued = true;
+	wk->wk_next = NULL;
+	*wq->wq_tailp = wk;
+	wq->wq_tailp = &wk->wk_next;
+	wq->wq_nqueued++;
+	spinlock_release(&wq->wq_lock);
+	splx(spl);
+
+	wchan_wakeone(wq->wq_wchan);
+	return true;
+}
+
+int
+workqueue_submit(void (*func)(void *), void *arg)
+{
+	struct work *wk;
+
+	wk = kmalloc(sizeof(*wk));
+	if (wk == NULL) {
+		return ENOMEM;
+	}
+	work_init(wk, func, arg);
+	wk->wk_free = true;
+	workqueue_queue(wk);
+	return 0;
+}
+
+/*
+ * The worker. Once a piece of work has started it may be queued again
+ * or freed, so don't touch the struct work after calling its function.
+ */
+static
+void
+workqueue_worker(void *data1, unsigned long data2)
+{
+	struct workqueue *wq = data1;
+	struct work *wk;
+	void (*func)(void *);
+	void *arg;
+	bool dofree, caughtup;
+
+	(void)data2;
+	KASSERT(curcpu->c_self == wq->wq_cpu);
+	wq->wq_thread = curthread;
+
+	while (1) {
+		spinlock_acquire(&wq->wq_lock);
+		while ((wk = wq->wq_head) == NULL) {
+			wchan_lock(wq->wq_wchan);
+			spinlock_release(&wq->wq_lock);
+			wchan_sleep(wq->wq_wchan);
+			spinlock_acquire(&wq->wq_lock);
+		}
+		wq->wq_head = wk->wk_next;
+		if (wq->wq_head == NULL) {
+			wq->wq_tailp = &wq->wq_head;
+		}
+		wk->wk_next = NULL;
+		wk->wk_queued = false;
+		func = wk->wk_func;
+		arg = wk->wk_arg;
+		dofree = wk->wk_free;
+		spinlock_release(&wq->wq_lock);
+
+		func(arg);
+		if (dofree) {
+			kfree(wk);
+		}
+
+		spinlock_acquire(&wq->wq_lock);
+		wq->wq_ndone++;
+		caughtup = wq->wq_ndone == wq->wq_nqueued;
+		spinlock_release(&wq->wq_lock);
+		if (caughtup) {
+			wchan_wakeall(wq->wq_flushwc);
+		}
+	}
+}
+
+/*
+ * Go round the queues until a pass finds them all empty, since work
+ * on one queue may queue more on another.
+ */
+void
+workqueue_flush(void)
+{
+	struct workqueue *wq;
+	unsigned i;
+	bool waited;
+
+	if (!workqueue_running) {
+		/* nothing would ever run it */
+		return;
+	}
+
+	do {
+		waited = false;
+		for (i=0; i<MAXCPUS; i++) {
+			wq = workqueues[i];
+			if (wq == NULL) {
+				continue;
+			}
+			spinlock_acquire(&wq->wq_lock);
+			while (wq->wq_ndone != wq->wq_nqueued) {
+				/* work can't wait for its own queue */
+				KASSERT(curthread != wq->wq_thread);
+				waited = true;
+				wchan_lock(wq->wq_flushwc);
+				spinlock_release(&wq->wq_lock);
+				wchan_sleep(wq->wq_flushwc);
+				spinlock_acquire(&wq->wq_lock);
+			}
+			spinlock_release(&wq->wq_lock);
+		}
+	} while (waited);
+}
+
+void
+workqueue_bootstrap(void)
+{
+	struct workqueue *wq;
+	char name[16];
+	unsigned i;
+	int result;
+
+	for (i=0; i<MAXCPUS; i++) {
+		wq = workqueues[i];
+		if (wq == NULL) {
+			continue;
+		}
+		snprintf(name, sizeof(name), "worker%u", i);
+		result = thread_fork_bound(name, NULL, wq->wq_cpu,
+					   workqueue_worker, wq, 0);
+		if (result) {
+			panic("workqueue_bootstrap: thread_fork_bound: %s\n",
+			      strerror(result));
+		}
+	}
+	workqueue_running = true;
+}
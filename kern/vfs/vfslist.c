@@ -43,6 +43,9 @@
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <clock.h>
+#include <callout.h>
+#include <workqueue.h>
 
 /*
  * Structure for a single named device.
@@ -92,6 +95,34 @@ static struct lock *vfs_biglock;
 static unsigned vfs_biglock_depth;
 
 
+/*
+ * Background sync. Every VFS_SYNC_SECS seconds a callout queues a
+ * vfs_sync() on the worker of whichever cpu it goes off on, so the
+ * metadata that filesystems keep dirty in memory (inodes, free maps,
+ * superblocks) gets written back without any process waiting for it.
+ */
+#define VFS_SYNC_SECS 30
+
+static struct callout vfs_synccallout;
+static struct work vfs_syncwork;
+
+static
+void
+vfs_syncer(void *unused)
+{
+	(void)unused;
+	vfs_sync();
+	callout_schedule(&vfs_synccallout, VFS_SYNC_SECS * HZ);
+}
+
+static
+void
+vfs_synctimer(void *unused)
+{
+	(void)unused;
+	workqueue_queue(&vfs_syncwork);
+}
+
 /*
  * Setup function
  */
@@ -110,6 +141,10 @@ vfs_bootstrap(void)
 	vfs_biglock_depth = 0;
 
 	devnull_create();
+
+	work_init(&vfs_syncwork, vfs_syncer, NULL);
+	callout_init(&vfs_synccallout, vfs_synctimer, NULL);
+	callout_schedule(&vfs_synccallout, VFS_SYNC_SECS * HZ);
 }
 
 /*
@@ -557,6 +592,9 @@ vfs_unmount(const char *devname)
 	struct knowndev *kd;
 	int result;
 
+	/* let queued reclaims finish, or the fs will look busy */
+	workqueue_flush();
+
 	vfs_biglock_acquire();
 
 	result = findmount(devname, &kd);
@@ -603,6 +641,9 @@ vfs_unmountall(void)
 	unsigned i, num;
 	int result;
 
+	/* let queued reclaims finish, or the filesystems will look busy */
+	workqueue_flush();
+
 	vfs_biglock_acquire();
 
 	num = knowndevarray_num(knowndevs);
@@ -38,6 +38,7 @@
 #include <lib.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <vm.h>
 
 
 /* Does most of the work for open(). */
@@ -101,6 +102,7 @@ vfs_open(char *path, int openflags, mode_t mode, struct vnode **ret)
 		}
 		else {
 			result = VOP_TRUNCATE(vn, 0);
+			vm_textinval(vn);
 		}
 		if (result) {
 			VOP_DECOPEN(vn);
@@ -36,6 +36,9 @@
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <workqueue.h>
+
+static void vnode_reclaim(void *vn);
 
 /*
  * Initialize an abstract vnode.
@@ -53,6 +56,7 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	vn->vn_opencount = 0;
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
+	work_init(&vn->vn_reclaim, vnode_reclaim, vn);
 	return 0;
 }
 
@@ -90,16 +94,36 @@ vnode_incref(struct vnode *vn)
 	vfs_biglock_release();
 }
 
+/*
+ * Reclaim a vnode whose refcount hit zero. Runs on a worker thread.
+ * If someone picked the vnode up again in the meantime, VOP_RECLAIM
+ * notices and returns EBUSY.
+ */
+static
+void
+vnode_reclaim(void *data)
+{
+	struct vnode *vn = data;
+	int result;
+
+	result = VOP_RECLAIM(vn);
+	if (result != 0 && result != EBUSY) {
+		// XXX: lame.
+		kprintf("vfs: Warning: VOP_RECLAIM: %s\n",
+			strerror(result));
+	}
+}
+
 /*
  * Decrement refcount.
  * Called by VOP_DECREF.
- * Calls VOP_RECLAIM if the refcount hits zero.
+ * Queues VOP_RECLAIM if the refcount hits zero, so that the caller
+ * (often close() or exit) doesn't wait for the inode to be written
+ * back or the file to be erased.
  */
 void
 vnode_decref(struct vnode *vn)
 {
-	int result;
-
 	KASSERT(vn != NULL);
 
 	vfs_biglock_acquire();
@@ -109,12 +133,8 @@ vnode_decref(struct vnode *vn)
 		vn->vn_refcount--;
 	}
 	else {
-		result = VOP_RECLAIM(vn);
-		if (result != 0 && result != EBUSY) {
-			// XXX: lame.
-			kprintf("vfs: Warning: VOP_RECLAIM: %s\n",
-				strerror(result));
-		}
+		/* the last reference is now the reclaim's */
+		workqueue_queue(&vn->vn_reclaim);
 	}
 
 	vfs_biglock_release();
@@ -0,0 +1,416 @@
+/*
+ * VM objects. See vmobj.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <array.h>
+#include <synch.h>
+#include <uio.h>
+#include <stat.h>
+#include <vnode.h>
+#include <vm.h>
+#include <vmobj.h>
+
+/*
+ * The table lock protects every object's reference count, and the
+ * tables of writeback and named objects, so that a lookup can't find
+ * an object whose last reference is being dropped.
+ */
+static struct lock *vmobj_table_lock;
+static struct array vmobj_table;	/* struct vmobj *, writeback only */
+static struct array vmobj_names;	/* struct vmobj *, named only */
+
+void
+vmobj_bootstrap(void)
+{
+	vmobj_table_lock = lock_create("vmobj table");
+	if (vmobj_table_lock == NULL) {
+		panic("vmobj_bootstrap: out of memory\n");
+	}
+	array_init(&vmobj_table);
+	array_init(&vmobj_names);
+}
+
+struct vmobj *
+vmobj_create(struct vnode *vn, off_t offset, unsigned npages)
+{
+	struct vmobj *obj;
+	unsigned i;
+
+	obj = kmalloc(sizeof(*obj));
+	if (obj == NULL) {
+		return NULL;
+	}
+	obj->vo_lock = lock_create("vmobj");
+	if (obj->vo_lock == NULL) {
+		kfree(obj);
+		return NULL;
+	}
+	obj->vo_pages = kmalloc(npages * sizeof(paddr_t));
+	if (obj->vo_pages == NULL) {
+		lock_destroy(obj->vo_lock);
+		kfree(obj);
+		return NULL;
+	}
+	for (i=0; i<npages; i++) {
+		obj->vo_pages[i] = 0;
+	}
+	obj->vo_npages = npages;
+	obj->vo_vn = vn;
+	if (vn != NULL) {
+		VOP_INCREF(vn);
+	}
+	obj->vo_offset = offset;
+	obj->vo_writeback = false;
+	obj->vo_refs = 1;
+	obj->vo_key = 0;
+	return obj;
+}
+
+/*
+ * Make OBJ at least NPAGES long. Called with the object locked.
+ */
+static
+int
+vmobj_grow(struct vmobj *obj, unsigned npages)
+{
+	paddr_t *pages;
+	unsigned i;
+
+	if (npages <= obj->vo_npages) {
+		return 0;
+	}
+	pages = kmalloc(npages * sizeof(paddr_t));
+	if (pages == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<npages; i++) {
+		pages[i] = i < obj->vo_npages ? obj->vo_pages[i] : 0;
+	}
+	kfree(obj->vo_pages);
+	obj->vo_pages = pages;
+	obj->vo_npages = npages;
+	return 0;
+}
+
+int
+vmobj_shared(struct vnode *vn, unsigned npages, struct vmobj **ret)
+{
+	struct vmobj *obj;
+	unsigned i, num;
+	int result;
+
+	lock_acquire(vmobj_table_lock);
+	num = array_num(&vmobj_table);
+	for (i=0; i<num; i++) {
+		obj = array_get(&vmobj_table, i);
+		if (obj->vo_vn == vn) {
+			lock_acquire(obj->vo_lock);
+			result = vmobj_grow(obj, npages);
+			lock_release(obj->vo_lock);
+			if (result == 0) {
+				obj->vo_refs++;
+				*ret = obj;
+			}
+			lock_release(vmobj_table_lock);
+			return result;
+		}
+	}
+
+	obj = vmobj_create(vn, 0, npages);
+	if (obj == NULL) {
+		lock_release(vmobj_table_lock);
+		return ENOMEM;
+	}
+	obj->vo_writeback = true;
+	result = array_add(&vmobj_table, obj, NULL);
+	lock_release(vmobj_table_lock);
+	if (result) {
+		obj->vo_writeback = false;
+		vmobj_decref(obj);
+		return result;
+	}
+	*ret = obj;
+	return 0;
+}
+
+int
+vmobj_named(int key, unsigned npages, struct vmobj **ret)
+{
+	struct vmobj *obj;
+	unsigned i, num;
+	int result;
+
+	lock_acquire(vmobj_table_lock);
+	num = array_num(&vmobj_names);
+	for (i=0; i<num; i++) {
+		obj = array_get(&vmobj_names, i);
+		if (obj->vo_key == key) {
+			lock_acquire(obj->vo_lock);
+			result = vmobj_grow(obj, npages);
+			lock_release(obj->vo_lock);
+			if (result == 0) {
+				obj->vo_refs++;
+				*ret = obj;
+			}
+			lock_release(vmobj_table_lock);
+			return result;
+		}
+	}
+
+	obj = vmobj_create(NULL, 0, npages);
+	if (obj == NULL) {
+		lock_release(vmobj_table_lock);
+		return ENOMEM;
+	}
+	obj->vo_key = key;
+	result = array_add(&vmobj_names, obj, NULL);
+	if (result) {
+		lock_release(vmobj_table_lock);
+		vmobj_decref(obj);
+		return result;
+	}
+	/* one for the table, one for the caller */
+	obj->vo_refs = 2;
+	lock_release(vmobj_table_lock);
+	*ret = obj;
+	return 0;
+}
+
+int
+vmobj_unname(int key)
+{
+	struct vmobj *obj;
+	unsigned i, num;
+
+	lock_acquire(vmobj_table_lock);
+	num = array_num(&vmobj_names);
+	for (i=0; i<num; i++) {
+		obj = array_get(&vmobj_names, i);
+		if (obj->vo_key == key) {
+			array_remove(&vmobj_names, i);
+			lock_release(vmobj_table_lock);
+			/* the segment goes once the last mapping does */
+			vmobj_decref(obj);
+			return 0;
+		}
+	}
+	lock_release(vmobj_table_lock);
+	return ENOENT;
+}
+
+int
+vmobj_resize(struct vmobj *obj, unsigned npages)
+{
+	unsigned i;
+	int result;
+
+	KASSERT(!obj->vo_writeback);
+
+	lock_acquire(obj->vo_lock);
+	if (npages >= obj->vo_npages) {
+		result = vmobj_grow(obj, npages);
+		lock_release(obj->vo_lock);
+		return result;
+	}
+	for (i=npages; i<obj->vo_npages; i++) {
+		if (obj->vo_pages[i] != 0) {
+			free_kpages(PADDR_TO_KVADDR(obj->vo_pages[i] &
+						    PAGE_FRAME));
+			obj->vo_pages[i] = 0;
+		}
+	}
+	/* keep the array; it will likely grow again */
+	obj->vo_npages = npages;
+	lock_release(obj->vo_lock);
+	return 0;
+}
+
+struct vmobj *
+vmobj_copy(struct vmobj *obj)
+{
+	struct vmobj *copy;
+	vaddr_t kva;
+	unsigned i;
+
+	copy = vmobj_create(obj->vo_vn, obj->vo_offset, obj->vo_npages);
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	lock_acquire(obj->vo_lock);
+	for (i=0; i<obj->vo_npages; i++) {
+		if (obj->vo_pages[i] == 0) {
+			/* still in the file, or still zero */
+			continue;
+		}
+		kva = alloc_kpages(1);
+		if (kva == 0) {
+			lock_release(obj->vo_lock);
+			vmobj_decref(copy);
+			return NULL;
+		}
+		memmove((void *)kva,
+			(const void *)PADDR_TO_KVADDR(obj->vo_pages[i] &
+						      PAGE_FRAME),
+			PAGE_SIZE);
+		copy->vo_pages[i] = KVADDR_TO_PADDR(kva);
+	}
+	lock_release(obj->vo_lock);
+	return copy;
+}
+
+void
+vmobj_incref(struct vmobj *obj)
+{
+	lock_acquire(vmobj_table_lock);
+	KASSERT(obj->vo_refs > 0);
+	obj->vo_refs++;
+	lock_release(vmobj_table_lock);
+}
+
+void
+vmobj_decref(struct vmobj *obj)
+{
+	unsigned i, num;
+
+	lock_acquire(vmobj_table_lock);
+	KASSERT(obj->vo_refs > 0);
+	obj->vo_refs--;
+	if (obj->vo_refs > 0) {
+		lock_release(vmobj_table_lock);
+		return;
+	}
+	if (obj->vo_writeback) {
+		num = array_num(&vmobj_table);
+		for (i=0; i<num; i++) {
+			if (array_get(&vmobj_table, i) == obj) {
+				array_remove(&vmobj_table, i);
+				break;
+			}
+		}
+	}
+	lock_release(vmobj_table_lock);
+
+	for (i=0; i<obj->vo_npages; i++) {
+		if (obj->vo_pages[i] != 0) {
+			free_kpages(PADDR_TO_KVADDR(obj->vo_pages[i] &
+						    PAGE_FRAME));
+		}
+	}
+	if (obj->vo_vn != NULL) {
+		VOP_DECREF(obj->vo_vn);
+	}
+	kfree(obj->vo_pages);
+	lock_destroy(obj->vo_lock);
+	kfree(obj);
+}
+
+/*
+ * Fill the frame at KVA with page INDEX: from the file, zero-padded
+ * past end of file, or all zeros for anonymous memory.
+ */
+static
+int
+vmobj_pagein(struct vmobj *obj, unsigned index, vaddr_t kva)
+{
+	struct iovec iov;
+	struct uio u;
+	int result;
+
+	if (obj->vo_vn == NULL) {
+		bzero((void *)kva, PAGE_SIZE);
+		return 0;
+	}
+	uio_kinit(&iov, &u, (void *)kva, PAGE_SIZE,
+		  obj->vo_offset + (off_t)index * PAGE_SIZE, UIO_READ);
+	result = VOP_READ(obj->vo_vn, &u);
+	if (result) {
+		return result;
+	}
+	bzero((void *)(kva + PAGE_SIZE - u.uio_resid), u.uio_resid);
+	return 0;
+}
+
+int
+vmobj_getpage(struct vmobj *obj, unsigned index, bool write,
+	      paddr_t *ret, bool *dirty)
+{
+	vaddr_t kva;
+	int result;
+
+	lock_acquire(obj->vo_lock);
+	if (index >= obj->vo_npages) {
+		lock_release(obj->vo_lock);
+		return EFAULT;
+	}
+	if (obj->vo_pages[index] == 0) {
+		kva = alloc_kpages(1);
+		if (kva == 0) {
+			lock_release(obj->vo_lock);
+			return ENOMEM;
+		}
+		result = vmobj_pagein(obj, index, kva);
+		if (result) {
+			free_kpages(kva);
+			lock_release(obj->vo_lock);
+			return result;
+		}
+		obj->vo_pages[index] = KVADDR_TO_PADDR(kva);
+	}
+	if (write) {
+		obj->vo_pages[index] |= VOPAGE_DIRTY;
+	}
+	*ret = obj->vo_pages[index] & PAGE_FRAME;
+	*dirty = (obj->vo_pages[index] & VOPAGE_DIRTY) != 0;
+	lock_release(obj->vo_lock);
+	return 0;
+}
+
+int
+vmobj_sync(struct vmobj *obj, unsigned first, unsigned npages)
+{
+	struct iovec iov;
+	struct uio u;
+	struct stat st;
+	off_t pos;
+	size_t len;
+	unsigned i;
+	int result;
+
+	if (!obj->vo_writeback) {
+		return 0;
+	}
+
+	lock_acquire(obj->vo_lock);
+	result = VOP_STAT(obj->vo_vn, &st);
+	if (result) {
+		lock_release(obj->vo_lock);
+		return result;
+	}
+	for (i=first; i<first+npages && i<obj->vo_npages; i++) {
+		if ((obj->vo_pages[i] & VOPAGE_DIRTY) == 0) {
+			continue;
+		}
+		pos = obj->vo_offset + (off_t)i * PAGE_SIZE;
+		if (pos >= st.st_size) {
+			continue;
+		}
+		len = PAGE_SIZE;
+		if (st.st_size - pos < (off_t)len) {
+			len = st.st_size - pos;
+		}
+		uio_kinit(&iov, &u,
+			  (void *)PADDR_TO_KVADDR(obj->vo_pages[i] & PAGE_FRAME),
+			  len, pos, UIO_WRITE);
+		result = VOP_WRITE(obj->vo_vn, &u);
+		if (result) {
+			break;
+		}
+	}
+	lock_release(obj->vo_lock);
+	vm_textinval(obj->vo_vn);
+	return result;
+}
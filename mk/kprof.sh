@@ -0,0 +1,82 @@
+#!/bin/sh
+# kprof.sh - make a flat profile from the kernel profiler's output
+# usage: kprof.sh kernel [logfile ...]
+# kernel is the kernel binary the samples came from; the logs (or
+# stdin) are console output with the "kprof pc" lines printed by the
+# kp menu command. Prints samples, percent and function, busiest
+# first; user-mode samples are lumped together as [user].
+#
+# Set NM to use some other nm.
+
+NM=${NM:-mips-harvard-os161-nm}
+
+if [ $# -lt 1 ]; then
+    echo "$0: Usage: $0 kernel [logfile ...]" 1>&2
+    exit 1
+fi
+
+SYMS=`mktemp /tmp/kprof.XXXXXX` || exit 1
+trap 'rm -f "$SYMS"' 0
+
+$NM -n "$1" | awk '$2 ~ /^[tTwW]$/ { print $1, $3 }' > "$SYMS"
+if [ ! -s "$SYMS" ]; then
+    echo "$0: no symbols in $1" 1>&2
+    exit 1
+fi
+shift
+
+# awk has no hex input, and nm's output is sorted, so convert by hand
+# and binary search for the last symbol at or below each PC.
+cat "$@" | tr -d '\r' | awk -v syms="$SYMS" '
+function hex(s,    i, v) {
+    s = tolower(s)
+    sub(/^0x/, "", s)
+    v = 0
+    for (i = 1; i <= length(s); i++) {
+	v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+    }
+    return v
+}
+BEGIN {
+    n = 0
+    while ((getline line < syms) > 0) {
+	split(line, f, " ")
+	addr[n] = hex(f[1])
+	name[n] = f[2]
+	n++
+    }
+}
+$1 == "kprof" && $2 == "pc" {
+    count = $5 + 0
+    total += count
+    if ($4 == "u") {
+	prof["[user]"] += count
+	next
+    }
+    pc = hex($3)
+    fn = "[unknown]"
+    if (pc >= addr[0]) {
+	lo = 0
+	hi = n - 1
+	while (lo < hi) {
+	    mid = int((lo + hi + 1) / 2)
+	    if (addr[mid] <= pc) {
+		lo = mid
+	    }
+	    else {
+		hi = mid - 1
+	    }
+	}
+	fn = name[lo]
+    }
+    prof[fn] += count
+}
+END {
+    if (total == 0) {
+	print "no kprof samples found" > "/dev/stderr"
+	exit 1
+    }
+    for (fn in prof) {
+	printf "%8d %6.2f%%  %s\n", prof[fn], 100 * prof[fn] / total, fn
+    }
+}' | sort -rn
@@ -0,0 +1,151 @@
+/*
+ * ps - show processes and what they have used.
+ * Usage: ps [interval [count]]
+ *
+ * Prints one line per process from the procstat system call. Times
+ * are CPU time in seconds; %CPU is the share of all the cpus' time.
+ * Process 0 is the kernel's own threads. A process with no threads
+ * has exited and is waiting for its parent.
+ *
+ * With no arguments, shows usage since boot (or since each process
+ * started). With an interval, works like top: every INTERVAL seconds
+ * shows what was used during the last INTERVAL seconds, COUNT times
+ * or until killed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define MAXPROCS 128
+
+struct snapshot {
+	struct sysstat ss;
+	struct procstat ps[MAXPROCS];
+	int n;
+};
+
+static struct snapshot snaps[2];
+
+static
+void
+take(struct snapshot *s)
+{
+	s->n = procstat(&s->ss, s->ps, MAXPROCS);
+	if (s->n < 0) {
+		err(1, "procstat");
+	}
+}
+
+/*
+ * Find the entry for PID in OLD, or NULL if it wasn't there.
+ */
+static
+const struct procstat *
+find(const struct snapshot *old, pid_t pid)
+{
+	int i;
+
+	for (i=0; i<old->n; i++) {
+		if (old->ps[i].ps_pid == pid) {
+			return &old->ps[i];
+		}
+	}
+	return NULL;
+}
+
+/* Print TICKS as seconds, to hundredths. */
+static
+void
+printticks(unsigned long long ticks, unsigned hz)
+{
+	printf(" %5llu.%02llu", ticks / hz, (ticks % hz) * 100 / hz);
+}
+
+/*
+ * Print what was used between OLD and NEW, or since boot if OLD is
+ * NULL.
+ */
+static
+void
+show(const struct snapshot *new, const struct snapshot *old)
+{
+	static const struct procstat zero;
+	const struct procstat *p, *q;
+	unsigned long long ticks, idle, busy;
+	unsigned ncpus;
+	int i;
+
+	ticks = new->ss.ss_ticks - (old ? old->ss.ss_ticks : 0);
+	idle = new->ss.ss_idleticks - (old ? old->ss.ss_idleticks : 0);
+	ncpus = new->ss.ss_ncpus ? new->ss.ss_ncpus : 1;
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	printf("%u cpus, %s", ncpus, old ? "last" : "up");
+	printticks(ticks / ncpus, new->ss.ss_hz);
+	printf("s, %llu%% idle, %u processes\n",
+	       idle * 100 / ticks, new->ss.ss_nprocs);
+
+	printf("  PID THR     USER      SYS %%CPU   VCSW  IVCSW FAULTS"
+	       "      READ     WRITE NAME\n");
+	for (i=0; i<new->n; i++) {
+		p = &new->ps[i];
+		q = old ? find(old, p->ps_pid) : NULL;
+		if (q == NULL) {
+			q = &zero;
+		}
+		busy = (unsigned long long)(p->ps_uticks - q->ps_uticks) +
+			(p->ps_sticks - q->ps_sticks);
+		printf("%5d %3u", p->ps_pid, p->ps_nthreads);
+		printticks(p->ps_uticks - q->ps_uticks, new->ss.ss_hz);
+		printticks(p->ps_sticks - q->ps_sticks, new->ss.ss_hz);
+		printf(" %4llu %6u %6u %6u %9llu %9llu %s\n",
+		       busy * 100 / ticks,
+		       p->ps_nvcsw - q->ps_nvcsw,
+		       p->ps_nivcsw - q->ps_nivcsw,
+		       p->ps_faults - q->ps_faults,
+		       p->ps_rbytes - q->ps_rbytes,
+		       p->ps_wbytes - q->ps_wbytes,
+		       p->ps_name);
+	}
+	if (new->ss.ss_nprocs > (unsigned)new->n) {
+		printf("(%u more not shown)\n", new->ss.ss_nprocs - new->n);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned interval, count, i;
+	int cur;
+
+	if (argc > 3) {
+		errx(1, "Usage: ps [interval [count]]");
+	}
+	if (argc == 1) {
+		take(&snaps[0]);
+		show(&snaps[0], NULL);
+		return 0;
+	}
+
+	interval = atoi(argv[1]);
+	count = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+	if (interval == 0) {
+		errx(1, "interval must be at least 1 second");
+	}
+
+	cur = 0;
+	take(&snaps[cur]);
+	for (i=0; count == 0 || i < count; i++) {
+		sleep(interval);
+		cur = !cur;
+		take(&snaps[cur]);
+		show(&snaps[cur], &snaps[!cur]);
+		printf("\n");
+	}
+	return 0;
+}
@@ -292,6 +292,106 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * launch
+ * starts the program args[0] in a new process, which gets our open
+ * files, and returns its pid. If it can't be started, complains and
+ * returns -1.
+ */
+static
+pid_t
+launch(char **args)
+{
+	pid_t pid;
+
+#ifdef HOST
+	pid = fork();
+	switch (pid) {
+		case -1:
+			/* error */
+			warn("fork");
+			return -1;
+		case 0:
+			/* child */
+			execv(args[0], args);
+			warn("%s", args[0]);
+			/*
+			 * Use _exit() instead of exit() in the child
+			 * process to avoid calling atexit() functions,
+			 * which would cause hostcompat (if present) to
+			 * reset the tty state and mess up our input
+			 * handling.
+			 */
+			_exit(1);
+		default:
+			break;
+	}
+#else
+	/*
+	 * spawn() loads the program straight into a new process, so
+	 * we don't copy our whole address space just to exec over it.
+	 * A program that can't be run is reported here rather than by
+	 * the child.
+	 */
+	pid = spawn(args[0], args);
+	if (pid < 0) {
+		warn("%s", args[0]);
+	}
+#endif
+	return pid;
+}
+
+/*
+ * dopipeline
+ * runs "left | right": left's standard output goes into a pipe that
+ * is right's standard input. Our own stdin and stdout are parked on
+ * spare descriptors while each side is started with the pipe end in
+ * place. Only left ever has the write end, so right sees end of file
+ * when left exits. Returns right's exit status.
+ */
+#define SAVE_STDIN  30
+#define SAVE_STDOUT 31
+
+static
+int
+dopipeline(char **left, char **right)
+{
+	int fds[2];
+	pid_t lpid, rpid;
+	int status;
+
+	if (pipe(fds) < 0) {
+		warn("pipe");
+		return _MKWAIT_EXIT(1);
+	}
+
+	dup2(STDOUT_FILENO, SAVE_STDOUT);
+	dup2(fds[1], STDOUT_FILENO);
+	close(fds[1]);
+	lpid = launch(left);
+	dup2(SAVE_STDOUT, STDOUT_FILENO);
+	close(SAVE_STDOUT);
+
+	dup2(STDIN_FILENO, SAVE_STDIN);
+	dup2(fds[0], STDIN_FILENO);
+	close(fds[0]);
+	rpid = launch(right);
+	dup2(SAVE_STDIN, STDIN_FILENO);
+	close(SAVE_STDIN);
+
+	if (lpid >= 0 && waitpid(lpid, &status, 0) < 0) {
+		warn("waitpid");
+	}
+	if (rpid < 0) {
+		return _MKWAIT_EXIT(1);
+	}
+	if (waitpid(rpid, &status, 0) < 0) {
+		warn("waitpid");
+		return -1;
+	}
+	return status;
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
@@ -309,6 +409,7 @@ docommand(char *buf)
 	pid_t pid;
 	int status;
 	int bg=0;
+	int pipeat=0;
 	time_t startsecs, endsecs;
 	unsigned long startnsecs, endnsecs;
 
@@ -350,30 +451,43 @@ docommand(char *buf)
 		bg = 1;
 	}
 
+	for (i=0; i<nargs; i++) {
+		if (!strcmp(args[i], "|")) {
+			break;
+		}
+	}
+	if (i < nargs) {
+		if (i == 0 || i == nargs-1) {
+			printf("Invalid null command\n");
+			return 1;
+		}
+		if (bg) {
+			printf("Pipelines can't be run in the background\n");
+			return 1;
+		}
+		pipeat = i;
+		args[pipeat] = NULL;
+		for (i=pipeat+1; i<nargs; i++) {
+			if (!strcmp(args[i], "|")) {
+				printf("Only one | per command\n");
+				return 1;
+			}
+		}
+	}
+
 	if (timing) {
 		__time(&startsecs, &startnsecs);
 	}
 
-	pid = fork();
-	switch (pid) {
-		case -1:
-			/* error */
-			warn("fork");
-			return _MKWAIT_EXIT(255);
-		case 0:
-			/* child */
-			execv(args[0], args);
-			warn("%s", args[0]);
-			/*
-			 * Use _exit() instead of exit() in the child
-			 * process to avoid calling atexit() functions,
-			 * which would cause hostcompat (if present) to
-			 * reset the tty state and mess up our input
-			 * handling.
-			 */
-			_exit(1);
-		default:
-			break;
+	if (pipeat > 0) {
+		status = dopipeline(args, &args[pipeat+1]);
+		goto done;
+	}
+
+	pid = launch(args);
+	if (pid < 0) {
+		/* the status a child that couldn't exec would have had */
+		return _MKWAIT_EXIT(1);
 	}
 
 	/* parent */
@@ -389,6 +503,7 @@ docommand(char *buf)
 		status = -1;
 	}
 
+ done:
 	if (timing) {
 		__time(&endsecs, &endnsecs);
 		if (endnsecs < startnsecs) {
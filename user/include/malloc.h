@@ -0,0 +1,22 @@
+#ifndef _MALLOC_H_
+#define _MALLOC_H_
+
+#include <types/size_t.h>
+
+/*
+ * Heap statistics, in the style of SVID mallinfo(). Computed by
+ * walking the heap, so this is for diagnostics rather than fast paths.
+ */
+struct mallinfo {
+	size_t arena;		/* bytes obtained with sbrk */
+	size_t ordblks;		/* free blocks in the general size bins */
+	size_t smblks;		/* free blocks on the size-class lists */
+	size_t uordblks;	/* bytes allocated to the program */
+	size_t fordblks;	/* free bytes in the general size bins */
+	size_t fsmblks;		/* free bytes on the size-class lists */
+	size_t keepcost;	/* free bytes at the top of the heap */
+};
+
+struct mallinfo mallinfo(void);
+
+#endif /* _MALLOC_H_ */
@@ -41,6 +41,46 @@
 /* Constant returned by a bunch of stdio functions on error */
 #define EOF (-1)
 
+/* Default buffer size, and how many streams can be open at once */
+#define BUFSIZ     4096
+#define FOPEN_MAX  20
+
+/* Buffering modes for setvbuf */
+#define _IOFBF  0	/* fully buffered */
+#define _IOLBF  1	/* line buffered */
+#define _IONBF  2	/* unbuffered */
+
+/*
+ * A stream. The buffer holds either unread input or unwritten output,
+ * never both; __F_WRITING says which. _mode is -1 until the first
+ * read or write, when it is chosen by what the descriptor refers to:
+ * a console is line buffered for output and unbuffered for input,
+ * anything else fully buffered. Unbuffered streams use _ch.
+ * (The fields are for libc internal use only.)
+ */
+typedef struct __file {
+	int _fd;		/* file descriptor */
+	int _flags;		/* __F_* below; 0 if the slot is free */
+	int _mode;		/* _IOFBF, _IOLBF, _IONBF, or -1 */
+	char *_buf;		/* the buffer, or NULL until first use */
+	size_t _size;		/* size of _buf */
+	size_t _pos;		/* next byte of _buf to read or fill */
+	size_t _len;		/* bytes of input in _buf */
+	char _ch;		/* one-byte buffer for unbuffered streams */
+} FILE;
+
+#define __F_READ     0x01	/* open for reading */
+#define __F_WRITE    0x02	/* open for writing */
+#define __F_WRITING  0x04	/* _buf holds output */
+#define __F_EOF      0x08	/* end of file seen */
+#define __F_ERR      0x10	/* error seen */
+#define __F_MYBUF    0x20	/* _buf was malloc'd by libc */
+
+extern FILE *stdin, *stdout, *stderr;
+
+/* Set up a stream's buffer on first use (for libc internal use only) */
+int __stdio_setup(FILE *f);
+
 /*
  * The actual guts of printf
  * (for libc internal use only)
@@ -56,6 +96,24 @@ int vprintf(const char *fmt, __va_list ap);
 int snprintf(char *buf, size_t len, const char *fmt, ...);
 int vsnprintf(char *buf, size_t len, const char *fmt, __va_list ap);
 
+/* Streams */
+FILE *fopen(const char *path, const char *mode);
+int fclose(FILE *f);
+int fflush(FILE *f);			/* NULL flushes every stream */
+int setvbuf(FILE *f, char *buf, int mode, size_t size);
+size_t fread(void *ptr, size_t size, size_t nitems, FILE *f);
+size_t fwrite(const void *ptr, size_t size, size_t nitems, FILE *f);
+int fgetc(FILE *f);
+int fputc(int ch, FILE *f);
+int fputs(const char *s, FILE *f);
+int feof(FILE *f);
+int ferror(FILE *f);
+void clearerr(FILE *f);
+int fprintf(FILE *f, const char *fmt, ...);
+int vfprintf(FILE *f, const char *fmt, __va_list ap);
+#define getc(f)    fgetc(f)
+#define putc(c, f) fputc(c, f)
+
 /* Print the argument string and then a newline. Returns 0 or -1 on error. */
 int puts(const char *);
 
@@ -0,0 +1,28 @@
+#ifndef _SYS_MMAN_H_
+#define _SYS_MMAN_H_
+
+/*
+ * Memory mapping. The PROT_*, MAP_* and MS_* flags come from the
+ * kernel.
+ */
+#include <sys/types.h>
+#include <kern/mman.h>
+
+/* What mmap returns on error. */
+#define MAP_FAILED ((void *)-1)
+
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+int munmap(void *addr, size_t len);
+int msync(void *addr, size_t len, int flags);
+
+/*
+ * Named shared memory (OS/161 extension). shm_attach maps LEN bytes of
+ * the segment called KEY, making it (zeroed) if there is none yet, and
+ * returns where; every process attaching KEY sees the same memory.
+ * Detach with munmap. A segment lasts until shm_remove and the last
+ * detach, whichever is later.
+ */
+void *shm_attach(int key, size_t len, int prot);
+int shm_remove(int key);
+
+#endif /* _SYS_MMAN_H_ */
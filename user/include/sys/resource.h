@@ -0,0 +1,15 @@
+#ifndef _SYS_RESOURCE_H_
+#define _SYS_RESOURCE_H_
+
+/*
+ * Resource usage. struct rusage and the RUSAGE_* codes come from the
+ * kernel; only the times, ru_minflt, ru_inblock, ru_oublock, ru_nvcsw
+ * and ru_nivcsw are filled in.
+ */
+#include <sys/types.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+
+int getrusage(int who, struct rusage *usage);
+
+#endif /* _SYS_RESOURCE_H_ */
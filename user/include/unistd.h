@@ -39,6 +39,7 @@
  */
 #include <kern/fcntl.h>
 #include <kern/ioctl.h>
+#include <kern/procstat.h>
 #include <kern/reboot.h>
 #include <kern/seek.h>
 #include <kern/time.h>
@@ -56,6 +57,7 @@
  *     fstat:    sys/stat.h
  *     lstat:    sys/stat.h
  *     mkdir:    sys/stat.h
+ *     getrusage: sys/resource.h
  *
  * If this were standard Unix, more prototypes would go in other
  * header files as well, as follows:
@@ -117,7 +119,6 @@
 /* Required. */
 __DEAD void _exit(int code);
 int execv(const char *prog, char *const *args);
-pid_t fork(void);
 int waitpid(pid_t pid, int *returncode, int flags);
 /* 
  * Open actually takes either two or three args: the optional third
@@ -153,15 +154,28 @@ int readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 time_t __time(time_t *seconds, unsigned long *nanoseconds);
+int nanosleep(const struct timespec *req, struct timespec *rem);
 int __getcwd(char *buf, size_t buflen);
+pid_t __fork(void);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
+/* OS/161 extensions. */
+int futex_wait(volatile int *addr, int expected);
+int futex_wake(volatile int *addr, int count);
+pid_t spawn(const char *prog, char *const *args);
+int __bench(int op, unsigned id);
+int procstat(struct sysstat *ss, struct procstat *ps, unsigned nps);
+
 /*
  * These are not themselves system calls, but wrapper routines in libc.
  */
 
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+pid_t fork(void);				/* calls __fork */
+unsigned sleep(unsigned seconds);		/* calls nanosleep */
+int bench_begin(unsigned id);			/* calls __bench */
+int bench_end(unsigned id);			/* calls __bench */
 
 #endif /* _UNISTD_H_ */
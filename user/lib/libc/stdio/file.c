@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/*
+ * Stream table and open/close/flush. See <stdio.h> for how buffering
+ * is chosen.
+ *
+ * There is no lseek, so input read ahead into a stream's buffer can't
+ * be given back: switching a read/write stream from reading to
+ * writing, or flushing it, throws unread input away.
+ */
+
+static FILE __files[FOPEN_MAX] = {
+	{ STDIN_FILENO, __F_READ, -1, NULL, 0, 0, 0, 0 },
+	{ STDOUT_FILENO, __F_WRITE, -1, NULL, 0, 0, 0, 0 },
+	{ STDERR_FILENO, __F_WRITE, _IONBF, NULL, 0, 0, 0, 0 },
+};
+
+FILE *stdin = &__files[0];
+FILE *stdout = &__files[1];
+FILE *stderr = &__files[2];
+
+/* Buffers for stdin and stdout, so printf never needs malloc. */
+static char __stdinbuf[BUFSIZ], __stdoutbuf[BUFSIZ];
+
+/*
+ * Choose the buffering mode, if setvbuf hasn't, and get a buffer.
+ * Returns 0, or -1 with errno set if the stream can't be used.
+ */
+int
+__stdio_setup(FILE *f)
+{
+	struct stat st;
+
+	if (f->_flags == 0) {
+		errno = EBADF;
+		return -1;
+	}
+	if (f->_buf != NULL) {
+		return 0;
+	}
+
+	if (f->_mode < 0) {
+		if (fstat(f->_fd, &st) == 0 && !S_ISCHR(st.st_mode)) {
+			f->_mode = _IOFBF;
+		}
+		else if (f->_flags & __F_WRITE) {
+			/* a console, or we can't tell */
+			f->_mode = _IOLBF;
+		}
+		else {
+			/* so programs that echo input see each key */
+			f->_mode = _IONBF;
+		}
+	}
+
+	if (f->_mode != _IONBF && f->_size == 0) {
+		f->_size = BUFSIZ;
+	}
+	if (f->_mode == _IONBF) {
+		f->_buf = &f->_ch;
+		f->_size = 1;
+	}
+	else if (f == stdin && f->_size == BUFSIZ) {
+		f->_buf = __stdinbuf;
+	}
+	else if (f == stdout && f->_size == BUFSIZ) {
+		f->_buf = __stdoutbuf;
+	}
+	else {
+		f->_buf = malloc(f->_size);
+		if (f->_buf == NULL) {
+			/* do without */
+			f->_mode = _IONBF;
+			f->_buf = &f->_ch;
+			f->_size = 1;
+		}
+		else {
+			f->_flags |= __F_MYBUF;
+		}
+	}
+	f->_pos = f->_len = 0;
+	return 0;
+}
+
+/*
+ * Write out buffered output, and drop buffered input.
+ */
+static
+int
+__stdio_flush(FILE *f)
+{
+	size_t done;
+	int r;
+
+	if ((f->_flags & __F_WRITING) == 0) {
+		f->_pos = f->_len = 0;
+		return 0;
+	}
+	for (done = 0; done < f->_pos; done += r) {
+		r = write(f->_fd, f->_buf + done, f->_pos - done);
+		if (r <= 0) {
+			f->_flags |= __F_ERR;
+			f->_pos = 0;
+			return EOF;
+		}
+	}
+	f->_pos = 0;
+	return 0;
+}
+
+int
+fflush(FILE *f)
+{
+	int i, ret = 0;
+
+	if (f != NULL) {
+		if (f->_flags == 0) {
+			errno = EBADF;
+			return EOF;
+		}
+		return __stdio_flush(f);
+	}
+	for (i=0; i<FOPEN_MAX; i++) {
+		if ((__files[i]._flags & __F_WRITING) &&
+		    __stdio_flush(&__files[i])) {
+			ret = EOF;
+		}
+	}
+	return ret;
+}
+
+FILE *
+fopen(const char *path, const char *mode)
+{
+	FILE *f = NULL;
+	int i, oflags, fflags, fd;
+
+	switch (mode[0]) {
+	    case 'r':
+		oflags = O_RDONLY;
+		fflags = __F_READ;
+		break;
+	    case 'w':
+		oflags = O_WRONLY | O_CREAT | O_TRUNC;
+		fflags = __F_WRITE;
+		break;
+	    case 'a':
+		oflags = O_WRONLY | O_CREAT | O_APPEND;
+		fflags = __F_WRITE;
+		break;
+	    default:
+		errno = EINVAL;
+		return NULL;
+	}
+	/* "b" means nothing here */
+	if (mode[1] == '+' || (mode[1] == 'b' && mode[2] == '+')) {
+		oflags = (oflags & ~O_ACCMODE) | O_RDWR;
+		fflags = __F_READ | __F_WRITE;
+	}
+
+	for (i=0; i<FOPEN_MAX; i++) {
+		if (__files[i]._flags == 0) {
+			f = &__files[i];
+			break;
+		}
+	}
+	if (f == NULL) {
+		errno = EMFILE;
+		return NULL;
+	}
+
+	fd = open(path, oflags, 0664);
+	if (fd < 0) {
+		return NULL;
+	}
+	f->_fd = fd;
+	f->_flags = fflags;
+	f->_mode = -1;
+	f->_buf = NULL;
+	f->_size = f->_pos = f->_len = 0;
+	return f;
+}
+
+int
+fclose(FILE *f)
+{
+	int ret;
+
+	if (f->_flags == 0) {
+		errno = EBADF;
+		return EOF;
+	}
+	ret = __stdio_flush(f);
+	if (close(f->_fd) < 0) {
+		ret = EOF;
+	}
+	if (f->_flags & __F_MYBUF) {
+		free(f->_buf);
+	}
+	f->_flags = 0;
+	f->_buf = NULL;
+	return ret;
+}
+
+/*
+ * Choose buffering for F. Must come before any I/O on it. If BUF is
+ * NULL a buffer of SIZE bytes is allocated on first use.
+ */
+int
+setvbuf(FILE *f, char *buf, int mode, size_t size)
+{
+	if (f->_flags == 0 || f->_buf != NULL ||
+	    (mode != _IOFBF && mode != _IOLBF && mode != _IONBF) ||
+	    (mode != _IONBF && size == 0)) {
+		errno = EINVAL;
+		return EOF;
+	}
+	f->_mode = mode;
+	f->_size = mode == _IONBF ? 0 : size;
+	if (mode != _IONBF && buf != NULL) {
+		f->_buf = buf;
+		f->_pos = f->_len = 0;
+	}
+	return 0;
+}
+
+int
+feof(FILE *f)
+{
+	return (f->_flags & __F_EOF) != 0;
+}
+
+int
+ferror(FILE *f)
+{
+	return (f->_flags & __F_ERR) != 0;
+}
+
+void
+clearerr(FILE *f)
+{
+	f->_flags &= ~(__F_EOF | __F_ERR);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Buffered input. A read that needs the kernel first flushes stdout if
+ * it is line buffered, so a prompt shows up before we wait for the
+ * answer.
+ */
+
+/*
+ * One read(). Returns the byte count, 0 at end of file, -1 on error.
+ */
+static
+int
+__stdio_read(FILE *f, char *dest, size_t len)
+{
+	int r;
+
+	if (stdout->_mode == _IOLBF && (stdout->_flags & __F_WRITING)) {
+		fflush(stdout);
+	}
+	r = read(f->_fd, dest, len);
+	if (r == 0) {
+		f->_flags |= __F_EOF;
+	}
+	else if (r < 0) {
+		f->_flags |= __F_ERR;
+	}
+	return r;
+}
+
+size_t
+fread(void *ptr, size_t size, size_t nitems, FILE *f)
+{
+	char *dest = ptr;
+	size_t total, done, n;
+	int r;
+
+	total = size * nitems;
+	if (total == 0) {
+		return 0;
+	}
+	if ((f->_flags & __F_READ) == 0) {
+		f->_flags |= __F_ERR;
+		errno = EBADF;
+		return 0;
+	}
+	if (__stdio_setup(f)) {
+		return 0;
+	}
+	if (f->_flags & __F_WRITING) {
+		if (fflush(f)) {
+			return 0;
+		}
+		f->_flags &= ~__F_WRITING;
+	}
+
+	done = 0;
+	while (done < total) {
+		if (f->_pos < f->_len) {
+			n = f->_len - f->_pos;
+			if (n > total - done) {
+				n = total - done;
+			}
+			memcpy(dest + done, f->_buf + f->_pos, n);
+			f->_pos += n;
+			done += n;
+			continue;
+		}
+		if (total - done >= f->_size) {
+			/* at least a buffer's worth; skip the copy */
+			r = __stdio_read(f, dest + done, total - done);
+			if (r <= 0) {
+				break;
+			}
+			done += r;
+		}
+		else {
+			r = __stdio_read(f, f->_buf, f->_size);
+			if (r <= 0) {
+				break;
+			}
+			f->_pos = 0;
+			f->_len = r;
+		}
+	}
+	return done / size;
+}
+
+int
+fgetc(FILE *f)
+{
+	unsigned char ch;
+
+	if (f->_pos < f->_len && (f->_flags & __F_WRITING) == 0) {
+		return (unsigned char)f->_buf[f->_pos++];
+	}
+	if (fread(&ch, 1, 1, f) != 1) {
+		return EOF;
+	}
+	return ch;
+}
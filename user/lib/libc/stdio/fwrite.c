@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Buffered output.
+ */
+
+/*
+ * Write LEN bytes straight out. Returns how many got written.
+ */
+static
+size_t
+__stdio_direct(FILE *f, const char *src, size_t len)
+{
+	size_t done;
+	int r;
+
+	for (done = 0; done < len; done += r) {
+		r = write(f->_fd, src + done, len - done);
+		if (r <= 0) {
+			f->_flags |= __F_ERR;
+			break;
+		}
+	}
+	return done;
+}
+
+size_t
+fwrite(const void *ptr, size_t size, size_t nitems, FILE *f)
+{
+	const char *src = ptr;
+	size_t total, done, n, i;
+
+	total = size * nitems;
+	if (total == 0) {
+		return 0;
+	}
+	if ((f->_flags & __F_WRITE) == 0) {
+		f->_flags |= __F_ERR;
+		errno = EBADF;
+		return 0;
+	}
+	if (__stdio_setup(f)) {
+		return 0;
+	}
+	if ((f->_flags & __F_WRITING) == 0) {
+		/* drop any read-ahead; see file.c */
+		f->_pos = f->_len = 0;
+		f->_flags |= __F_WRITING;
+	}
+
+	if (f->_mode == _IONBF) {
+		return __stdio_direct(f, src, total) / size;
+	}
+
+	done = 0;
+	while (done < total) {
+		if (f->_pos == 0 && total - done >= f->_size) {
+			/* nothing to merge with; skip the copy */
+			done += __stdio_direct(f, src + done, total - done);
+			break;
+		}
+		n = f->_size - f->_pos;
+		if (n > total - done) {
+			n = total - done;
+		}
+		memcpy(f->_buf + f->_pos, src + done, n);
+		f->_pos += n;
+		done += n;
+		if (f->_pos == f->_size && fflush(f)) {
+			return (done - n) / size;
+		}
+	}
+
+	if (f->_mode == _IOLBF && f->_pos > 0) {
+		for (i=0; i<total; i++) {
+			if (src[i] == '\n') {
+				if (fflush(f)) {
+					return 0;
+				}
+				break;
+			}
+		}
+	}
+	return done / size;
+}
+
+int
+fputc(int ch, FILE *f)
+{
+	char c = ch;
+
+	if (f->_pos + 1 < f->_size && (f->_flags & __F_WRITING) &&
+	    (f->_mode == _IOFBF || c != '\n')) {
+		/* the common case: room in the buffer */
+		f->_buf[f->_pos++] = c;
+		return (unsigned char)c;
+	}
+	if (fwrite(&c, 1, 1, f) != 1) {
+		return EOF;
+	}
+	return (unsigned char)c;
+}
+
+int
+fputs(const char *s, FILE *f)
+{
+	size_t len = strlen(s);
+
+	if (fwrite(s, 1, len, f) != len) {
+		return EOF;
+	}
+	return 0;
+}
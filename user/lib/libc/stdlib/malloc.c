@@ -30,15 +30,31 @@
 /*
  * User-level malloc and free implementation.
  *
- * This is a basic first-fit allocator. It's intended to be simple and
- * easy to follow. It performs abysmally if the heap becomes larger than
- * physical memory. To get (much) better out-of-core performance, port
- * the kernel's malloc. :-)
+ * This is a segregated-fit allocator. Every block, in use or free,
+ * has a header giving the offsets to its neighbours, so the heap can
+ * be walked and free can coalesce in constant time.
+ *
+ * Requests up to MSMALLMAX bytes are rounded up to one of a fixed set
+ * of size classes, each with its own free list. Lists are refilled by
+ * carving a large block into blocks of one class; those blocks keep
+ * mh_small set for good, go back on their class list when freed, and
+ * are never coalesced. Allocating or freeing one is a list push or
+ * pop.
+ *
+ * Larger requests come from free blocks kept in bins by power of two
+ * of their size: first fit within the request's own bin, else any
+ * block from a larger bin, splitting off the excess. Freed large
+ * blocks are merged with free large neighbours, so no two are ever
+ * adjacent.
+ *
+ * The heap grows with sbrk in whole pages, extending the top block
+ * if it is free, and a free top block of MTRIM or more is given back.
  */
 
 #include <stdlib.h>
 #include <unistd.h>
 #include <err.h>
+#include <malloc.h>
 #include <stdint.h>  // for uintptr_t on non-OS/161 platforms
 
 #undef MALLOCDEBUG
@@ -59,7 +75,7 @@
  *
  * mh_nextblock is the upwards offset to the next header.
  *
- * mh_pad is unused.
+ * mh_small is 1 if the block belongs to a size class.
  * mh_inuse is 1 if the block is in use, 0 if it is free.
  * mh_magic* should always be a fixed value.
  *
@@ -78,7 +94,7 @@ struct mheader {
 	 * Block size is 8 bytes.
 	 */
 	unsigned mh_prevblock:29;
-	unsigned mh_pad:1;
+	unsigned mh_small:1;
 	unsigned mh_magic1:2;
 
 	unsigned mh_nextblock:29;
@@ -94,7 +110,7 @@ struct mheader {
 	 * Block size is 16 bytes.
 	 */
 	unsigned mh_prevblock:62;
-	unsigned mh_pad:1;
+	unsigned mh_small:1;
 	unsigned mh_magic1:3;
 
 	unsigned mh_nextblock:62;
@@ -116,6 +132,7 @@ struct mheader {
  * M_SIZE:		return data size of a header
  *
  * M_OK:		true if the magic values are correct
+ * M_FREEBIG:		true if the block is free and not in a size class
  * 
  * M_MKFIELD:		prepare a value for mh_next/prevblock.
  * 			(value should include the header size)
@@ -130,15 +147,61 @@ struct mheader {
 #define M_SIZE(mh)	(M_NEXTOFF(mh)-MBLOCKSIZE)
 
 #define M_OK(mh)	((mh)->mh_magic1==MMAGIC && (mh)->mh_magic2==MMAGIC)
+#define M_FREEBIG(mh)	(!(mh)->mh_inuse && !(mh)->mh_small)
 
 #define M_MKFIELD(off)	((off)>>MBLOCKSHIFT)
 
+/*
+ * A free large block keeps its bin links in its data area, which is
+ * always at least MBLOCKSIZE bytes. A free small block keeps just
+ * the next pointer of its class list there.
+ */
+struct mfree {
+	struct mfree *mf_next;
+	struct mfree *mf_prev;
+};
+
+#define MF_HEADER(mf)	(((struct mheader *)(mf))-1)
+
+/*
+ * Tunables.
+ *
+ * MPAGE:	granularity of sbrk calls.
+ * MTRIM:	size of free top block at which pages are given back.
+ * MCHUNK:	roughly how much one size-class refill carves up.
+ * MSMALLMAX:	largest request served from a size class.
+ * MMAXSIZE:	largest request we try at all.
+ */
+#define MPAGE		4096
+#define MTRIM		(128*1024)
+#define MCHUNK		4096
+#define MSMALLMAX	1024
+#define MMAXSIZE	((size_t)1 << 30)
+
+#define MPAGEROUND(sz)	(((sz) + MPAGE - 1) & ~(size_t)(MPAGE-1))
+
+/* The size classes; all multiples of MBLOCKSIZE, the last MSMALLMAX. */
+static const size_t __malloc_classsize[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024,
+};
+#define MNCLASSES	(sizeof(__malloc_classsize)/sizeof(size_t))
+
+/* One bin per bit of size_t; bin b holds sizes in [2^b, 2^(b+1)). */
+#define MNBINS		(sizeof(size_t)*8)
+
 ////////////////////////////////////////////////////////////
 
 /*
- * Static variables - the bottom and top addresses of the heap.
+ * Static variables - the bottom and top addresses of the heap, the
+ * highest block, the size-class free lists and the large-block bins.
  */
 static uintptr_t __heapbase, __heaptop;
+static struct mheader *__malloc_top;
+static struct mfree *__malloc_smallfree[MNCLASSES];
+static struct mfree *__malloc_bins[MNBINS];
+
+/* Size class for each request size, in units of MBLOCKSIZE. */
+static unsigned char __malloc_classof[MSMALLMAX/MBLOCKSIZE + 1];
 
 /*
  * Setup function.
@@ -148,6 +211,7 @@ void
 __malloc_init(void)
 {
 	void *x;
+	unsigned c, i;
 
 	/*
 	 * Check various assumed properties of the sizes.
@@ -161,12 +225,24 @@ __malloc_init(void)
 	if (1<<MBLOCKSHIFT != MBLOCKSIZE) {
 		errx(1, "malloc: Internal error - MBLOCKSHIFT wrong");
 	}
+	if (sizeof(struct mfree) > MBLOCKSIZE) {
+		errx(1, "malloc: Internal error - free links too big");
+	}
 
 	/* init should only be called once. */
 	if (__heapbase!=0 || __heaptop!=0) {
 		errx(1, "malloc: Internal error - bad init call");
 	}
 
+	/* Fill in the request size to size class table. */
+	c = 0;
+	for (i=0; i<=MSMALLMAX/MBLOCKSIZE; i++) {
+		while (__malloc_classsize[c] < i*MBLOCKSIZE) {
+			c++;
+		}
+		__malloc_classof[i] = c;
+	}
+
 	/* Use sbrk to find the base of the heap. */
 	x = sbrk(0);
 	if (x==(void *)-1) {
@@ -237,11 +313,12 @@ __malloc_dump(void)
 		}
 		rightprevblock = mh->mh_nextblock;
 
-		warnx("heap: 0x%lx 0x%-6lx (next: 0x%lx) %s",
+		warnx("heap: 0x%lx 0x%-6lx (next: 0x%lx) %s%s",
 		      (unsigned long) i + MBLOCKSIZE,
 		      (unsigned long) M_SIZE(mh),
 		      (unsigned long) (i+M_NEXTOFF(mh)),
-		      mh->mh_inuse ? "INUSE" : "FREE");
+		      mh->mh_inuse ? "INUSE" : "FREE",
+		      mh->mh_small ? " SMALL" : "");
 	}
 	if (i!=__heaptop) {
 		errx(1, "malloc: Heap corrupt; ran off end");
@@ -250,10 +327,97 @@ __malloc_dump(void)
 	warnx("heap: ************************************************");
 }
 
+/*
+ * Clear a range of memory with 0xdeadbeef.
+ * ptr must be suitably aligned.
+ */
+static
+void
+__malloc_deadbeef(void *ptr, size_t size)
+{
+	uint32_t *x = ptr;
+	size_t i, n = size/sizeof(uint32_t);
+	for (i=0; i<n; i++) {
+		x[i] = 0xdeadbeef;
+	}
+}
+
 #endif /* MALLOCDEBUG */
 
+/*
+ * Check a header we are about to use, and its link to the block
+ * above.
+ */
+static
+void
+__malloc_check(struct mheader *mh, const char *who)
+{
+	if (!M_OK(mh)) {
+		errx(1, "%s: Heap corrupt; header at %p has bad magic bits",
+		     who, mh);
+	}
+	if (mh != __malloc_top && M_NEXT(mh)->mh_prevblock != mh->mh_nextblock) {
+		errx(1, "%s: Heap corrupt (%p and %p inconsistent)",
+		     who, mh, M_NEXT(mh));
+	}
+}
+
 ////////////////////////////////////////////////////////////
 
+/*
+ * Bin index for a free block of SIZE bytes: floor(log2(size)).
+ */
+static
+unsigned
+__malloc_binof(size_t size)
+{
+	unsigned b = 0;
+
+	while (size >>= 1) {
+		b++;
+	}
+	return b;
+}
+
+/*
+ * Put a free large block in its bin.
+ */
+static
+void
+__malloc_binadd(struct mheader *mh)
+{
+	struct mfree *mf = M_DATA(mh);
+	unsigned b = __malloc_binof(M_SIZE(mh));
+
+	mf->mf_prev = NULL;
+	mf->mf_next = __malloc_bins[b];
+	if (mf->mf_next != NULL) {
+		mf->mf_next->mf_prev = mf;
+	}
+	__malloc_bins[b] = mf;
+}
+
+/*
+ * Take a free large block out of its bin. Must be called before its
+ * size changes.
+ */
+static
+void
+__malloc_binremove(struct mheader *mh)
+{
+	struct mfree *mf = M_DATA(mh);
+
+	if (mf->mf_prev != NULL) {
+		mf->mf_prev->mf_next = mf->mf_next;
+	}
+	else {
+		__malloc_bins[__malloc_binof(M_SIZE(mh))] = mf->mf_next;
+	}
+	if (mf->mf_next != NULL) {
+		mf->mf_next->mf_prev = mf->mf_prev;
+	}
+}
+
 /*
  * Get more memory (at the top of the heap) using sbrk, and 
  * return a pointer to it.
@@ -280,9 +444,46 @@ __malloc_sbrk(size_t size)
 }
 
 /*
- * Make a new (free) block from the block passed in, leaving size
- * bytes for data in the current block. size must be a multiple of
- * MBLOCKSIZE.
+ * Grow the heap so the top block is free and has at least size
+ * bytes for data, and return it. It is not in any bin.
+ */
+static
+struct mheader *
+__malloc_grow(size_t size)
+{
+	struct mheader *mh, *top = __malloc_top;
+	size_t more;
+
+	if (top != NULL && M_FREEBIG(top)) {
+		/* Extend the free top block. */
+		more = MPAGEROUND(size - M_SIZE(top));
+		if (__malloc_sbrk(more) == NULL) {
+			return NULL;
+		}
+		__malloc_binremove(top);
+		top->mh_nextblock = M_MKFIELD(M_NEXTOFF(top) + more);
+		return top;
+	}
+
+	more = MPAGEROUND(size + MBLOCKSIZE);
+	mh = __malloc_sbrk(more);
+	if (mh == NULL) {
+		return NULL;
+	}
+	mh->mh_prevblock = top != NULL ? top->mh_nextblock : 0;
+	mh->mh_magic1 = MMAGIC;
+	mh->mh_magic2 = MMAGIC;
+	mh->mh_small = 0;
+	mh->mh_inuse = 0;
+	mh->mh_nextblock = M_MKFIELD(more);
+	__malloc_top = mh;
+	return mh;
+}
+
+/*
+ * Make a new free block from the block passed in, leaving size
+ * bytes for data in the current block, and put it in its bin. size
+ * must be a multiple of MBLOCKSIZE.
  *
  * Only split if the excess space is at least twice the blocksize -
  * one blocksize to hold a header and one for data.
@@ -315,7 +516,7 @@ __malloc_split(struct mheader *mh, size_t size)
 	}
 
 	mhnew->mh_prevblock = M_MKFIELD(size + MBLOCKSIZE);
-	mhnew->mh_pad = 0;
+	mhnew->mh_small = 0;
 	mhnew->mh_magic1 = MMAGIC;
 	mhnew->mh_nextblock = M_MKFIELD(oldsize - size);
 	mhnew->mh_inuse = 0;
@@ -324,6 +525,124 @@ __malloc_split(struct mheader *mh, size_t size)
 	if (mhnext != (struct mheader *) __heaptop) {
 		mhnext->mh_prevblock = mhnew->mh_nextblock;
 	}
+	else {
+		__malloc_top = mhnew;
+	}
+
+	/* The block above was not free, or mh would have merged with it. */
+	__malloc_binadd(mhnew);
+}
+
+/*
+ * Find (or make) a free large block with at least size bytes, take
+ * it out of its bin and split off the excess. size must be a
+ * multiple of MBLOCKSIZE.
+ */
+static
+struct mheader *
+__malloc_large(size_t size)
+{
+	struct mheader *mh = NULL;
+	struct mfree *mf;
+	unsigned b;
+
+	/* First fit within the request's own bin... */
+	b = __malloc_binof(size);
+	for (mf = __malloc_bins[b]; mf != NULL; mf = mf->mf_next) {
+		if (M_SIZE(MF_HEADER(mf)) >= size) {
+			mh = MF_HEADER(mf);
+			break;
+		}
+	}
+	/* ...else anything in a larger bin is big enough. */
+	for (b++; mh == NULL && b < MNBINS; b++) {
+		if (__malloc_bins[b] != NULL) {
+			mh = MF_HEADER(__malloc_bins[b]);
+		}
+	}
+
+	if (mh != NULL) {
+		__malloc_check(mh, "malloc");
+		if (!M_FREEBIG(mh)) {
+			errx(1, "malloc: Heap corrupt; block %p in a bin"
+			     " is not free", M_DATA(mh));
+		}
+		__malloc_binremove(mh);
+	}
+	else {
+		mh = __malloc_grow(size);
+		if (mh == NULL) {
+			return NULL;
+		}
+	}
+
+	__malloc_split(mh, size);
+	return mh;
+}
+
+/*
+ * Refill the free list of size class c by carving a large block into
+ * blocks of that class. Returns 0 on success, -1 if out of memory.
+ */
+static
+int
+__malloc_refill(unsigned c)
+{
+	struct mheader *mh, *mhnext;
+	struct mfree *mf;
+	uintptr_t end;
+	size_t bsize;
+	unsigned n, i;
+	int wastop;
+
+	bsize = __malloc_classsize[c] + MBLOCKSIZE;
+	n = MCHUNK / bsize;
+	if (n < 1) {
+		n = 1;
+	}
+
+	mh = __malloc_large(n * bsize - MBLOCKSIZE);
+	if (mh == NULL) {
+		return -1;
+	}
+	end = (uintptr_t) M_NEXT(mh);
+	wastop = (mh == __malloc_top);
+
+	/*
+	 * Cut it up. If split left a little extra, the last block
+	 * keeps it.
+	 */
+	for (i=0; i<n; i++) {
+		mh->mh_small = 1;
+		mh->mh_inuse = 0;
+		if (i < n-1) {
+			mh->mh_nextblock = M_MKFIELD(bsize);
+			mhnext = M_NEXT(mh);
+			mhnext->mh_prevblock = M_MKFIELD(bsize);
+			mhnext->mh_magic1 = MMAGIC;
+			mhnext->mh_magic2 = MMAGIC;
+		}
+		else {
+			mh->mh_nextblock = M_MKFIELD(end - (uintptr_t)mh);
+			mhnext = NULL;
+		}
+
+		mf = M_DATA(mh);
+		mf->mf_next = __malloc_smallfree[c];
+		__malloc_smallfree[c] = mf;
+
+		if (mhnext != NULL) {
+			mh = mhnext;
+		}
+	}
+
+	if (wastop) {
+		__malloc_top = mh;
+	}
+	else {
+		((struct mheader *)end)->mh_prevblock = mh->mh_nextblock;
+	}
+	return 0;
 }
 
 /*
@@ -333,8 +652,8 @@ void *
 malloc(size_t size)
 {
 	struct mheader *mh;
-	uintptr_t i;
-	size_t rightprevblock;
+	struct mfree *mf;
+	unsigned c;
 
 	if (__heapbase==0) {
 		__malloc_init();
@@ -351,74 +670,37 @@ malloc(size_t size)
 	__malloc_dump();
 #endif
 
+	if (size > MMAXSIZE) {
+		return NULL;
+	}
+
 	/* Round size up to an integral number of blocks. */
 	size = ((size + MBLOCKSIZE - 1) & ~(size_t)(MBLOCKSIZE-1));
 
-	/*
-	 * First-fit search algorithm for available blocks.
-	 * Check to make sure the next/previous sizes all agree.
-	 */
-	rightprevblock = 0;
-	for (i=__heapbase; i<__heaptop; i += M_NEXTOFF(mh)) {
-		mh = (struct mheader *) i;
-		if (!M_OK(mh)) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad magic bits",
-			     (unsigned long) i);
-		}
-		if (mh->mh_prevblock != rightprevblock) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad previous-block size %lu "
-			     "(should be %lu)",
-			     (unsigned long) i, 
-			     (unsigned long) mh->mh_prevblock << MBLOCKSHIFT,
-			     (unsigned long) rightprevblock << MBLOCKSHIFT);
-		}
-		rightprevblock = mh->mh_nextblock;
-
-		/* Can't allocate a block that's in use. */
-		if (mh->mh_inuse) {
-			continue;
+	if (size <= MSMALLMAX) {
+		c = __malloc_classof[size/MBLOCKSIZE];
+		if (__malloc_smallfree[c] == NULL && __malloc_refill(c) < 0) {
+			return NULL;
 		}
-
-		/* Can't allocate a block that isn't big enough. */
-		if (M_SIZE(mh) < size) {
-			continue;
+		mf = __malloc_smallfree[c];
+		__malloc_smallfree[c] = mf->mf_next;
+		mh = MF_HEADER(mf);
+		if (!M_OK(mh) || mh->mh_inuse || !mh->mh_small) {
+			errx(1, "malloc: Heap corrupt; bad block %p on"
+			     " size class %u list", mf, c);
 		}
-
-		/* Try splitting block. */
-		__malloc_split(mh, size);
-
-		/*
-		 * Now, allocate.
-		 */
-		mh->mh_inuse = 1;
-
-#ifdef MALLOCDEBUG
-		warnx("malloc: allocating at %p", M_DATA(mh));
-		__malloc_dump();
-#endif
-		return M_DATA(mh);
 	}
-	if (i!=__heaptop) {
-		errx(1, "malloc: Heap corrupt; ran off end");
+	else {
+		mh = __malloc_large(size);
+		if (mh == NULL) {
+			return NULL;
+		}
 	}
 
 	/*
-	 * Didn't find anything. Expand the heap.
+	 * Now, allocate.
 	 */
-
-	mh = __malloc_sbrk(size + MBLOCKSIZE);
-	if (mh == NULL) {
-		return NULL;
-	}
-
-	mh->mh_prevblock = rightprevblock;
-	mh->mh_magic1 = MMAGIC;
-	mh->mh_magic2 = MMAGIC;
-	mh->mh_pad = 0;
 	mh->mh_inuse = 1;
-	mh->mh_nextblock = M_MKFIELD(size + MBLOCKSIZE);
 
 #ifdef MALLOCDEBUG
 	warnx("malloc: allocating at %p", M_DATA(mh));
@@ -430,49 +712,65 @@ malloc(size_t size)
 ////////////////////////////////////////////////////////////
 
 /*
- * Clear a range of memory with 0xdeadbeef.
- * ptr must be suitably aligned.
+ * Merge two adjacent free large blocks (mh below mhnext), neither of
+ * which is in a bin.
  */
 static
 void
-__malloc_deadbeef(void *ptr, size_t size)
+__malloc_merge(struct mheader *mh, struct mheader *mhnext)
 {
-	uint32_t *x = ptr;
-	size_t i, n = size/sizeof(uint32_t);
-	for (i=0; i<n; i++) {
-		x[i] = 0xdeadbeef;
+	if (mh->mh_nextblock != mhnext->mh_prevblock) {
+		errx(1, "free: Heap corrupt (%p and %p inconsistent)",
+		     mh, mhnext);
 	}
+
+	mh->mh_nextblock = M_MKFIELD(MBLOCKSIZE + M_SIZE(mh) +
+				     MBLOCKSIZE + M_SIZE(mhnext));
+
+	if (mhnext == __malloc_top) {
+		__malloc_top = mh;
+	}
+	else {
+		M_NEXT(mh)->mh_prevblock = mh->mh_nextblock;
+	}
+
+#ifdef MALLOCDEBUG
+	/* Deadbeef out the memory used by the now-obsolete header */
+	__malloc_deadbeef(mhnext, sizeof(struct mheader));
+#endif
 }
 
 /*
- * Attempt to merge two adjacent blocks (mh below mhnext).
+ * Give back whole pages at the end of the heap if the free top
+ * block mh (not in a bin) has grown to MTRIM or more. Keep a page,
+ * so a program freeing and allocating at the top doesn't sbrk every
+ * time.
  */
 static
 void
-__malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
+__malloc_trim(struct mheader *mh)
 {
-	struct mheader *mhnextnext;
+	size_t release;
+	void *x;
 
-	if (mh->mh_nextblock != mhnext->mh_prevblock) {
-		errx(1, "free: Heap corrupt (%p and %p inconsistent)",
-		     mh, mhnext);
-	}
-	if (mh->mh_inuse || mhnext->mh_inuse) {
-		/* can't merge */
+	if (mh != __malloc_top || M_SIZE(mh) < MTRIM) {
 		return;
 	}
+	release = (M_SIZE(mh) - MPAGE) & ~(size_t)(MPAGE-1);
 
-	mhnextnext = M_NEXT(mhnext);
-
-	mh->mh_nextblock = M_MKFIELD(MBLOCKSIZE + M_SIZE(mh) +
-				     MBLOCKSIZE + M_SIZE(mhnext));
-
-	if (mhnextnext != (struct mheader *)__heaptop) {
-		mhnextnext->mh_prevblock = mh->mh_nextblock;
+	x = sbrk(-(int)release);
+	if (x == (void *)-1) {
+		/* just keep it */
+		return;
 	}
-
-	/* Deadbeef out the memory used by the now-obsolete header */
-	__malloc_deadbeef(mhnext, sizeof(struct mheader));
+	if ((uintptr_t)x != __heaptop) {
+		errx(1, "free: Internal error - "
+		     "heap top moved itself from 0x%lx to 0x%lx",
+		     (unsigned long) __heaptop,
+		     (unsigned long) (uintptr_t) x);
+	}
+	__heaptop -= release;
+	mh->mh_nextblock = M_MKFIELD(M_NEXTOFF(mh) - release);
 }
 
 /*
@@ -482,6 +780,8 @@ void
 free(void *x)
 {
 	struct mheader *mh, *mhnext, *mhprev;
+	struct mfree *mf;
+	unsigned c;
 
 	if (x==NULL) {
 		/* safest practice */
@@ -517,23 +817,99 @@ free(void *x)
 	/* mark it free */
 	mh->mh_inuse = 0;
 
+#ifdef MALLOCDEBUG
 	/* wipe it */
 	__malloc_deadbeef(M_DATA(mh), M_SIZE(mh));
+#endif
+
+	if (mh->mh_small) {
+		/*
+		 * Back on its class list. The class is the largest one
+		 * that fits, since a block may be a little oversized.
+		 */
+		if (M_SIZE(mh) > MSMALLMAX) {
+			c = MNCLASSES - 1;
+		}
+		else {
+			c = __malloc_classof[M_SIZE(mh)/MBLOCKSIZE];
+			if (__malloc_classsize[c] > M_SIZE(mh)) {
+				c--;
+			}
+		}
+		mf = M_DATA(mh);
+		mf->mf_next = __malloc_smallfree[c];
+		__malloc_smallfree[c] = mf;
+		return;
+	}
+
+	__malloc_check(mh, "free");
 
 	/* Try merging with the block above (but not if we're at the top) */
-	mhnext = M_NEXT(mh);
-	if (mhnext != (struct mheader *)__heaptop) {
-		__malloc_trymerge(mh, mhnext);
+	if (mh != __malloc_top) {
+		mhnext = M_NEXT(mh);
+		if (M_FREEBIG(mhnext)) {
+			__malloc_binremove(mhnext);
+			__malloc_merge(mh, mhnext);
+		}
 	}
 
 	/* Try merging with the block below (but not if we're at the bottom) */
 	if (mh != (struct mheader *)__heapbase) {
 		mhprev = M_PREV(mh);
-		__malloc_trymerge(mhprev, mh);
+		if (M_FREEBIG(mhprev)) {
+			__malloc_binremove(mhprev);
+			__malloc_merge(mhprev, mh);
+			mh = mhprev;
+		}
 	}
 
+	__malloc_trim(mh);
+	__malloc_binadd(mh);
+
 #ifdef MALLOCDEBUG
 	warnx("free: freed %p", x);
 	__malloc_dump();
 #endif
 }
+
+////////////////////////////////////////////////////////////
+
+/*
+ * Heap statistics. This walks the whole heap.
+ */
+struct mallinfo
+mallinfo(void)
+{
+	struct mallinfo mi;
+	struct mheader *mh;
+	uintptr_t i;
+
+	mi.arena = __heaptop - __heapbase;
+	mi.ordblks = mi.smblks = 0;
+	mi.uordblks = mi.fordblks = mi.fsmblks = 0;
+	mi.keepcost = 0;
+
+	for (i=__heapbase; i<__heaptop; i += M_NEXTOFF(mh)) {
+		mh = (struct mheader *) i;
+		if (!M_OK(mh)) {
+			errx(1, "mallinfo: Heap corrupt; header at 0x%lx"
+			     " has bad magic bits",
+			     (unsigned long) i);
+		}
+		if (mh->mh_inuse) {
+			mi.uordblks += M_SIZE(mh);
+		}
+		else if (mh->mh_small) {
+			mi.smblks++;
+			mi.fsmblks += M_SIZE(mh);
+		}
+		else {
+			mi.ordblks++;
+			mi.fordblks += M_SIZE(mh);
+			if (mh == __malloc_top) {
+				mi.keepcost = M_SIZE(mh);
+			}
+		}
+	}
+	return mi;
+}
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/wait.h>
 
 /*
  * system(): ANSI C
@@ -74,18 +75,18 @@ system(const char *cmd)
 
 	argv[nargs] = NULL;
 
-	pid = fork();
-	switch (pid) {
-	    case -1:
+	/*
+	 * Start the program in one step rather than fork then exec, so
+	 * we don't copy our address space just to throw it away. If it
+	 * can't be run, report it the way a child whose exec failed
+	 * would have.
+	 */
+	pid = spawn(argv[0], argv);
+	if (pid < 0) {
+		return _MKWAIT_EXIT(255);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
 		return -1;
-	    case 0:
-		/* child */
-		execv(argv[0], argv);
-		/* exec only returns if it fails */
-		_exit(255);
-	    default:
-		/* parent */
-		waitpid(pid, &status, 0);
-		return status;
 	}
+	return status;
 }
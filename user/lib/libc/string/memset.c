@@ -27,6 +27,7 @@
  * SUCH DAMAGE.
  */
 
+#include <stdint.h>
 #include <string.h>
 
 /*
@@ -36,11 +37,45 @@
 void *
 memset(void *ptr, int ch, size_t len)
 {
-	char *p = ptr;
-	size_t i;
-	
-	for (i=0; i<len; i++) {
-		p[i] = ch;
+	unsigned char *p = ptr;
+	unsigned long *lp, w;
+	size_t nwords;
+
+	/*
+	 * As in bzero: bytes until aligned, then words eight at a
+	 * time, then the leftover bytes. The word is the byte copied
+	 * into every position.
+	 */
+
+	if (len >= 2*sizeof(unsigned long)) {
+		while ((uintptr_t)p % sizeof(unsigned long) != 0) {
+			*p++ = ch;
+			len--;
+		}
+		w = (unsigned char)ch * (~0UL / 0xff);
+		lp = (unsigned long *)p;
+		nwords = len / sizeof(unsigned long);
+		len -= nwords * sizeof(unsigned long);
+		for (; nwords >= 8; nwords -= 8) {
+			lp[0] = w;
+			lp[1] = w;
+			lp[2] = w;
+			lp[3] = w;
+			lp[4] = w;
+			lp[5] = w;
+			lp[6] = w;
+			lp[7] = w;
+			lp += 8;
+		}
+		for (; nwords > 0; nwords--) {
+			*lp++ = w;
+		}
+		p = (unsigned char *)lp;
+	}
+
+	while (len > 0) {
+		*p++ = ch;
+		len--;
 	}
 
 	return ptr;
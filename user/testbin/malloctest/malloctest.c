@@ -43,6 +43,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <err.h>
+#include <malloc.h>
 
 
 #define _PATH_RANDOM   "random:"
@@ -621,6 +622,89 @@ test7(void)
 	test567(7, seed);
 }
 
+/*
+ * Test 8
+ *
+ * Throughput test. Times a long run of random malloc/free pairs over
+ * a working set of 256 slots, mostly small sizes with some large
+ * ones, and prints the rate and the heap statistics before and after.
+ * Every block is written when allocated so the pages are really used.
+ */
+
+static
+void
+printinfo(const char *when)
+{
+	struct mallinfo mi;
+
+	mi = mallinfo();
+	printf("%s: arena %lu inuse %lu free %lu/%lu (small %lu/%lu) "
+	       "top %lu\n", when,
+	       (unsigned long) mi.arena, (unsigned long) mi.uordblks,
+	       (unsigned long) mi.fordblks, (unsigned long) mi.ordblks,
+	       (unsigned long) mi.fsmblks, (unsigned long) mi.smblks,
+	       (unsigned long) mi.keepcost);
+}
+
+static
+void
+test8(void)
+{
+	static const int sizes[8] = { 8, 16, 24, 40, 100, 300, 2000, 9000 };
+
+	void *ptrs[256];
+	time_t s0, s1;
+	unsigned long ns0, ns1, usecs, ops;
+	int i, n;
+
+	printf("Beginning malloc test 8\n");
+	srandom(8);
+	printinfo("before");
+
+	for (i=0; i<256; i++) {
+		ptrs[i] = NULL;
+	}
+
+	ops = 0;
+	__time(&s0, &ns0);
+	for (i=0; i<200000; i++) {
+		n = random()%256;
+		if (ptrs[n] == NULL) {
+			/* three in four requests are 100 bytes or less */
+			ptrs[n] = malloc(sizes[random()%8 < 6 ? random()%5 :
+					       5 + random()%3]);
+			if (ptrs[n] == NULL) {
+				printf("malloc failed after %lu operations\n",
+				       ops);
+				break;
+			}
+			*(volatile char *)ptrs[n] = (char)n;
+		}
+		else {
+			free(ptrs[n]);
+			ptrs[n] = NULL;
+		}
+		ops++;
+	}
+	__time(&s1, &ns1);
+
+	printinfo("during");
+	for (i=0; i<256; i++) {
+		free(ptrs[i]);
+	}
+	printinfo("after");
+
+	usecs = (s1 - s0) * 1000000 + ns1 / 1000 - ns0 / 1000;
+	printf("%lu operations in %lu.%06lu seconds", ops,
+	       usecs / 1000000, usecs % 1000000);
+	if (usecs > 0) {
+		printf(", %lu per second",
+		       (unsigned long)((unsigned long long)ops * 1000000 / usecs));
+	}
+	printf("\n");
+	printf("Passed malloc test 8\n");
+}
+
 ////////////////////////////////////////////////////////////
 
 static struct {
@@ -635,6 +719,7 @@ static struct {
 	{ 5, "Stress test", test5 },
 	{ 6, "Randomized stress test", test6 },
 	{ 7, "Stress test with particular seed", test7 },
+	{ 8, "Throughput test", test8 },
 	{ -1, NULL, NULL }
 };
 
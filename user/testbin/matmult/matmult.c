@@ -58,13 +58,16 @@ main()
 {
     int i, j, k, r;
 
+    bench_begin(1);			/* benchmark region 1: init */
     for (i = 0; i < Dim; i++)		/* first initialize the matrices */
 	for (j = 0; j < Dim; j++) {
 	     A[i][j] = i;
 	     B[i][j] = j;
 	     C[i][j] = 0;
 	}
+    bench_end(1);
 
+    bench_begin(2);			/* region 2: multiply and sum */
     for (i = 0; i < Dim; i++)		/* then multiply them together */
 	for (j = 0; j < Dim; j++)
             for (k = 0; k < Dim; k++)
@@ -74,6 +77,7 @@ main()
 	for (j = 0; j < Dim; j++)
             for (k = 0; k < Dim; k++)
 		C[i][j] += T[i][j][k];
+    bench_end(2);
 
     r = 0;
     for (i = 0; i < Dim; i++)
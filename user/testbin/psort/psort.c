@@ -34,11 +34,17 @@
  * because of various limitations of OS/161 it is massively
  * inefficient. But that's ok; the goal is to stress the VM and buffer
  * cache.
+ *
+ * The worker processes hand back their results in files. With -m the
+ * validation results come back through a shared anonymous mapping
+ * instead, and the closing parallel checksum is always run both ways
+ * and timed, to compare the two kinds of exchange.
  */
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -68,6 +74,7 @@ static const char *progname;
 static int numprocs = 4;
 static int numkeys = 10000;
 static long randomseed = 15432753;
+static int useshm = 0;
 
 static off_t correctsize;
 static unsigned long checksum;
@@ -908,6 +915,37 @@ validname(int a)
 	return rv;
 }
 
+/* Validation results, when they come back through shared memory. */
+static int *validshared;
+
+/*
+ * Get a zeroed mapping of LEN bytes that fork shares rather than
+ * copies.
+ */
+static
+void *
+doshared(size_t len)
+{
+	void *p;
+
+	p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+	if (p == MAP_FAILED) {
+		complain("mmap");
+		exit(1);
+	}
+	return p;
+}
+
+static
+void
+dounshared(void *p, size_t len)
+{
+	if (munmap(p, len) < 0) {
+		complain("munmap");
+		exit(1);
+	}
+}
+
 static
 void
 checksize_valid(void)
@@ -983,6 +1021,12 @@ dovalidate(void)
 	}
 	doclose(name, fd);
 
+	if (validshared != NULL) {
+		validshared[me*2] = smallest;
+		validshared[me*2+1] = largest;
+		return;
+	}
+
 	name = validname(me);
 	fd = doopen(name, O_WRONLY|O_CREAT|O_TRUNC, 0664);
 	dowrite(name, fd, &smallest, sizeof(smallest));
@@ -998,17 +1042,29 @@ validate(void)
 	int i, fd;
 	const char *name;
 
+	if (useshm) {
+		validshared = doshared(numprocs*2*sizeof(int));
+	}
 	doforkall("Validation", dovalidate);
-	checksize_valid();
+	if (validshared == NULL) {
+		checksize_valid();
+	}
 
 	prev_largest = 1;
 
 	for (i=0; i<numprocs; i++) {
-		name = validname(i);
-		fd = doopen(name, O_RDONLY, 0);
+		if (validshared != NULL) {
+			smallest = validshared[i*2];
+			largest = validshared[i*2+1];
+		}
+		else {
+			name = validname(i);
+			fd = doopen(name, O_RDONLY, 0);
 
-		doexactread(name, fd, &smallest, sizeof(int));
-		doexactread(name, fd, &largest, sizeof(int));
+			doexactread(name, fd, &smallest, sizeof(int));
+			doexactread(name, fd, &largest, sizeof(int));
+			doclose(name, fd);
+		}
 
 		if (smallest < 1) {
 			complainx("Validation: block %d: bad SMALLEST", i);
@@ -1034,6 +1090,11 @@ validate(void)
 		}
 	}
 
+	if (validshared != NULL) {
+		dounshared(validshared, numprocs*2*sizeof(int));
+		validshared = NULL;
+		return;
+	}
 
 	for (i=0; i<numprocs; i++) {
 		doremove(validname(i));
@@ -1042,6 +1103,135 @@ validate(void)
 
 ////////////////////////////////////////////////////////////
 
+/* Partial sums, when they come back through shared memory. */
+static unsigned long *psumshared;
+
+static
+const char *
+psumname(int a)
+{
+	static char rv[32];
+	snprintf(rv, sizeof(rv), "psum-%d", a);
+	return rv;
+}
+
+/*
+ * Checksum our share of the sorted output, the same way checksum_file
+ * does the whole thing.
+ */
+static
+unsigned long
+psum_mine(void)
+{
+	const char *name;
+	unsigned char *bytes;
+	int fd, mykeys, keys_done, keys_to_do;
+	size_t i;
+	unsigned long sum = 0;
+
+	name = PATH_SORTED;
+	fd = doopen(name, O_RDONLY, 0);
+
+	mykeys = getmykeys();
+	seekmyplace(name, fd);
+
+	bytes = (unsigned char *)workspace;
+	keys_done = 0;
+	while (keys_done < mykeys) {
+		keys_to_do = mykeys - keys_done;
+		if (keys_to_do > WORKNUM) {
+			keys_to_do = WORKNUM;
+		}
+		doexactread(name, fd, workspace, keys_to_do * sizeof(int));
+		for (i=0; i<keys_to_do * sizeof(int); i++) {
+			sum += bytes[i];
+		}
+		keys_done += keys_to_do;
+	}
+	doclose(name, fd);
+	return sum;
+}
+
+static
+void
+dopsum_file(void)
+{
+	const char *name;
+	unsigned long sum;
+	int fd;
+
+	sum = psum_mine();
+	name = psumname(me);
+	fd = doopen(name, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	dowrite(name, fd, &sum, sizeof(sum));
+	doclose(name, fd);
+}
+
+static
+void
+dopsum_shared(void)
+{
+	psumshared[me] = psum_mine();
+}
+
+static
+unsigned long
+usecs(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs*1000000 + nsecs/1000;
+}
+
+/*
+ * Checksum the output in parallel twice, once handing the partial
+ * sums back in files and once in shared memory, and time both.
+ */
+static
+void
+parsum(void)
+{
+	const char *name;
+	unsigned long filesum, shmsum, part, start, filetime, shmtime;
+	int i, fd;
+
+	start = usecs();
+	doforkall("Parallel sum (files)", dopsum_file);
+	filesum = 0;
+	for (i=0; i<numprocs; i++) {
+		name = psumname(i);
+		fd = doopen(name, O_RDONLY, 0);
+		doexactread(name, fd, &part, sizeof(part));
+		doclose(name, fd);
+		doremove(name);
+		filesum += part;
+	}
+	filetime = usecs() - start;
+
+	start = usecs();
+	psumshared = doshared(numprocs * sizeof(unsigned long));
+	doforkall("Parallel sum (shared memory)", dopsum_shared);
+	shmsum = 0;
+	for (i=0; i<numprocs; i++) {
+		shmsum += psumshared[i];
+	}
+	dounshared(psumshared, numprocs * sizeof(unsigned long));
+	psumshared = NULL;
+	shmtime = usecs() - start;
+
+	complainx("Parallel sum: files %lu usec, shared memory %lu usec",
+		  filetime, shmtime);
+	if (filesum != checksum || shmsum != checksum) {
+		complainx("Parallel sums do not match (%lu, %lu, should be "
+			  "%lu)", filesum, shmsum, checksum);
+		exit(1);
+	}
+}
+
+////////////////////////////////////////////////////////////
+
 static
 void
 setdir(void)
@@ -1085,7 +1275,8 @@ static
 void
 usage(void)
 {
-	complain("Usage: %s [-p procs] [-k keys] [-s seed] [-r]", progname);
+	complain("Usage: %s [-p procs] [-k keys] [-s seed] [-r] [-m]",
+		 progname);
 	exit(1);
 }
 
@@ -1106,6 +1297,7 @@ doargs(int argc, char *argv[])
 		    case 'k': arg = 1; break;
 		    case 's': arg = 1; break;
 		    case 'r': arg = 0; break;
+		    case 'm': arg = 0; break;
 		    default: usage(); return;
 		}
 		if (arg) {
@@ -1131,6 +1323,7 @@ doargs(int argc, char *argv[])
 		else {
 			switch (ch) {
 			    case 'r': randomize(); break;
+			    case 'm': useshm = 1; break;
 			    default: assert(0); break;
 			}
 		}
@@ -1147,9 +1340,19 @@ main(int argc, char *argv[])
 
 	setdir();
 
+	/* each phase is a benchmark region, numbered in order */
+	bench_begin(1);
 	genkeys();
+	bench_end(1);
+	bench_begin(2);
 	sort();
+	bench_end(2);
+	bench_begin(3);
 	validate();
+	bench_end(3);
+	bench_begin(4);
+	parsum();
+	bench_end(4);
 	complainx("Succeeded.");
 
 	unsetdir();
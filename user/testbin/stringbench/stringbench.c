@@ -0,0 +1,234 @@
+/*
+ * stringbench - time the libc memory and string routines.
+ *
+ * Usage: stringbench [-c]
+ *
+ * For each size from 8 bytes to 64K, doubling, times memcpy with
+ * aligned and misaligned source, memmove with overlapping buffers,
+ * memset, bzero, strlen and strcmp, and prints nanoseconds per call
+ * and bytes per microsecond. Each size does about a megabyte of
+ * work per routine, so small sizes mostly measure call overhead.
+ *
+ * First checks the routines against simple byte loops at every
+ * alignment, for lengths up to a few words; -c does only that.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define MINSIZE   8
+#define MAXSIZE   (64*1024)
+#define WORK      (1024*1024)
+#define SLOP      16	/* room for misaligning */
+
+static char buf1[MAXSIZE + SLOP];
+static char buf2[MAXSIZE + SLOP];
+static char ref[MAXSIZE + SLOP];
+
+static
+unsigned long long
+nsecs(void)
+{
+	time_t secs;
+	unsigned long ns;
+
+	__time(&secs, &ns);
+	return (unsigned long long)secs * 1000000000ULL + ns;
+}
+
+static
+void
+scramble(char *p, size_t len, unsigned seed)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		seed = seed * 1103515245 + 12345;
+		p[i] = (seed >> 16) | 1;	/* never zero */
+	}
+}
+
+////////////////////////////////////////////////////////////
+// correctness
+
+static
+int
+check(void)
+{
+	char tmp[64];
+	unsigned so, dof, len, i, bad = 0;
+
+	for (so=0; so<8; so++) {
+		for (dof=0; dof<8; dof++) {
+			for (len=0; len<64; len++) {
+				/* memcpy */
+				scramble(buf1, 128, len);
+				scramble(buf2, 128, len+1);
+				memcpy(ref, buf2, 128);
+				for (i=0; i<len; i++) {
+					ref[dof+i] = buf1[so+i];
+				}
+				memcpy(buf2+dof, buf1+so, len);
+				bad += memcmp(ref, buf2, 128) != 0;
+
+				/* memmove, both directions */
+				memcpy(ref, buf1, 128);
+				for (i=0; i<len; i++) {
+					tmp[i] = ref[32+so+i];
+				}
+				for (i=0; i<len; i++) {
+					ref[32+dof+i] = tmp[i];
+				}
+				memmove(buf1+32+dof, buf1+32+so, len);
+				bad += memcmp(ref, buf1, 128) != 0;
+				for (i=0; i<len; i++) {
+					tmp[i] = ref[32+dof+i];
+				}
+				for (i=0; i<len; i++) {
+					ref[32+so+i] = tmp[i];
+				}
+				memmove(buf1+32+so, buf1+32+dof, len);
+				bad += memcmp(ref, buf1, 128) != 0;
+
+				/* memset and bzero */
+				memcpy(ref, buf1, 128);
+				for (i=0; i<len; i++) {
+					ref[dof+i] = (char)so;
+				}
+				memset(buf1+dof, so, len);
+				bad += memcmp(ref, buf1, 128) != 0;
+				for (i=0; i<len; i++) {
+					ref[so+i] = 0;
+				}
+				bzero(buf1+so, len);
+				bad += memcmp(ref, buf1, 128) != 0;
+
+				/* strlen and strcmp */
+				scramble(buf1, 128, len+2);
+				buf1[so+len] = 0;
+				bad += strlen(buf1+so) != len;
+				memcpy(buf2+dof, buf1+so, len+1);
+				bad += strcmp(buf1+so, buf2+dof) != 0;
+				if (len > 0) {
+					/* change the last character; i says if B is now bigger */
+					i = (unsigned char)buf1[so+len-1];
+					buf2[dof+len-1] = i < 0xff ? i+1 : 0x7f;
+					i = i < 0xff;
+					bad += (strcmp(buf1+so, buf2+dof) < 0) != i;
+					bad += (strcmp(buf2+dof, buf1+so) > 0) != i;
+				}
+			}
+		}
+	}
+	if (bad) {
+		printf("stringbench: %u checks FAILED\n", bad);
+		return 1;
+	}
+	printf("stringbench: all checks passed\n");
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// timing
+
+enum op { MEMCPY, MEMCPY_UNALIGNED, MEMMOVE, MEMSET, BZERO, STRLEN, STRCMP };
+
+static const char *const opnames[] = {
+	"memcpy", "memcpy+1", "memmove", "memset", "bzero", "strlen",
+	"strcmp",
+};
+#define NOPS (sizeof(opnames) / sizeof(opnames[0]))
+
+static volatile size_t sink;
+
+static
+void
+run(enum op op, size_t size, unsigned reps)
+{
+	unsigned i;
+
+	switch (op) {
+	    case MEMCPY:
+		for (i=0; i<reps; i++) {
+			memcpy(buf2, buf1, size);
+		}
+		break;
+	    case MEMCPY_UNALIGNED:
+		for (i=0; i<reps; i++) {
+			memcpy(buf2, buf1+1, size);
+		}
+		break;
+	    case MEMMOVE:
+		for (i=0; i<reps; i++) {
+			memmove(buf1+SLOP/2, buf1, size);
+		}
+		break;
+	    case MEMSET:
+		for (i=0; i<reps; i++) {
+			memset(buf2, i, size);
+		}
+		break;
+	    case BZERO:
+		for (i=0; i<reps; i++) {
+			bzero(buf2, size);
+		}
+		break;
+	    case STRLEN:
+		for (i=0; i<reps; i++) {
+			sink += strlen(buf1);
+		}
+		break;
+	    case STRCMP:
+		for (i=0; i<reps; i++) {
+			sink += strcmp(buf1, buf2);
+		}
+		break;
+	}
+}
+
+static
+void
+bench(void)
+{
+	unsigned long long start, ns;
+	unsigned reps, op;
+	size_t size;
+
+	printf("%-9s %6s %10s %10s\n", "op", "size", "ns/call", "bytes/us");
+	for (op=0; op<NOPS; op++) {
+		for (size=MINSIZE; size<=MAXSIZE; size *= 2) {
+			scramble(buf1, sizeof(buf1), size);
+			if (op == STRLEN || op == STRCMP) {
+				/* strings of SIZE bytes; strcmp runs to the end */
+				buf1[size-1] = 0;
+				memcpy(buf2, buf1, size);
+			}
+			reps = WORK / size;
+
+			start = nsecs();
+			run(op, size, reps);
+			ns = nsecs() - start;
+
+			printf("%-9s %6lu %10llu %10llu\n", opnames[op],
+			       (unsigned long)size, ns / reps,
+			       ns ? (unsigned long long)size * reps * 1000 / ns
+			       : 0);
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (check()) {
+		return 1;
+	}
+	if (argc > 1 && !strcmp(argv[1], "-c")) {
+		return 0;
+	}
+	bench();
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * ubench - the user-level half of the kernel menu's bench command.
+ *
+ * Usage: ubench [syscall|fork reps]
+ *
+ * With no arguments, exits at once; bench exec runs it that way.
+ * Otherwise times REPS samples of
+ *
+ *   syscall   a batch of BATCH getpid calls
+ *   fork      fork, _exit in the child, and waitpid
+ *
+ * and prints a line in the same format as the kernel side (see
+ * kern/test/bench.c), with times per operation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/wait.h>
+
+/* CPU_FREQUENCY in the kernel, in MHz */
+#define MHZ      25
+#define BATCH    100
+#define MAXREPS  10000
+
+static unsigned long long samples[MAXREPS];
+
+static
+unsigned long long
+nsecs(void)
+{
+	time_t secs;
+	unsigned long ns;
+
+	__time(&secs, &ns);
+	return (unsigned long long)secs * 1000000000ULL + ns;
+}
+
+static
+void
+printtime(const char *what, unsigned long long ns)
+{
+	printf(" %s_us=%llu.%03llu", what, ns / 1000, ns % 1000);
+}
+
+static
+void
+report(const char *name, unsigned n)
+{
+	unsigned long long t, min, med, max;
+	unsigned i, j;
+
+	for (i=1; i<n; i++) {
+		t = samples[i];
+		for (j=i; j>0 && samples[j-1] > t; j--) {
+			samples[j] = samples[j-1];
+		}
+		samples[j] = t;
+	}
+	min = samples[0];
+	med = samples[n / 2];
+	max = samples[n - 1];
+
+	printf("bench %s n=%u min_cyc=%llu med_cyc=%llu max_cyc=%llu",
+	       name, n, min * MHZ / 1000, med * MHZ / 1000, max * MHZ / 1000);
+	printtime("min", min);
+	printtime("med", med);
+	printtime("max", max);
+	printf("\n");
+}
+
+static
+void
+dosyscall(unsigned reps)
+{
+	unsigned long long start;
+	unsigned r, i;
+
+	for (r=0; r<reps; r++) {
+		start = nsecs();
+		for (i=0; i<BATCH; i++) {
+			getpid();
+		}
+		samples[r] = (nsecs() - start) / BATCH;
+	}
+	report("syscall", reps);
+}
+
+static
+void
+dofork(unsigned reps)
+{
+	unsigned long long start;
+	unsigned r;
+	pid_t pid;
+	int status;
+
+	for (r=0; r<reps; r++) {
+		start = nsecs();
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		samples[r] = nsecs() - start;
+	}
+	report("fork", reps);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned reps;
+
+	if (argc == 1) {
+		return 0;
+	}
+	if (argc != 3) {
+		errx(1, "Usage: ubench [syscall|fork reps]");
+	}
+	reps = atoi(argv[2]);
+	if (reps == 0 || reps > MAXREPS) {
+		errx(1, "reps must be 1 to %u", MAXREPS);
+	}
+
+	if (!strcmp(argv[1], "syscall")) {
+		dosyscall(reps);
+	}
+	else if (!strcmp(argv[1], "fork")) {
+		dofork(reps);
+	}
+	else {
+		errx(1, "unknown test %s", argv[1]);
+	}
+	return 0;
+}
@@ -4,9 +4,38 @@
  *
  * Intended for the basic system calls assignment. This may help
  * debugging the argument handling of execv().
+ *
+ * "argtest -q ARGS..." prints nothing and just checks that ARGS are
+ * the pattern argtesttest -b passes: all the same length, argument i
+ * made of the letter 'a' + i % 26. The exit status is 0 if so.
  */
 
 #include <stdio.h>
+#include <string.h>
+
+static
+int
+quietcheck(int argc, char *argv[])
+{
+	size_t len;
+	int i, j;
+
+	if (argc < 3) {
+		return 0;
+	}
+	len = strlen(argv[2]);
+	for (i=2; i<argc; i++) {
+		for (j=0; argv[i][j] != 0; j++) {
+			if (argv[i][j] != 'a' + (i - 2) % 26) {
+				return 1;
+			}
+		}
+		if ((size_t)j != len) {
+			return 1;
+		}
+	}
+	return argv[argc] == NULL ? 0 : 1;
+}
 
 int
 main(int argc, char *argv[])
@@ -14,6 +43,10 @@ main(int argc, char *argv[])
 	const char *tmp;
 	int i;
 
+	if (argc > 1 && strcmp(argv[1], "-q") == 0) {
+		return quietcheck(argc, argv);
+	}
+
 	printf("argc   : %d\n", argc);
 	printf("&tmp   : %p\n", &tmp);
 	printf("&i     : %p\n", &i);
@@ -5,15 +5,37 @@
  *
  *   relies on fork, execv
  *
+ *   "argtesttest -b [iterations]" instead times fork + execv + exit +
+ *   waitpid of "argtest -q" over a range of argument counts and
+ *   sizes, and prints one line per combination:
+ *
+ *	count size total usec-per-exec
+ *
+ *   Combinations that don't fit the 48k dumbvm user stack are skipped.
  */
 
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <err.h>
+#include <sys/wait.h>
 
 static char *xargv[4] = { (char *)"argtesttest", (char *)"first", (char *)"second", NULL };
 
+/* leave room on the new stack for argtest itself */
+#define BENCH_BUDGET   (40 * 1024)
+#define BENCH_MAXARGS  (BENCH_BUDGET / 8)
+#define BENCH_ITERS    20
+
+static char benchstrings[BENCH_BUDGET];
+static char *benchargv[BENCH_MAXARGS + 3];
+
+static const int benchcounts[] = { 1, 8, 64, 512 };
+static const int benchsizes[] = { 8, 64, 512, 4096 };
+
 static
-void
+pid_t
 spawnv(const char *prog, char **argv)
 {
   pid_t pid = fork();
@@ -28,11 +50,96 @@ spawnv(const char *prog, char **argv)
     /* parent */
     break;
   }
+  return pid;
+}
+
+static
+unsigned long long
+now_usecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000ULL + nsecs / 1000;
 }
 
+/*
+ * Build "argtest -q" plus COUNT arguments of SIZE characters each.
+ * Returns the bytes of argument data, including the pointer array.
+ */
+static
 int
-main()
+buildargs(int count, int size)
 {
+  char *p = benchstrings;
+  int i;
+
+  benchargv[0] = (char *)"argtest";
+  benchargv[1] = (char *)"-q";
+  for (i = 0; i < count; i++) {
+    memset(p, 'a' + i % 26, size);
+    p[size] = 0;
+    benchargv[i + 2] = p;
+    p += size + 1;
+  }
+  benchargv[count + 2] = NULL;
+  return (p - benchstrings) + (count + 3) * sizeof(char *) +
+    sizeof("argtest") + sizeof("-q");
+}
+
+static
+void
+bench(int iters)
+{
+  unsigned long long start, elapsed;
+  unsigned ci, si;
+  int count, size, total, i, status;
+  pid_t pid;
+
+  printf("%8s %8s %8s %12s\n", "count", "size", "total", "usec/exec");
+  for (ci = 0; ci < sizeof(benchcounts) / sizeof(benchcounts[0]); ci++) {
+    for (si = 0; si < sizeof(benchsizes) / sizeof(benchsizes[0]); si++) {
+      count = benchcounts[ci];
+      size = benchsizes[si];
+      if (count * (size + 1 + (int)sizeof(char *)) > BENCH_BUDGET) {
+        continue;
+      }
+      total = buildargs(count, size);
+
+      start = now_usecs();
+      for (i = 0; i < iters; i++) {
+        pid = spawnv("/uw-testbin/argtest", benchargv);
+        if (waitpid(pid, &status, 0) < 0) {
+          err(1, "waitpid");
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          errx(1, "argtest saw bad arguments (count %d size %d)",
+               count, size);
+        }
+      }
+      elapsed = now_usecs() - start;
+      printf("%8d %8d %8d %12llu\n", count, size, total, elapsed / iters);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = BENCH_ITERS;
+
+  if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+    if (argc > 2) {
+      iters = atoi(argv[2]);
+      if (iters <= 0) {
+        errx(1, "usage: argtesttest [-b [iterations]]");
+      }
+    }
+    bench(iters);
+    return 0;
+  }
+
   spawnv("/testbin/argtest", xargv);
   return 0;
 }
@@ -0,0 +1,228 @@
+/*
+ * futexbench.c
+ *
+ *	Checks the futex system calls and times the user-level mutex
+ *	built on them, uncontended and handed back and forth between two
+ *	processes.
+ *
+ *	Usage: futexbench [iterations]
+ *
+ *	Reported times are nanoseconds per operation:
+ *
+ *	  umutex       uncontended lock+unlock, all in user space
+ *	  futex_wake   slow-path unlock with nobody asleep
+ *	  futex_wait   wait on a word whose value has already changed
+ *	               (returns EAGAIN without sleeping)
+ *
+ *	and per acquisition, with a parent and child (iterations/10 each)
+ *	fighting over one lock in a shared anonymous page:
+ *
+ *	  c-umutex     the futex-based mutex; waiters sleep in the kernel
+ *	  c-spin       a test-and-set lock that spins until it gets it
+ *	  c-yield      the same, but a waiter that fails gives up the cpu
+ *	               with the shortest possible nanosleep (there is no
+ *	               sched_yield)
+ *
+ *	Each acquisition does a little work before releasing, so the lock
+ *	is held long enough to be contended.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../lib/testutils.h"
+#include "../lib/umutex.h"
+
+#define DEFAULT_ITERS 100000
+#define HOLD_LOOPS    20	/* work done holding the lock */
+
+#define LOCK_UMUTEX 0
+#define LOCK_SPIN   1
+#define LOCK_YIELD  2
+
+static struct umutex mtx = UMUTEX_INITIALIZER;
+static volatile int word;
+
+/* Shared between the processes of a contended run. */
+struct shared {
+  struct umutex sh_mtx;
+  volatile int sh_spin;		/* the test-and-set lock */
+  volatile int sh_count;	/* what the lock protects */
+};
+static struct shared *sh;
+
+static
+unsigned long long
+now_nsecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+report(const char *name, unsigned long long start, int iters)
+{
+  unsigned long long elapsed = now_nsecs() - start;
+
+  printf("futexbench: %-12s %8llu ns/op (%d ops)\n",
+         name, elapsed / iters, iters);
+}
+
+static
+void
+check(void)
+{
+  int rv;
+
+  TEST_EQUAL(umutex_trylock(&mtx), 1, "trylock of free mutex");
+  TEST_EQUAL(umutex_trylock(&mtx), 0, "trylock of held mutex");
+  umutex_unlock(&mtx);
+  TEST_EQUAL(mtx.um_word, 0, "unlock clears the word");
+
+  word = 5;
+  rv = futex_wait(&word, 4);
+  TEST_EQUAL(rv, -1, "futex_wait with stale value fails");
+  TEST_EQUAL(errno, EAGAIN, "futex_wait with stale value gives EAGAIN");
+
+  rv = futex_wait((volatile int *)((char *)&word + 1), 5);
+  TEST_EQUAL(rv, -1, "futex_wait on unaligned word fails");
+  TEST_EQUAL(errno, EINVAL, "futex_wait on unaligned word gives EINVAL");
+
+  rv = futex_wait(NULL, 0);
+  TEST_EQUAL(rv, -1, "futex_wait on NULL fails");
+  TEST_EQUAL(errno, EFAULT, "futex_wait on NULL gives EFAULT");
+
+  TEST_EQUAL(futex_wake(&word, 1), 0, "futex_wake with no waiters");
+
+  TEST_STATS();
+}
+
+static
+void
+spin_lock(int how)
+{
+  struct timespec ts;
+
+  while (atomic_xchg(&sh->sh_spin, 1) != 0) {
+    if (how == LOCK_YIELD) {
+      ts.tv_sec = 0;
+      ts.tv_nsec = 1;
+      nanosleep(&ts, NULL);
+    }
+  }
+}
+
+static
+void
+contend_loop(int how, int iters)
+{
+  int i, j;
+
+  for (i = 0; i < iters; i++) {
+    if (how == LOCK_UMUTEX) {
+      umutex_lock(&sh->sh_mtx);
+    }
+    else {
+      spin_lock(how);
+    }
+    for (j = 0; j < HOLD_LOOPS; j++) {
+      sh->sh_count++;
+    }
+    if (how == LOCK_UMUTEX) {
+      umutex_unlock(&sh->sh_mtx);
+    }
+    else {
+      atomic_xchg(&sh->sh_spin, 0);
+    }
+  }
+}
+
+/*
+ * Run the parent and a child through ITERS acquisitions each of the
+ * lock HOW, timing from the fork to the child's exit.
+ */
+static
+void
+contend(const char *name, int how, int iters)
+{
+  unsigned long long start;
+  int status;
+  pid_t pid;
+
+  sh->sh_count = 0;
+  start = now_nsecs();
+  pid = fork();
+  if (pid < 0) {
+    err(1, "fork");
+  }
+  contend_loop(how, iters);
+  if (pid == 0) {
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  report(name, start, 2 * iters);
+  TEST_EQUAL(status, _MKWAIT_EXIT(0), "child exits 0");
+  TEST_EQUAL(sh->sh_count, 2 * iters * HOLD_LOOPS, "no updates lost");
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned long long start;
+  int iters = DEFAULT_ITERS;
+  int i;
+
+  if (argc > 1) {
+    iters = atoi(argv[1]);
+    if (iters <= 0) {
+      printf("Usage: futexbench [iterations]\n");
+      exit(1);
+    }
+  }
+
+  check();
+
+  start = now_nsecs();
+  for (i = 0; i < iters; i++) {
+    umutex_lock(&mtx);
+    umutex_unlock(&mtx);
+  }
+  report("umutex", start, iters);
+
+  start = now_nsecs();
+  for (i = 0; i < iters; i++) {
+    futex_wake(&mtx.um_word, 1);
+  }
+  report("futex_wake", start, iters);
+
+  word = 1;
+  start = now_nsecs();
+  for (i = 0; i < iters; i++) {
+    futex_wait(&word, 0);
+  }
+  report("futex_wait", start, iters);
+
+  sh = mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANON, -1, 0);
+  if (sh == MAP_FAILED) {
+    err(1, "mmap");
+  }
+  umutex_init(&sh->sh_mtx);
+  sh->sh_spin = 0;
+
+  iters = iters / 10 > 0 ? iters / 10 : 1;
+  contend("c-umutex", LOCK_UMUTEX, iters);
+  contend("c-spin", LOCK_SPIN, iters);
+  contend("c-yield", LOCK_YIELD, iters);
+  TEST_STATS();
+
+  return 0;
+}
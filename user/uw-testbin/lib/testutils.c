@@ -15,6 +15,7 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
 #include "testutils.h"
 
 /* Used to track the number of tests and failures */
@@ -198,6 +199,42 @@ test_print_stats(const char *file, const char* func, int line)
   printf("\n");
 }
 
+/*
+ * Mark the start and end of a measured region for the simulator (see
+ * bench_begin). In verbose mode, also print how long it took.
+ */
+#define MAX_BENCH_ID 16
+static unsigned long long bench_start[MAX_BENCH_ID];
+
+static unsigned long long
+bench_now(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+void
+test_bench_begin(unsigned id)
+{
+  if (id < MAX_BENCH_ID) {
+    bench_start[id] = bench_now();
+  }
+  bench_begin(id);
+}
+
+void
+test_bench_end(unsigned id)
+{
+  bench_end(id);
+  if (verbose && id < MAX_BENCH_ID) {
+    printf("BENCH REGION %u : %llu usec\n",
+      id, (bench_now() - bench_start[id]) / 1000);
+  }
+}
+
 // #define UNIT_TEST
 #ifdef UNIT_TEST
 int
@@ -27,6 +27,13 @@
 #define TEST_VERBOSE_OFF() \
   test_verbose_off()
 
+/* Bracket a measured region; see bench_begin in unistd.h */
+#define TEST_BENCH_BEGIN(id) \
+  test_bench_begin(id)
+
+#define TEST_BENCH_END(id) \
+  test_bench_end(id)
+
 void test_equal(int ret_val, int expected_val, const char *str,
      const char *file, const char* func, int line);
 void test_equal_one_of(int val, int expected_val1, int expected_val2, const char *str, 
@@ -41,5 +48,7 @@ void test_print_stats(const char *file, const char* func, int line);
 void test_reset_stats(void);
 void test_verbose_on(void);
 void test_verbose_off(void);
+void test_bench_begin(unsigned id);
+void test_bench_end(unsigned id);
 
 #endif /* TESTUTILS_H */
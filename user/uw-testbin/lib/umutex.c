@@ -0,0 +1,100 @@
+/*
+ * User-level mutex on top of futexes. See umutex.h.
+ *
+ * The algorithm is the usual three-state one (Drepper, "Futexes Are
+ * Tricky", mutex 2).
+ */
+
+#include <unistd.h>
+#include "umutex.h"
+
+/*
+ * Atomic compare-and-swap and exchange using ll/sc. The assembler
+ * defaults to MIPS-I, which doesn't have them, hence the .set mips32.
+ */
+int
+atomic_cas(volatile int *p, int old, int new)
+{
+  int prev, tmp;
+
+  __asm volatile(
+    ".set push;"
+    ".set mips32;"
+    ".set noreorder;"
+    "1: ll %0, 0(%2);"
+    "bne %0, %3, 2f;"
+    " move %1, %4;"
+    "sc %1, 0(%2);"
+    "beqz %1, 1b;"
+    " nop;"
+    "2: .set pop"
+    : "=&r" (prev), "=&r" (tmp)
+    : "r" (p), "r" (old), "r" (new)
+    : "memory");
+  return prev;
+}
+
+int
+atomic_xchg(volatile int *p, int new)
+{
+  int prev, tmp;
+
+  __asm volatile(
+    ".set push;"
+    ".set mips32;"
+    ".set noreorder;"
+    "1: ll %0, 0(%2);"
+    "move %1, %3;"
+    "sc %1, 0(%2);"
+    "beqz %1, 1b;"
+    " nop;"
+    ".set pop"
+    : "=&r" (prev), "=&r" (tmp)
+    : "r" (p), "r" (new)
+    : "memory");
+  return prev;
+}
+
+void
+umutex_init(struct umutex *m)
+{
+  m->um_word = 0;
+}
+
+int
+umutex_trylock(struct umutex *m)
+{
+  return atomic_cas(&m->um_word, 0, 1) == 0;
+}
+
+void
+umutex_lock(struct umutex *m)
+{
+  int c;
+
+  c = atomic_cas(&m->um_word, 0, 1);
+  if (c == 0) {
+    return;
+  }
+
+  /*
+   * Mark it contended and sleep until it's released. We might be the
+   * only waiter, but we can't tell, so the holder will always wake.
+   * futex_wait returns at once if the word is no longer 2.
+   */
+  if (c != 2) {
+    c = atomic_xchg(&m->um_word, 2);
+  }
+  while (c != 0) {
+    futex_wait(&m->um_word, 2);
+    c = atomic_xchg(&m->um_word, 2);
+  }
+}
+
+void
+umutex_unlock(struct umutex *m)
+{
+  if (atomic_xchg(&m->um_word, 0) == 2) {
+    futex_wake(&m->um_word, 1);
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef UMUTEX_H
+#define UMUTEX_H
+
+/*
+ * User-level mutex built on futex_wait/futex_wake.
+ *
+ * The word is 0 when unlocked, 1 when locked, and 2 when locked with
+ * (possibly) someone asleep on it. Locking and unlocking an uncontended
+ * mutex never enters the kernel; only a thread that has to wait, or
+ * an unlock that sees 2, makes a system call.
+ *
+ * A mutex is only useful between threads of control that share the
+ * memory holding it.
+ */
+
+struct umutex {
+  volatile int um_word;
+};
+
+#define UMUTEX_INITIALIZER { 0 }
+
+void umutex_init(struct umutex *m);
+void umutex_lock(struct umutex *m);
+int umutex_trylock(struct umutex *m);		/* 1 if acquired */
+void umutex_unlock(struct umutex *m);
+
+/* The atomic operations, for other users of futexes. */
+int atomic_cas(volatile int *p, int old, int new);	/* returns old value */
+int atomic_xchg(volatile int *p, int new);		/* returns old value */
+
+#endif /* UMUTEX_H */
@@ -0,0 +1,255 @@
+/*
+ * mmapbench.c
+ *
+ *	Checks file mappings and compares scanning a file through
+ *	mmap against reading it.
+ *
+ *	Usage: mmapbench [kbytes]
+ *
+ *	Writes KBYTES (default 256) of patterned data to mmapbench.tmp,
+ *	then:
+ *
+ *	  read    sums the file with read() in page-sized chunks
+ *	  mmap    sums it through a private read-only mapping, paged in
+ *	          on demand
+ *	  shared  changes every page through a shared mapping, msyncs,
+ *	          and checks read() sees the changes
+ *	  fork    checks a child's writes show through a shared mapping
+ *	          and not through a private one
+ *
+ *	The two scan times are printed; the sums must agree. The
+ *	scans are benchmark regions 1 (read) and 2 (mmap).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../lib/testutils.h"
+
+#define DEFAULT_KBYTES 256
+#define PAGESIZE       4096
+#define TMPFILE        "mmapbench.tmp"
+
+static unsigned char buf[PAGESIZE];
+
+static
+unsigned long long
+now_nsecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+static
+unsigned char
+pattern(unsigned pos)
+{
+  return (pos * 31 + (pos >> 9)) & 0xff;
+}
+
+static
+void
+report(const char *how, unsigned total, unsigned long long start)
+{
+  unsigned long long ns = now_nsecs() - start;
+
+  printf("mmapbench: %-4s %8llu us %6llu KB/s\n",
+         how, ns / 1000,
+         ns ? (unsigned long long)total * 1000000000ULL / 1024 / ns : 0);
+}
+
+static
+void
+makefile(unsigned total)
+{
+  unsigned pos, i;
+  int fd;
+
+  fd = open(TMPFILE, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  for (pos = 0; pos < total; pos += PAGESIZE) {
+    for (i = 0; i < PAGESIZE; i++) {
+      buf[i] = pattern(pos + i);
+    }
+    if (write(fd, buf, PAGESIZE) != PAGESIZE) {
+      err(1, "write at %u", pos);
+    }
+  }
+  close(fd);
+}
+
+static
+unsigned
+byread(unsigned total)
+{
+  unsigned long long start;
+  unsigned sum = 0;
+  int fd, r, i;
+
+  start = now_nsecs();
+  TEST_BENCH_BEGIN(1);
+  fd = open(TMPFILE, O_RDONLY);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  while ((r = read(fd, buf, PAGESIZE)) > 0) {
+    for (i = 0; i < r; i++) {
+      sum += buf[i];
+    }
+  }
+  close(fd);
+  TEST_BENCH_END(1);
+  report("read", total, start);
+  return sum;
+}
+
+static
+unsigned
+bymmap(unsigned total)
+{
+  unsigned long long start;
+  unsigned char *p;
+  unsigned sum = 0, i;
+  int fd;
+
+  start = now_nsecs();
+  TEST_BENCH_BEGIN(2);
+  fd = open(TMPFILE, O_RDONLY);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  p = mmap(NULL, total, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    err(1, "mmap");
+  }
+  close(fd);
+  for (i = 0; i < total; i++) {
+    sum += p[i];
+  }
+  TEST_EQUAL(munmap(p, total), 0, "munmap");
+  TEST_BENCH_END(2);
+  report("mmap", total, start);
+  return sum;
+}
+
+/*
+ * Invert the first byte of every page through a shared mapping, and
+ * check read() sees it after msync.
+ */
+static
+void
+shared(unsigned total)
+{
+  unsigned char *p;
+  unsigned pos, bad = 0;
+  int fd;
+
+  fd = open(TMPFILE, O_RDWR);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  p = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    err(1, "mmap shared");
+  }
+  for (pos = 0; pos < total; pos += PAGESIZE) {
+    p[pos] = ~pattern(pos);
+  }
+  TEST_EQUAL(msync(p, total, MS_SYNC), 0, "msync");
+  TEST_EQUAL(munmap(p, total), 0, "munmap shared");
+  close(fd);
+
+  /* no lseek, so read the file through from the start */
+  fd = open(TMPFILE, O_RDONLY);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  for (pos = 0; pos < total; pos += PAGESIZE) {
+    if (read(fd, buf, PAGESIZE) != PAGESIZE ||
+        buf[0] != (unsigned char)~pattern(pos)) {
+      bad++;
+    }
+  }
+  TEST_EQUAL(bad, 0, "msync'd pages reach the file");
+  close(fd);
+}
+
+/*
+ * A child writes through a shared and a private mapping; only the
+ * shared write should show in the parent.
+ */
+static
+void
+forked(void)
+{
+  volatile unsigned char *sp, *pp;
+  int fd, status;
+  pid_t pid;
+
+  fd = open(TMPFILE, O_RDWR);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  sp = mmap(NULL, PAGESIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  pp = mmap(NULL, PAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (sp == MAP_FAILED || pp == MAP_FAILED) {
+    err(1, "mmap");
+  }
+  close(fd);
+  sp[1] = 0;
+  pp[1] = 0;
+
+  pid = fork();
+  if (pid < 0) {
+    err(1, "fork");
+  }
+  if (pid == 0) {
+    sp[1] = 0x5a;
+    pp[1] = 0x5a;
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  TEST_EQUAL(status, _MKWAIT_EXIT(0), "child exits 0");
+  TEST_EQUAL(sp[1], 0x5a, "shared mapping sees child's write");
+  TEST_EQUAL(pp[1], 0, "private mapping does not");
+
+  /* put the file back as it was */
+  sp[1] = pattern(1);
+  munmap((void *)sp, PAGESIZE);
+  munmap((void *)pp, PAGESIZE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned total = DEFAULT_KBYTES * 1024;
+  unsigned rsum, msum;
+
+  if (argc > 1) {
+    total = atoi(argv[1]) * 1024;
+    if (total == 0) {
+      printf("Usage: mmapbench [kbytes]\n");
+      exit(1);
+    }
+  }
+  total = (total + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
+
+  makefile(total);
+  rsum = byread(total);
+  msum = bymmap(total);
+  TEST_EQUAL(msum, rsum, "mmap and read see the same bytes");
+  shared(total);
+  forked();
+
+  TEST_STATS();
+  return 0;
+}
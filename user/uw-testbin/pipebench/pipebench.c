@@ -0,0 +1,201 @@
+/*
+ * pipebench.c
+ *
+ *	Compares handing data from one process to another through a
+ *	pipe against handing it over in a file.
+ *
+ *	Usage: pipebench [kbytes]
+ *
+ *	For each chunk size a child writes KBYTES (default 256) of
+ *	patterned data in chunks of that size and the parent reads it
+ *	back and checks it:
+ *
+ *	  pipe    the child writes into a pipe while the parent reads
+ *	  file    the child writes pipebench.tmp and exits, then the
+ *	          parent reads the file
+ *
+ *	Times run from before the fork until the parent has everything.
+ *	Writes of a page or more into a pipe are lent to the reader
+ *	rather than copied through the kernel (see kern/include/pipe.h),
+ *	so the larger chunk sizes show that path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <sys/wait.h>
+#include "../lib/testutils.h"
+
+#define DEFAULT_KBYTES 256
+#define MAXCHUNK       16384
+#define TMPFILE        "pipebench.tmp"
+
+static const unsigned chunks[] = { 512, 4096, MAXCHUNK };
+#define NCHUNKS (sizeof(chunks) / sizeof(chunks[0]))
+
+static unsigned char buf[MAXCHUNK];
+
+static
+unsigned long long
+now_nsecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+static
+unsigned char
+pattern(unsigned pos)
+{
+  return (pos * 31 + (pos >> 9)) & 0xff;
+}
+
+/*
+ * Child side: write TOTAL bytes to FD in CHUNK-sized writes.
+ */
+static
+void
+produce(int fd, unsigned total, unsigned chunk)
+{
+  unsigned pos, i, n;
+  int r;
+
+  for (pos = 0; pos < total; pos += n) {
+    n = total - pos < chunk ? total - pos : chunk;
+    for (i = 0; i < n; i++) {
+      buf[i] = pattern(pos + i);
+    }
+    r = write(fd, buf, n);
+    if (r != (int)n) {
+      err(1, "write at %u", pos);
+    }
+  }
+}
+
+/*
+ * Parent side: read until end of file, checking the pattern. Returns
+ * the number of bytes that arrived intact.
+ */
+static
+unsigned
+consume(int fd, unsigned chunk)
+{
+  unsigned pos = 0;
+  int i, r;
+
+  while ((r = read(fd, buf, chunk)) > 0) {
+    for (i = 0; i < r; i++) {
+      if (buf[i] != pattern(pos + i)) {
+        warnx("bad byte at %u", pos + i);
+        return pos + i;
+      }
+    }
+    pos += r;
+  }
+  if (r < 0) {
+    warn("read at %u", pos);
+  }
+  return pos;
+}
+
+static
+void
+report(const char *how, unsigned chunk, unsigned total,
+       unsigned long long start)
+{
+  unsigned long long ns = now_nsecs() - start;
+
+  printf("pipebench: %-4s chunk %5u: %8llu us %6llu KB/s\n",
+         how, chunk, ns / 1000,
+         ns ? (unsigned long long)total * 1000000000ULL / 1024 / ns : 0);
+}
+
+static
+void
+bypipe(unsigned total, unsigned chunk)
+{
+  unsigned long long start;
+  int fds[2], status;
+  pid_t pid;
+
+  start = now_nsecs();
+  if (pipe(fds) < 0) {
+    err(1, "pipe");
+  }
+  pid = fork();
+  if (pid < 0) {
+    err(1, "fork");
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    produce(fds[1], total, chunk);
+    _exit(0);
+  }
+  close(fds[1]);
+  TEST_EQUAL(consume(fds[0], chunk), total, "pipe delivers everything");
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  TEST_EQUAL(status, _MKWAIT_EXIT(0), "pipe writer exits 0");
+  report("pipe", chunk, total, start);
+}
+
+static
+void
+byfile(unsigned total, unsigned chunk)
+{
+  unsigned long long start;
+  int fd, status;
+  pid_t pid;
+
+  start = now_nsecs();
+  pid = fork();
+  if (pid < 0) {
+    err(1, "fork");
+  }
+  if (pid == 0) {
+    fd = open(TMPFILE, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0) {
+      err(1, "%s", TMPFILE);
+    }
+    produce(fd, total, chunk);
+    close(fd);
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  TEST_EQUAL(status, _MKWAIT_EXIT(0), "file writer exits 0");
+  fd = open(TMPFILE, O_RDONLY);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  TEST_EQUAL(consume(fd, chunk), total, "file delivers everything");
+  close(fd);
+  report("file", chunk, total, start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned total = DEFAULT_KBYTES * 1024;
+  unsigned i;
+
+  if (argc > 1) {
+    total = atoi(argv[1]) * 1024;
+    if (total == 0) {
+      printf("Usage: pipebench [kbytes]\n");
+      exit(1);
+    }
+  }
+
+  for (i = 0; i < NCHUNKS; i++) {
+    bypipe(total, chunks[i]);
+    byfile(total, chunks[i]);
+  }
+
+  TEST_STATS();
+  return 0;
+}
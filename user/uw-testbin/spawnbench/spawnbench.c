@@ -0,0 +1,157 @@
+/*
+ * spawnbench.c
+ *
+ *	Checks spawn() and compares command-launch latency with it
+ *	against fork() followed by execv().
+ *
+ *	Usage: spawnbench [iterations [program]]
+ *
+ *	Each iteration starts PROGRAM (default /bin/true) and waits
+ *	for it. Reported times are microseconds per launch, from the
+ *	call until waitpid returns:
+ *
+ *	  fork+execv   fork, execv in the child, waitpid
+ *	  spawn        spawn, waitpid
+ *
+ *	fork copies the whole parent, so this program carries a
+ *	BALLAST-byte array to stand in for a shell or make with some
+ *	state of its own; spawn never touches it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include "../lib/testutils.h"
+
+#define DEFAULT_ITERS 50
+#define DEFAULT_PROG  "/bin/true"
+#define BALLAST       (128*1024)
+
+static char ballast[BALLAST];
+
+static
+unsigned long long
+now_nsecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+report(const char *name, unsigned long long start, int iters)
+{
+  unsigned long long elapsed = now_nsecs() - start;
+
+  printf("spawnbench: %-12s %8llu us/launch (%d launches)\n",
+         name, elapsed / 1000 / iters, iters);
+}
+
+static
+int
+waitfor(pid_t pid)
+{
+  int status;
+
+  if (waitpid(pid, &status, 0) < 0) {
+    return -1;
+  }
+  return status;
+}
+
+static
+void
+check(void)
+{
+  char *args[3];
+  pid_t pid;
+
+  args[0] = (char *)"/bin/true";
+  args[1] = NULL;
+  pid = spawn(args[0], args);
+  TEST_POSITIVE(pid, "spawn of /bin/true");
+  if (pid > 0) {
+    TEST_EQUAL(waitfor(pid), _MKWAIT_EXIT(0), "/bin/true exits 0");
+  }
+
+  args[0] = (char *)"/bin/false";
+  pid = spawn(args[0], args);
+  TEST_POSITIVE(pid, "spawn of /bin/false");
+  if (pid > 0) {
+    TEST_EQUAL(waitfor(pid), _MKWAIT_EXIT(1), "/bin/false exits 1");
+  }
+
+  args[0] = (char *)"/no/such/program";
+  pid = spawn(args[0], args);
+  TEST_EQUAL(pid, -1, "spawn of missing program fails");
+  TEST_EQUAL(errno, ENOENT, "spawn of missing program gives ENOENT");
+
+  pid = spawn(NULL, args);
+  TEST_EQUAL(pid, -1, "spawn of NULL path fails");
+  TEST_EQUAL(errno, EFAULT, "spawn of NULL path gives EFAULT");
+
+  TEST_STATS();
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned long long start;
+  int iters = DEFAULT_ITERS;
+  char *args[2];
+  pid_t pid;
+  int i;
+
+  args[0] = (char *)DEFAULT_PROG;
+  args[1] = NULL;
+  if (argc > 1) {
+    iters = atoi(argv[1]);
+    if (iters <= 0) {
+      printf("Usage: spawnbench [iterations [program]]\n");
+      exit(1);
+    }
+  }
+  if (argc > 2) {
+    args[0] = argv[2];
+  }
+
+  /* make sure the ballast is really in the address space */
+  for (i = 0; i < BALLAST; i += 4096) {
+    ballast[i] = 1;
+  }
+
+  check();
+
+  start = now_nsecs();
+  for (i = 0; i < iters; i++) {
+    pid = fork();
+    if (pid < 0) {
+      printf("spawnbench: fork failed at launch %d\n", i);
+      exit(1);
+    }
+    if (pid == 0) {
+      execv(args[0], args);
+      _exit(255);
+    }
+    waitfor(pid);
+  }
+  report("fork+execv", start, iters);
+
+  start = now_nsecs();
+  for (i = 0; i < iters; i++) {
+    pid = spawn(args[0], args);
+    if (pid < 0) {
+      printf("spawnbench: spawn failed at launch %d\n", i);
+      exit(1);
+    }
+    waitfor(pid);
+  }
+  report("spawn", start, iters);
+
+  return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * stdiobench.c
+ *
+ *	Compares writing a report line by line with write() against
+ *	writing it through a buffered stream, and checks the stream
+ *	code reads back what was written.
+ *
+ *	Usage: stdiobench [lines]
+ *
+ *	Writes LINES (default 2000) formatted lines to stdiobench.tmp:
+ *
+ *	  write   snprintf and one write() per line
+ *	  fprintf fprintf to a fully buffered FILE
+ *
+ *	then reads the file back with fgetc and fread and checks both
+ *	copies are byte for byte the same. The two write times are
+ *	printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include "../lib/testutils.h"
+
+#define DEFAULT_LINES 2000
+#define TMPFILE       "stdiobench.tmp"
+
+static char line[128];
+
+static
+unsigned long long
+now_nsecs(void)
+{
+  time_t secs;
+  unsigned long nsecs;
+
+  __time(&secs, &nsecs);
+  return (unsigned long long)secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+report(const char *how, unsigned nlines, unsigned long long start)
+{
+  unsigned long long ns = now_nsecs() - start;
+
+  printf("stdiobench: %-7s %8llu us %8llu lines/s\n",
+         how, ns / 1000,
+         ns ? (unsigned long long)nlines * 1000000000ULL / ns : 0);
+}
+
+static
+int
+mkline(unsigned i)
+{
+  return snprintf(line, sizeof(line), "%6u %08x %s\n",
+                  i, i * 2654435761U, i % 7 ? "ok" : "checkpoint");
+}
+
+/* Returns the number of bytes written. */
+static
+unsigned
+bywrite(unsigned nlines)
+{
+  unsigned long long start;
+  unsigned i, total = 0;
+  int fd, len;
+
+  start = now_nsecs();
+  fd = open(TMPFILE, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+  if (fd < 0) {
+    err(1, "%s", TMPFILE);
+  }
+  for (i = 0; i < nlines; i++) {
+    len = mkline(i);
+    if (write(fd, line, len) != len) {
+      err(1, "write");
+    }
+    total += len;
+  }
+  close(fd);
+  report("write", nlines, start);
+  return total;
+}
+
+static
+void
+byfprintf(unsigned nlines)
+{
+  unsigned long long start;
+  unsigned i;
+  FILE *f;
+
+  start = now_nsecs();
+  f = fopen(TMPFILE ".2", "w");
+  if (f == NULL) {
+    err(1, "%s.2", TMPFILE);
+  }
+  for (i = 0; i < nlines; i++) {
+    fprintf(f, "%6u %08x %s\n",
+            i, i * 2654435761U, i % 7 ? "ok" : "checkpoint");
+  }
+  TEST_EQUAL(ferror(f), 0, "no write errors");
+  TEST_EQUAL(fclose(f), 0, "fclose flushes");
+  report("fprintf", nlines, start);
+}
+
+/*
+ * Read the write() copy with fgetc and the fprintf copy with fread,
+ * and compare.
+ */
+static
+void
+compare(unsigned total)
+{
+  char buf[100];
+  FILE *f1, *f2;
+  unsigned pos = 0, bad = 0, i;
+  size_t n;
+  int ch;
+
+  f1 = fopen(TMPFILE, "r");
+  f2 = fopen(TMPFILE ".2", "r");
+  if (f1 == NULL || f2 == NULL) {
+    err(1, "fopen");
+  }
+  while ((n = fread(buf, 1, sizeof(buf), f2)) > 0) {
+    for (i = 0; i < n; i++) {
+      ch = fgetc(f1);
+      if (ch != (unsigned char)buf[i]) {
+        bad++;
+      }
+    }
+    pos += n;
+  }
+  TEST_EQUAL(pos, total, "fread sees the whole file");
+  TEST_EQUAL(bad, 0, "both copies match");
+  TEST_EQUAL(fgetc(f1), EOF, "fgetc at end of file");
+  TEST_EQUAL(feof(f1) && feof(f2), 1, "both at end of file");
+  fclose(f1);
+  fclose(f2);
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned nlines = DEFAULT_LINES;
+  unsigned total;
+
+  if (argc > 1) {
+    nlines = atoi(argv[1]);
+    if (nlines == 0) {
+      printf("Usage: stdiobench [lines]\n");
+      exit(1);
+    }
+  }
+
+  total = bywrite(nlines);
+  byfprintf(nlines);
+  compare(total);
+
+  TEST_STATS();
+  return 0;
+}
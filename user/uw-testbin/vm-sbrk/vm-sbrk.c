@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Grow the heap with sbrk, use it, shrink it, and grow it again;
+ * pages given back must come back zeroed. Also checks that the break
+ * can't go below where it started.
+ */
+
+#define PAGE_SIZE (4096)
+#define PAGES     (64)
+#define SIZE      (PAGE_SIZE * PAGES / sizeof(int))
+
+int
+main()
+{
+	unsigned int *base, *p;
+	unsigned int i;
+
+	base = sbrk(0);
+	if (base == (void *)-1) {
+		printf("FAILED sbrk(0)\n");
+		exit(1);
+	}
+
+	p = sbrk(PAGE_SIZE * PAGES);
+	if (p != base) {
+		printf("FAILED sbrk grow returned %p, expected %p\n", p, base);
+		exit(1);
+	}
+	for (i=0; i<SIZE; i++) {
+		p[i] = i;
+	}
+	for (i=0; i<SIZE; i++) {
+		if (p[i] != i) {
+			printf("FAILED p[%d] = %u != %d\n", i, p[i], i);
+			exit(1);
+		}
+	}
+
+	/* give back all but the first page */
+	if (sbrk(-PAGE_SIZE * (PAGES - 1)) == (void *)-1) {
+		printf("FAILED sbrk shrink\n");
+		exit(1);
+	}
+	if (p[0] != 0 || p[1] != 1) {
+		printf("FAILED first page lost on shrink\n");
+		exit(1);
+	}
+	if (sbrk(PAGE_SIZE * (PAGES - 1)) == (void *)-1) {
+		printf("FAILED sbrk regrow\n");
+		exit(1);
+	}
+	for (i=PAGE_SIZE/sizeof(int); i<SIZE; i++) {
+		if (p[i] != 0) {
+			printf("FAILED p[%d] = %u after regrow, not 0\n", i, p[i]);
+			exit(1);
+		}
+	}
+
+	if (sbrk(-PAGE_SIZE * (PAGES + 1)) != (void *)-1) {
+		printf("FAILED sbrk below the heap base succeeded\n");
+		exit(1);
+	}
+
+	printf("SUCCEEDED\n");
+	exit(0);
+}